@@ -0,0 +1,728 @@
+#include "actor.h"
+#include "botscheduler.h"
+#include "position.h"
+#include "trace.h"
+
+#include <deque>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+const long ACTOR_BATCH = 64; // Commands one actor may handle before the worker moves on
+
+bool sameMember(const Member& a, const Member& b) {
+    return a.sink == b.sink && a.session == b.session;
+}
+
+enum FrameKind { FRAME_DELTA = 1, FRAME_KEY = 2 };
+const size_t FRAME_HEADER = 7;
+const size_t MAX_FRAME_MOVES = 4096; // Keeps a delta's length within its 16-bit field
+
+void put16(vector<uint8_t>& bytes, uint16_t value) {
+    bytes.push_back(value & 0xFF);
+    bytes.push_back(value >> 8);
+}
+
+void put32(vector<uint8_t>& bytes, uint32_t value) {
+    put16(bytes, value & 0xFFFF);
+    put16(bytes, value >> 16);
+}
+
+// Starts a frame; the length is patched in by finishFrame
+void startFrame(vector<uint8_t>& bytes, FrameKind kind, uint32_t sequence) {
+    put16(bytes, 0);
+    bytes.push_back(kind);
+    put32(bytes, sequence);
+}
+
+void finishFrame(vector<uint8_t>& bytes) {
+    bytes[0] = bytes.size() & 0xFF;
+    bytes[1] = bytes.size() >> 8;
+}
+
+}
+
+GameActor::~GameActor() {
+    // Abandoned mid-game: recovery must not bring it back
+    if (wal && table.state == Table::TABLE_WAITING) {
+        wal->logEnd(shard, id);
+    }
+}
+
+void GameActor::handle(Command& command) {
+    int sender = -1;
+    for (int i = 0; i < members.size(); i++) {
+        if (sameMember(members[i], command.from)) {
+            sender = i;
+        }
+    }
+
+    switch (command.type) {
+    case COMMAND_NEW:
+        table.start(command.value, command.seed, command.turnLimit);
+        applied = 0;
+        fill(begin(botSeat), end(botSeat), false);
+        botAsked = -1;
+        if (wal) {
+            wal->logDeal(shard, id, command.value, command.seed, command.turnLimit);
+        }
+        members.assign(1, command.from);
+        fill(begin(seatOwner), end(seatOwner), 0);
+        reply(command.from, tableState(), command.received);
+        publishState();
+        break;
+    case COMMAND_LOCKSTEP:
+        relay = true;
+        relayPlayers = command.value;
+        relaySeed = command.seed;
+        relayTurnLimit = command.turnLimit;
+        table.start(command.value, command.seed, command.turnLimit); // Only to know whose choice comes next
+        applied = 0;
+        history.clear();
+        members.assign(1, command.from);
+        fill(begin(seatOwner), end(seatOwner), 0);
+        reply(command.from, lockstepHeader(), command.received);
+        break;
+    case COMMAND_JOIN: {
+        if (command.value >= (int) table.players.size()) {
+            reply(command.from, "error table " + to_string(id) + " has no seat " + to_string(command.value + 1) + "\n",
+                  command.received);
+            break;
+        }
+        if (relay && sender < 0 && history.size() < applied) {
+            reply(command.from, "error table " + to_string(id) + " is too far along to join\n", command.received);
+            break;
+        }
+        bool claim = relay && sender >= 0 && command.value >= 0; // A member taking another seat
+        if (sender < 0) {
+            members.push_back(command.from);
+            sender = members.size() - 1;
+        }
+        if (command.value >= 0) {
+            seatOwner[command.value] = sender;
+            botSeat[command.value] = false;
+        }
+        if (claim) {
+            reply(command.from, "seat " + to_string(command.value + 1) + "\n", command.received);
+        } else if (relay) {
+            // A late joiner replays the moves so far on its own copy
+            string text = lockstepHeader();
+            for (int8_t move : history) {
+                text += "m " + to_string(move == ENTER_TOKEN ? 0 : move + 1) + "\n";
+            }
+            reply(command.from, text, command.received);
+        } else {
+            reply(command.from, tableState(), command.received);
+        }
+        break;
+    }
+    case COMMAND_MOVE:
+        if (table.state != Table::TABLE_WAITING) {
+            reply(command.from, "error game over\n", command.received);
+        } else if (sender < 0 || seatOwner[table.seat] != sender) {
+            reply(command.from, "error seat " + to_string(table.seat + 1) + " is not yours\n", command.received);
+        } else if (botSeat[table.seat]) {
+            reply(command.from, "error seat " + to_string(table.seat + 1) + " is played by a bot\n", command.received);
+        } else if (!table.play(command.value)) {
+            reply(command.from, "error illegal move\n", command.received);
+        } else if (relay) {
+            relayed(command);
+        } else {
+            moved(command);
+        }
+        break;
+    case COMMAND_BOT:
+        if (relay || !bots) {
+            reply(command.from, "error no bots on this table\n", command.received);
+        } else if (command.value < 0 || command.value >= (int) table.players.size()) {
+            reply(command.from, "error table " + to_string(id) + " has no seat " + to_string(command.value + 1) + "\n",
+                  command.received);
+        } else if (sender < 0 || seatOwner[command.value] != sender) {
+            reply(command.from, "error seat " + to_string(command.value + 1) + " is not yours\n", command.received);
+        } else {
+            botSeat[command.value] = true;
+            botThink[command.value] = command.seed;
+        }
+        break;
+    case COMMAND_BOT_MOVE:
+        // Answers for a choice that is no longer pending (the seat was taken back) are dropped
+        if (!relay && table.state == Table::TABLE_WAITING && botSeat[table.seat] && command.seed == applied &&
+            table.play(command.value)) {
+            moved(command);
+        }
+        break;
+    case COMMAND_POS: {
+        if (relay) {
+            reply(command.from, "error lockstep tables keep no position on the server\n", command.received);
+            break;
+        }
+        char text[MAX_POSITION_TEXT];
+        serializePosition(positionFromPlayers(table.players, table.seat, table.chances), text, sizeof(text));
+        reply(command.from, "pos " + string(text) + "\n", command.received);
+        break;
+    }
+    case COMMAND_LEAVE:
+        if (sender >= 0) {
+            // The leaver's seats pass to the first member left (an empty table keeps no owners)
+            members.erase(members.begin() + sender);
+            for (auto& owner : seatOwner) {
+                owner = owner == sender ? 0 : owner - (owner > sender);
+            }
+        }
+        break;
+    case COMMAND_WATCH: {
+        if (relay) {
+            reply(command.from, "error lockstep tables keep no position on the server\n", command.received);
+            break;
+        }
+        auto it = find_if(watchers.begin(), watchers.end(),
+                          [&](const pair<ReplySink*, int>& entry) { return entry.first == command.from.sink; });
+        if (it == watchers.end()) {
+            watchers.push_back(make_pair(command.from.sink, 1));
+            table.events = &events;
+        } else {
+            it->second++;
+        }
+        // Deltas from before this keyframe may already be queued; the loop drops them until it arrives
+        reply(command.from, "watching " + to_string(id) + "\n", command.received);
+        sendFrame(command.from.sink, command.from.session, keyframe());
+        break;
+    }
+    case COMMAND_UNWATCH:
+        for (auto it = watchers.begin(); it != watchers.end(); ++it) {
+            if (it->first == command.from.sink) {
+                if (--it->second == 0) {
+                    watchers.erase(it);
+                }
+                if (watchers.empty()) {
+                    table.events = nullptr; // Nobody to publish moves to
+                }
+                break;
+            }
+        }
+        break;
+    case COMMAND_HASH:
+        if (relay) {
+            checkHash(command.value, command.seed);
+        }
+        break;
+    case COMMAND_ECHO:
+        reply(command.from, command.text, command.received);
+        break;
+    case COMMAND_PING:
+        pingCount.fetch_add(1, memory_order_relaxed);
+        break;
+    }
+    askBot();
+    events.clear(); // Published by now
+    bytes.store(sizeof(*this) - sizeof(Table) + table.memoryBytes() + members.capacity() * sizeof(Member) +
+                history.capacity() + replyText.capacity() + watchers.capacity() * sizeof(watchers[0]) +
+                events.capacity() * sizeof(GameEvent), memory_order_relaxed);
+}
+
+// A move was just played: log it and tell every member and spectator
+void GameActor::moved(const Command& command) {
+    applied++;
+    if (wal) {
+        wal->logMove(shard, id, applied, command.value);
+    }
+    const string& text = state();
+    for (const auto& member : members) {
+        reply(member, text, sameMember(member, command.from) ? command.received : TimePoint());
+    }
+    publish();
+    publishState();
+}
+
+// A lockstep move was just played on the server's copy: relay it to every member in order
+void GameActor::relayed(const Command& command) {
+    applied++;
+    if (history.size() < MAX_HISTORY) {
+        history.push_back(command.value);
+    }
+    string text = "m " + to_string(command.value == ENTER_TOKEN ? 0 : command.value + 1) + "\n";
+    for (const auto& member : members) {
+        reply(member, text, sameMember(member, command.from) ? command.received : TimePoint());
+    }
+}
+
+// Hands the pending choice to the bot pool if a bot holds the seat; the worker only copies the table
+void GameActor::askBot() {
+    if (bots && !relay && table.state == Table::TABLE_WAITING && botSeat[table.seat] && botAsked != applied) {
+        botAsked = applied;
+        bots->submit(shared_from_this(), table, applied, botThink[table.seat]);
+    }
+}
+
+// Encodes the moves the last command applied as one delta, once, and hands the same buffer to every
+// loop with spectators; a keyframe follows every KEYFRAME_EVERY deltas and at the end of the game
+void GameActor::publish() {
+    if (watchers.empty() || events.empty()) {
+        return;
+    }
+    for (size_t first = 0; first < events.size(); first += MAX_FRAME_MOVES) {
+        size_t count = min(events.size() - first, MAX_FRAME_MOVES);
+        shared_ptr<Frame> delta = make_shared<Frame>();
+        delta->table = id;
+        delta->moves = count;
+        delta->bytes.reserve(FRAME_HEADER + count * 8);
+        startFrame(delta->bytes, FRAME_DELTA, ++deltas);
+        for (size_t i = first; i < first + count; i++) {
+            const GameEvent& event = events[i];
+            put16(delta->bytes, event.turn);
+            delta->bytes.push_back(event.seat);
+            delta->bytes.push_back(event.type);
+            delta->bytes.push_back(event.token);
+            delta->bytes.push_back(event.dice);
+            delta->bytes.push_back(event.from);
+            delta->bytes.push_back(event.to);
+        }
+        finishFrame(delta->bytes);
+        shared_ptr<const Frame> shared = std::move(delta);
+        for (const auto& watcher : watchers) {
+            sendFrame(watcher.first, 0, shared);
+        }
+    }
+
+    if (++sinceKeyframe >= KEYFRAME_EVERY || table.state == Table::TABLE_FINISHED) {
+        sinceKeyframe = 0;
+        shared_ptr<const Frame> shared = keyframe();
+        for (const auto& watcher : watchers) {
+            sendFrame(watcher.first, 0, shared);
+        }
+    }
+}
+
+// Slots are chosen by id, and the serve command sizes the region so that every table sharing a
+// slot also shares this shard's worker: each slot keeps a single writer
+void GameActor::publishState() {
+    if (publisher) {
+        publisher->publish(id % publisher->slots(), snapshotTable(id, table));
+    }
+}
+
+// The whole table, numbered after the last delta it includes
+shared_ptr<const Frame> GameActor::keyframe() const {
+    shared_ptr<Frame> frame = make_shared<Frame>();
+    frame->table = id;
+    frame->keyframe = true;
+    startFrame(frame->bytes, FRAME_KEY, deltas);
+    put32(frame->bytes, id & 0xFFFFFFFF);
+    put32(frame->bytes, id >> 32);
+    frame->bytes.push_back(table.players.size());
+    frame->bytes.push_back(table.seat);
+    frame->bytes.push_back(table.chances);
+    put16(frame->bytes, table.turn);
+    frame->bytes.push_back(table.state == Table::TABLE_FINISHED ? table.leader() + 1 : 0);
+    for (const auto& player : table.players) {
+        for (const auto& token : player.tokens) {
+            frame->bytes.push_back(token.inPlay ? token.position : -1);
+        }
+    }
+    finishFrame(frame->bytes);
+    return frame;
+}
+
+void GameActor::sendFrame(ReplySink* sink, uint64_t session, const shared_ptr<const Frame>& frame) {
+    Reply* message = newReply();
+    message->session = session;
+    message->table = id;
+    message->frame = frame;
+    sink->deliver(message);
+}
+
+void GameActor::reply(const Member& member, const string& text, TimePoint received) {
+    if (!member.sink) {
+        return;
+    }
+    Reply* message = newReply();
+    message->session = member.session;
+    message->text = text;
+    message->received = received;
+    member.sink->deliver(message);
+}
+
+string GameActor::lockstepHeader() const {
+    return "lockstep " + to_string(id) + " " + to_string(relayPlayers) + " " + to_string(relaySeed) + " " +
+           to_string(relayTurnLimit) + "\n";
+}
+
+// Compares a member's state hash with the first one reported after the same number of moves
+void GameActor::checkHash(int moves, uint64_t hash) {
+    // Slots hold moves + 1, so empty ones never match; a new checkpoint replaces the oldest
+    pair<int, uint64_t>* oldest = &checkpoints[0];
+    for (auto& slot : checkpoints) {
+        if (slot.first == moves + 1) {
+            if (slot.second != hash) {
+                for (const auto& member : members) {
+                    reply(member, "desync " + to_string(moves) + "\n", TimePoint());
+                }
+            }
+            return;
+        }
+        if (slot.first < oldest->first) {
+            oldest = &slot;
+        }
+    }
+    *oldest = make_pair(moves + 1, hash);
+}
+
+// Next question for the table's members (or its result), built in the actor's reused buffer
+const string& GameActor::state() {
+    replyText.clear();
+    appendState();
+    return replyText;
+}
+
+// The table's id followed by its state, as NEW and JOIN answer
+const string& GameActor::tableState() {
+    replyText = "table ";
+    replyText += to_string(id);
+    replyText += '\n';
+    appendState();
+    return replyText;
+}
+
+void GameActor::appendState() {
+    if (table.state == Table::TABLE_FINISHED) {
+        replyText += "over ";
+        replyText += to_string(table.leader() + 1);
+        replyText += ' ';
+        replyText += to_string(table.turn);
+        replyText += '\n';
+        return;
+    }
+    replyText += "ask ";
+    replyText += to_string(table.seat + 1);
+    replyText += ' ';
+    replyText += to_string(table.diceRoll);
+    replyText += ' ';
+    for (int i = 0; i < table.moves.size(); i++) {
+        if (i > 0) {
+            replyText += ',';
+        }
+        replyText += to_string(table.moves[i] == ENTER_TOKEN ? 0 : table.moves[i] + 1);
+    }
+    replyText += '\n';
+}
+
+void Shard::start() {
+    stopping = false;
+    worker = thread([this]() { run(); });
+}
+
+void Shard::stop() {
+    if (!worker.joinable()) {
+        return;
+    }
+    {
+        lock_guard<mutex> guard(sleepLock);
+        stopping = true;
+        wake.notify_one();
+    }
+    worker.join();
+
+    // Producers are gone by now: drop whatever is still queued
+    while (GameActor* actor = runQueue.pop()) {
+        while (Command* command = actor->inbox.pop()) {
+            freeCommand(command);
+        }
+        actor->pending = 0;
+        actor->scheduled.reset();
+    }
+}
+
+void Shard::post(GameActor& actor, Command* command) {
+    actor.inbox.push(command);
+    if (actor.pending.fetch_add(1, memory_order_acq_rel) > 0) {
+        return; // Already queued or running; the worker picks this command up before letting go
+    }
+    actor.scheduled = actor.shared_from_this();
+    runQueue.push(&actor);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (sleeping.load(memory_order_relaxed)) {
+        lock_guard<mutex> guard(sleepLock);
+        wake.notify_one();
+    }
+}
+
+void Shard::adopt(const shared_ptr<GameActor>& actor, const Table& table, uint32_t moves) {
+    actor->table = table;
+    actor->table.events = nullptr; // Until someone watches
+    actor->applied = moves;
+    if (actor->publisher) {
+        actor->publishState();
+    }
+    track(actor);
+}
+
+void Shard::snapshot(uint32_t generation) {
+    lock_guard<mutex> guard(sleepLock);
+    snapshotRequested = generation;
+    wake.notify_one();
+}
+
+void Shard::track(const shared_ptr<GameActor>& actor) {
+    if (tables.size() >= sweepAt) {
+        tables.erase(remove_if(tables.begin(), tables.end(), [](const weak_ptr<GameActor>& entry) { return entry.expired(); }),
+                     tables.end());
+        sweepAt = max<size_t>(1024, tables.size() * 2);
+    }
+    tables.push_back(actor);
+}
+
+// The state of every table still in play; the moves each one logs from here on carry higher counts
+void Shard::takeSnapshot() {
+    snapshotDone = snapshotRequested.load(memory_order_acquire);
+    string records;
+    size_t kept = 0;
+    for (size_t i = 0; i < tables.size(); i++) {
+        shared_ptr<GameActor> actor = tables[i].lock();
+        if (!actor || actor->table.state != Table::TABLE_WAITING) {
+            continue;
+        }
+        WriteAheadLog::appendState(records, actor->id, actor->applied, actor->table);
+        tables[kept++] = tables[i];
+    }
+    tables.resize(kept);
+    wal->snapshotPart(snapshotDone, std::move(records));
+}
+
+void Shard::run() {
+#ifdef __linux__
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#endif
+    while (!stopping) {
+        if (wal && snapshotRequested.load(memory_order_acquire) != snapshotDone) {
+            takeSnapshot();
+        }
+        GameActor* actor = runQueue.pop();
+        if (!actor) {
+            // Announce the sleep before the last look at the queue, so a post either sees it or is seen
+            unique_lock<mutex> lock(sleepLock);
+            sleeping.store(true, memory_order_relaxed);
+            atomic_thread_fence(memory_order_seq_cst);
+            actor = runQueue.pop();
+            if (!actor && !stopping && snapshotRequested.load(memory_order_relaxed) == snapshotDone) {
+                wake.wait(lock);
+            }
+            sleeping.store(false, memory_order_relaxed);
+            if (!actor) {
+                continue;
+            }
+        }
+
+        shared_ptr<GameActor> keep = std::move(actor->scheduled);
+        long batch = min(actor->pending.load(memory_order_acquire), ACTOR_BATCH);
+        for (long done = 0; done < batch;) {
+            Command* command = actor->inbox.pop();
+            if (!command) {
+                this_thread::yield(); // Counted but still being linked in by its producer
+                continue;
+            }
+            {
+                METRIC_TIME(METRIC_COMMAND);
+                if (command->type == COMMAND_NEW) {
+                    actor->traced = traceSample(); // Each deal is a new game to sample
+                }
+                TraceGame traced(actor->traced);
+                TraceSpan span("command");
+                span.arg = command->type;
+                actor->handle(*command);
+            }
+            if (command->type == COMMAND_NEW && actor->wal) {
+                track(keep);
+            }
+            freeCommand(command);
+            done++;
+        }
+        if (actor->pending.fetch_sub(batch, memory_order_acq_rel) != batch) {
+            actor->scheduled = std::move(keep);
+            runQueue.push(actor);
+        }
+    }
+}
+
+namespace {
+
+// The same inbox behind a mutex, for comparison
+class LockedInbox {
+public:
+    void push(Command* command) {
+        lock_guard<mutex> guard(lock);
+        items.push_back(command);
+    }
+
+    Command* pop() {
+        lock_guard<mutex> guard(lock);
+        if (items.empty()) {
+            return nullptr;
+        }
+        Command* command = items.front();
+        items.pop_front();
+        return command;
+    }
+
+private:
+    mutex lock;
+    deque<Command*> items;
+};
+
+const int LATENCY_SAMPLE_EVERY = 64;
+
+// Every producer sends perTable commands to every table; one consumer thread drains each table
+template <class Inbox>
+void benchInbox(const char* name, int producers, int tables, long perTable) {
+    vector<Inbox> inboxes(tables);
+    vector<unique_ptr<Command[]>> commands; // Preallocated, so only the queues are measured
+    for (int p = 0; p < producers; p++) {
+        commands.push_back(unique_ptr<Command[]>(new Command[tables * perTable]));
+    }
+    vector<vector<double>> latencies(tables);
+    atomic<int> ready(0);
+    atomic<bool> go(false);
+
+    auto started = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (int t = 0; t < tables; t++) {
+        threads.push_back(thread([&, t]() {
+            ready++;
+            while (!go) {
+            }
+            long expected = producers * perTable;
+            for (long received = 0; received < expected;) {
+                Command* command = inboxes[t].pop();
+                if (!command) {
+                    this_thread::yield();
+                    continue;
+                }
+                if (received++ % LATENCY_SAMPLE_EVERY == 0) {
+                    latencies[t].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() -
+                                                                            command->received).count());
+                }
+            }
+        }));
+    }
+    for (int p = 0; p < producers; p++) {
+        threads.push_back(thread([&, p]() {
+            ready++;
+            while (!go) {
+            }
+            long i = 0;
+            for (long n = 0; n < perTable; n++) {
+                for (int t = 0; t < tables; t++, i++) {
+                    commands[p][i].received = chrono::steady_clock::now();
+                    inboxes[t].push(&commands[p][i]);
+                }
+            }
+        }));
+    }
+    while (ready < producers + tables) {
+        this_thread::yield();
+    }
+    started = chrono::steady_clock::now();
+    go = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+    vector<double> all;
+    for (const auto& samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    sort(all.begin(), all.end());
+    long total = (long) producers * tables * perTable;
+    cout << name << ": " << total << " commands in " << elapsed << " s (" << total / elapsed / 1e6
+         << " M/s), enqueue-to-dequeue p50 " << all[all.size() / 2] << " us, p99 " << all[all.size() * 99 / 100]
+         << " us\n";
+}
+
+// Producers post pings to actors spread over pinned shards
+void benchActors(int producers, int tables, long perTable, int workers) {
+    int cpus = max(1u, thread::hardware_concurrency());
+    vector<unique_ptr<Shard>> shards;
+    for (int w = 0; w < workers; w++) {
+        shards.push_back(unique_ptr<Shard>(new Shard(w % cpus)));
+        shards.back()->start();
+    }
+    vector<shared_ptr<GameActor>> actors;
+    for (int t = 0; t < tables; t++) {
+        actors.push_back(make_shared<GameActor>(t, t % workers));
+    }
+
+    auto started = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.push_back(thread([&]() {
+            for (long n = 0; n < perTable; n++) {
+                for (auto& actor : actors) {
+                    shards[actor->shard]->post(*actor, newCommand());
+                }
+            }
+        }));
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    uint64_t total = (uint64_t) producers * tables * perTable;
+    while (true) {
+        uint64_t handled = 0;
+        for (const auto& actor : actors) {
+            handled += actor->pings();
+        }
+        if (handled == total) {
+            break;
+        }
+        this_thread::yield();
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    cout << "actors on " << workers << " pinned shards: " << total << " commands in " << elapsed << " s ("
+         << total / elapsed / 1e6 << " M/s, including allocation and scheduling)\n";
+    for (auto& shard : shards) {
+        shard->stop();
+    }
+}
+
+}
+
+int runActorBench(int argc, char** argv) {
+    int producers = 8, tables = 4;
+    int workers = max(1u, thread::hardware_concurrency() / 2);
+    long perTable = 100000;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        if (option == "--producers") {
+            producers = stoi(argv[i + 1]);
+        } else if (option == "--tables") {
+            tables = stoi(argv[i + 1]);
+        } else if (option == "--commands") {
+            perTable = stol(argv[i + 1]);
+        } else if (option == "--workers") {
+            workers = stoi(argv[i + 1]);
+        } else {
+            cout << "Usage: " << argv[0] << " actor-bench [--producers P] [--tables T] [--commands N] [--workers W]\n"
+                 << "Each producer sends N commands to each table.\n";
+            return 1;
+        }
+    }
+    if (producers < 1 || tables < 1 || perTable < 1 || workers < 1) {
+        cout << "Producers, tables, commands and workers must all be at least 1.\n";
+        return 1;
+    }
+    cout << producers << " producers per table, " << tables << " tables, " << perTable
+         << " commands per producer per table\n";
+    benchInbox<MpscQueue<Command>>("lock-free inbox", producers, tables, perTable);
+    benchInbox<LockedInbox>("mutex inbox", producers, tables, perTable);
+    benchActors(producers, tables, perTable, workers);
+    return 0;
+}
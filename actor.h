@@ -0,0 +1,375 @@
+#ifndef ACTOR_H
+#define ACTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "sharedstate.h"
+#include "table.h"
+#include "wal.h"
+
+// Link field for the intrusive queue below; queued types derive from it
+struct MpscNode {
+    atomic<MpscNode*> next{nullptr};
+};
+
+// Unbounded intrusive multi-producer single-consumer queue (Vyukov): push is one atomic exchange
+// from any thread, pop belongs to the single consumer. pop can return null for a moment while a
+// push is half done, so consumers track how many items they expect separately.
+template <class T>
+class MpscQueue {
+public:
+    MpscQueue() : head(&stub), tail(&stub) {}
+
+    void push(T* item) {
+        pushNode(item);
+    }
+
+    T* pop() {
+        MpscNode* current = tail;
+        MpscNode* next = current->next.load(memory_order_acquire);
+        if (current == &stub) {
+            if (!next) {
+                return nullptr;
+            }
+            tail = next;
+            current = next;
+            next = next->next.load(memory_order_acquire);
+        }
+        if (next) {
+            tail = next;
+            return static_cast<T*>(current);
+        }
+        if (current != head.load(memory_order_acquire)) {
+            return nullptr; // A producer swapped head but has not linked its node yet
+        }
+        pushNode(&stub);
+        next = current->next.load(memory_order_acquire);
+        if (next) {
+            tail = next;
+            return static_cast<T*>(current);
+        }
+        return nullptr;
+    }
+
+private:
+    alignas(64) atomic<MpscNode*> head; // Producers' end, on its own cache line
+    alignas(64) MpscNode* tail;         // Consumer's end
+    MpscNode stub;
+
+    void pushNode(MpscNode* node) {
+        node->next.store(nullptr, memory_order_relaxed);
+        MpscNode* previous = head.exchange(node, memory_order_acq_rel);
+        previous->next.store(node, memory_order_release);
+    }
+};
+
+// Free list for messages, which are made on one thread and freed on another (commands by the
+// loops and freed by the shard workers, replies the other way round). Each thread keeps a few in a
+// cache of its own and trades whole batches with a shared depot under a lock, so steady traffic
+// costs neither malloc nor free and takes the lock once per BATCH messages. A recycled message has
+// been through T::clear, which keeps the capacity of its strings.
+template <class T>
+class MessagePool {
+public:
+    static T* take() {
+        Cache& cache = local();
+        if (!cache.head) {
+            cache.refill();
+        }
+        if (!cache.head) {
+            return new T();
+        }
+        T* item = cache.head;
+        cache.head = static_cast<T*>(item->next.load(memory_order_relaxed));
+        cache.count--;
+        return item;
+    }
+
+    static void give(T* item) {
+        item->clear();
+        Cache& cache = local();
+        cache.push(item);
+        if (cache.count >= 2 * BATCH) {
+            cache.spill(BATCH);
+        }
+    }
+
+private:
+    static const int BATCH = 64;
+
+    struct Depot {
+        mutex lock;
+        T* head = nullptr;
+    };
+
+    struct Cache {
+        T* head = nullptr;
+        int count = 0;
+
+        ~Cache() { spill(count); } // A thread that ends hands its messages on
+
+        void push(T* item) {
+            item->next.store(head, memory_order_relaxed);
+            head = item;
+            count++;
+        }
+
+        void spill(int n) {
+            if (n == 0) {
+                return;
+            }
+            T* first = head;
+            T* last = head;
+            for (int i = 1; i < n; i++) {
+                last = static_cast<T*>(last->next.load(memory_order_relaxed));
+            }
+            head = static_cast<T*>(last->next.load(memory_order_relaxed));
+            count -= n;
+            Depot& shared = depot();
+            lock_guard<mutex> guard(shared.lock);
+            last->next.store(shared.head, memory_order_relaxed);
+            shared.head = first;
+        }
+
+        void refill() {
+            Depot& shared = depot();
+            lock_guard<mutex> guard(shared.lock);
+            while (shared.head && count < BATCH) {
+                T* item = shared.head;
+                shared.head = static_cast<T*>(item->next.load(memory_order_relaxed));
+                item->next.store(head, memory_order_relaxed);
+                head = item;
+                count++;
+            }
+        }
+    };
+
+    static Depot& depot() {
+        static Depot shared;
+        return shared;
+    }
+
+    static Cache& local() {
+        static thread_local Cache cache;
+        return cache;
+    }
+};
+
+typedef chrono::steady_clock::time_point TimePoint;
+
+class BotScheduler;
+
+// One spectator frame in the wire format of server.h, encoded once and then shared read-only by
+// every spectator it is written to
+struct Frame {
+    uint64_t table = 0;
+    bool keyframe = false;
+    int moves = 0;        // Delta records inside
+    vector<uint8_t> bytes;
+};
+
+struct Reply : MpscNode {
+    uint64_t session = 0; // 0 with a frame: every spectator of table on the receiving loop
+    string text;
+    TimePoint received;   // When the command being answered arrived; default for broadcasts
+    shared_ptr<const Frame> frame;
+    uint64_t table = 0;
+
+    void clear() {
+        session = 0;
+        text.clear();
+        received = TimePoint();
+        frame.reset();
+        table = 0;
+    }
+};
+
+// Replies and commands come from and go back to their MessagePool; nothing news or deletes them directly
+inline Reply* newReply() {
+    return MessagePool<Reply>::take();
+}
+
+inline void freeReply(Reply* reply) {
+    MessagePool<Reply>::give(reply);
+}
+
+// Where a table's replies go: implemented by the server's event loops, called from shard workers
+class ReplySink {
+public:
+    virtual ~ReplySink() {}
+    virtual void deliver(Reply* reply) = 0;
+};
+
+// A connection taking part in a table
+struct Member {
+    ReplySink* sink = nullptr;
+    uint64_t session = 0;
+};
+
+enum CommandType {
+    COMMAND_NEW,   // value = players, seed, turnLimit; the sender becomes the first member, owning every seat
+    COMMAND_JOIN,  // value = seat to take over (0-based), or -1 to watch
+    COMMAND_MOVE,  // value = move as returned by legalMoves
+    COMMAND_POS,
+    COMMAND_LEAVE,
+    COMMAND_ECHO,  // Replies text to the sender, keeping replies in command order
+    COMMAND_LOCKSTEP, // Like COMMAND_NEW, but the table only orders and relays moves (see lockstep.h)
+    COMMAND_HASH,  // Lockstep state check: value = moves applied, seed = the sender's Table::hash()
+    COMMAND_WATCH, // The sender's loop streams frames to it (see server.h)
+    COMMAND_UNWATCH,
+    COMMAND_BOT,   // value = seat the sender hands to a server bot, seed = think time in microseconds (0: default)
+    COMMAND_BOT_MOVE, // From the bot pool: value = move, seed = the move count it was asked at
+    COMMAND_PING   // No reply; counts toward benchmarks only
+};
+
+struct Command : MpscNode {
+    CommandType type = COMMAND_PING;
+    Member from;
+    int value = 0;
+    uint64_t seed = 0;
+    int turnLimit = DEFAULT_MAX_TURNS;
+    TimePoint received;
+    string text;
+
+    void clear() {
+        type = COMMAND_PING;
+        from = Member();
+        value = 0;
+        seed = 0;
+        turnLimit = DEFAULT_MAX_TURNS;
+        received = TimePoint();
+        text.clear();
+    }
+};
+
+inline Command* newCommand() {
+    return MessagePool<Command>::take();
+}
+
+inline void freeCommand(Command* command) {
+    MessagePool<Command>::give(command);
+}
+
+// One table and its inbox. Commands from any thread land in the inbox; the actor only ever runs
+// on its shard's worker, so the Table inside needs no lock.
+class GameActor : public MpscNode, public enable_shared_from_this<GameActor> {
+public:
+    const uint64_t id;
+    const int shard;
+    StatePublisher* publisher = nullptr; // Set before the first command to mirror the table into shared memory
+    WriteAheadLog* wal = nullptr;        // Set before the first command to log the deal and every move
+    BotScheduler* bots = nullptr;        // Set before the first command to allow bot seats
+
+    GameActor(uint64_t id, int shard) : id(id), shard(shard) {}
+    ~GameActor();
+
+    // Bytes held by the table and member list, republished after every command
+    size_t memoryBytes() const { return bytes.load(memory_order_relaxed); }
+    uint64_t pings() const { return pingCount.load(memory_order_relaxed); }
+
+private:
+    friend class Shard;
+
+    MpscQueue<Command> inbox;
+    atomic<long> pending{0};             // Commands pushed but not yet handled
+    shared_ptr<GameActor> scheduled;     // Keeps the actor alive while it sits in a run queue
+    atomic<size_t> bytes{0};
+    atomic<uint64_t> pingCount{0};
+
+    // Touched only by the shard worker
+    bool traced = false;                 // Sampled for tracing when dealt
+    Table table;
+    vector<Member> members;
+    int seatOwner[4] = {0, 0, 0, 0};     // Index into members
+    uint32_t applied = 0;                // Moves played since the deal, as counted in the log
+    bool botSeat[4] = {false, false, false, false};
+    int botThink[4] = {0, 0, 0, 0};      // Microseconds, 0 for the scheduler's default
+    int64_t botAsked = -1;               // Move count of the choice last handed to the pool
+
+    // Spectators are counted per loop: each frame goes once to every loop that has some
+    static const int KEYFRAME_EVERY = 32; // Deltas between keyframes, where lagging spectators resume
+    vector<pair<ReplySink*, int>> watchers;
+    vector<GameEvent> events;            // Moves applied by the command being handled, while anyone watches
+    string replyText;                    // Reply being built; kept so its buffer is reused
+    uint32_t deltas = 0;
+    int sinceKeyframe = 0;
+
+    // Lockstep tables follow the game only to know whose choice comes next, and keep the deal, the
+    // ordered moves for late joiners and recent state hashes
+    static const int CHECKPOINTS = 16;
+    static const size_t MAX_HISTORY = 4096; // Moves kept; a game past this many can no longer be joined
+    bool relay = false;
+    int relayPlayers = 0;
+    uint64_t relaySeed = 0;
+    int relayTurnLimit = 0;
+    vector<int8_t> history;
+    pair<int, uint64_t> checkpoints[CHECKPOINTS] = {};
+
+    void handle(Command& command);
+    void moved(const Command& command);
+    void relayed(const Command& command);
+    void askBot();
+    void reply(const Member& member, const string& text, TimePoint received);
+    const string& state();
+    const string& tableState();
+    void appendState();
+    void publish();
+    void publishState();
+    shared_ptr<const Frame> keyframe() const;
+    void sendFrame(ReplySink* sink, uint64_t session, const shared_ptr<const Frame>& frame);
+    string lockstepHeader() const;
+    void checkHash(int moves, uint64_t hash);
+};
+
+// A worker thread, optionally pinned to one CPU, that runs every actor of its shard.
+// Actors with pending commands wait in an MPSC run queue; each gets a bounded batch per visit.
+class Shard {
+public:
+    WriteAheadLog* wal = nullptr; // This shard's tables log through it; the worker writes their snapshots
+
+    explicit Shard(int cpu) : cpu(cpu) {}
+    ~Shard() { stop(); }
+
+    void start();
+    void stop();
+
+    // Queues command for actor (any thread); the shard takes ownership of command
+    void post(GameActor& actor, Command* command);
+
+    // Puts a recovered table into actor, which belongs to this shard; only before start
+    void adopt(const shared_ptr<GameActor>& actor, const Table& table, uint32_t moves);
+
+    // Asks the worker for a snapshot part for generation (any thread)
+    void snapshot(uint32_t generation);
+
+private:
+    int cpu;
+    MpscQueue<GameActor> runQueue;
+    atomic<bool> sleeping{false};
+    atomic<bool> stopping{false};
+    mutex sleepLock;
+    condition_variable wake;
+    thread worker;
+
+    // Touched only by the worker once it runs: the logged tables, for snapshots
+    vector<weak_ptr<GameActor>> tables;
+    size_t sweepAt = 1024;
+    atomic<uint32_t> snapshotRequested{0};
+    uint32_t snapshotDone = 0;
+
+    void run();
+    void track(const shared_ptr<GameActor>& actor);
+    void takeSnapshot();
+};
+
+// "actor-bench" command: many producers per table through the lock-free inbox, a mutex inbox
+// for comparison, and the full shard/actor path
+int runActorBench(int argc, char** argv);
+
+#endif
@@ -0,0 +1,424 @@
+#include "alloctrace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <cxxabi.h>
+#include <dlfcn.h>
+#endif
+
+#include "actor.h"
+#include "ponder.h"
+#include "rollout.h"
+#include "table.h"
+
+namespace {
+
+#ifdef LUDO_ALLOC_TRACE
+
+const int SITE_SLOTS = 1 << 12; // Open addressing; sites past this many are added up as one
+
+struct AllocSite {
+    atomic<uintptr_t> address{0};
+    atomic<uint64_t> count{0};
+    atomic<uint64_t> bytes{0};
+};
+
+AllocSite sites[SITE_SLOTS + 1]; // The last slot takes whatever no longer fits
+atomic<bool> recording{false};
+thread_local uint64_t allocations = 0;
+atomic<uint64_t> totalAllocations{0};
+
+void recordSite(uintptr_t address, size_t size) {
+    size_t slot = (address >> 2) * 0x9E3779B97F4A7C15ULL >> 52; // 12 bits
+    for (int probe = 0; probe < SITE_SLOTS; probe++, slot = (slot + 1) & (SITE_SLOTS - 1)) {
+        uintptr_t seen = sites[slot].address.load(memory_order_relaxed);
+        if (seen == 0 && sites[slot].address.compare_exchange_strong(seen, address, memory_order_relaxed)) {
+            seen = address;
+        }
+        if (seen == address) {
+            sites[slot].count.fetch_add(1, memory_order_relaxed);
+            sites[slot].bytes.fetch_add(size, memory_order_relaxed);
+            return;
+        }
+    }
+    sites[SITE_SLOTS].count.fetch_add(1, memory_order_relaxed);
+    sites[SITE_SLOTS].bytes.fetch_add(size, memory_order_relaxed);
+}
+
+void* allocate(size_t size, void* caller) {
+    allocations++;
+    totalAllocations.fetch_add(1, memory_order_relaxed);
+    if (recording.load(memory_order_relaxed)) {
+        recordSite((uintptr_t) caller, size);
+    }
+    return malloc(size ? size : 1);
+}
+
+void* allocateAligned(size_t size, size_t alignment, void* caller) {
+    allocations++;
+    totalAllocations.fetch_add(1, memory_order_relaxed);
+    if (recording.load(memory_order_relaxed)) {
+        recordSite((uintptr_t) caller, size);
+    }
+    size_t rounded = (max<size_t>(size, 1) + alignment - 1) / alignment * alignment; // aligned_alloc wants a multiple
+    return aligned_alloc(alignment, rounded);
+}
+
+string describeSite(uintptr_t address) {
+    char text[64];
+    snprintf(text, sizeof(text), "0x%llx", (unsigned long long) address);
+    string description = text;
+#ifdef __linux__
+    Dl_info info;
+    if (address && dladdr((void*) address, &info) && info.dli_fname) {
+        snprintf(text, sizeof(text), "+0x%llx", (unsigned long long) (address - (uintptr_t) info.dli_fbase));
+        description = string(info.dli_fname) + text;
+        if (info.dli_sname) {
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            description += string(" ") + (status == 0 ? demangled : info.dli_sname);
+            free(demangled);
+        }
+    }
+#endif
+    return description;
+}
+
+#endif
+
+// Something that runs one turn (or one bot choice) per step and starts new games as it goes
+struct CheckLoop {
+    const char* name;
+    long long warmup;
+    long long steps;
+    function<void()> step;
+};
+
+// Headless self-play with one policy at every seat, the players reset in place at each turn limit
+function<void()> selfPlaySteps(Policy& policy, uint64_t seed) {
+    struct State {
+        vector<Player> players{Player(0), Player(1), Player(2), Player(3)};
+        vector<GameEvent> events;
+        Board board;
+        Dice dice;
+        long long turn = 0;
+    };
+    auto state = make_shared<State>();
+    state->dice = Dice(seed);
+    state->events.reserve(DEFAULT_MAX_TURNS * MAX_CHANCES);
+    return [state, &policy]() {
+        if (state->turn % DEFAULT_MAX_TURNS == 0) {
+            for (int i = 0; i < 4; i++) {
+                state->players[i].reset(i);
+            }
+            state->events.clear();
+        }
+        playHeadlessTurn(state->players, state->turn % 4, state->board, state->dice, policy,
+                         state->turn % DEFAULT_MAX_TURNS, &state->events);
+        state->turn++;
+    };
+}
+
+// A served table: random choices from the seats, the table dealt again in place when it ends,
+// and with budget > 0 every choice searched first, as a server bot does
+function<void()> tableSteps(int budget, uint64_t seed) {
+    struct State {
+        Table table;
+        vector<GameEvent> events;
+        RolloutSearch search;
+        Dice dice;
+        uint64_t deals = 0;
+    };
+    auto state = make_shared<State>();
+    state->dice = Dice(seed);
+    state->events.reserve(64);
+    state->table.events = &state->events;
+    return [state, budget, seed]() {
+        Table& table = state->table;
+        if (table.state != Table::TABLE_WAITING) {
+            table.start(4, gameSeed(seed, state->deals++), DEFAULT_MAX_TURNS);
+            return;
+        }
+        int move = table.moves[state->dice.next() % table.moves.size()];
+        if (budget > 0) {
+            state->search.reset(table, state->dice.next());
+            state->search.run(budget, chrono::steady_clock::now() + chrono::hours(1));
+            move = state->search.best();
+        }
+        state->events.clear(); // As a table actor does for every command
+        table.play(move);
+    };
+}
+
+// A table behind a running shard worker, played as a connection plays it: each step posts one
+// command and waits for its reply, whose "ask" line names the moves to choose from
+function<void()> actorSteps(uint64_t seed) {
+    struct Client : ReplySink {
+        MpscQueue<Reply> replies;
+        void deliver(Reply* reply) override { replies.push(reply); }
+    };
+    struct State {
+        Client client;
+        Shard shard{-1};
+        shared_ptr<GameActor> actor = make_shared<GameActor>(1, 0);
+        Dice dice;
+        uint64_t deals = 0;
+        int moves[5];      // Every token and entering one
+        int moveCount = 0; // 0 until dealt and after the game ends
+    };
+    auto state = make_shared<State>();
+    state->dice = Dice(seed);
+    state->shard.start();
+    return [state, seed]() {
+        Command* command = newCommand();
+        command->from.sink = &state->client;
+        command->from.session = 1;
+        if (state->moveCount == 0) {
+            command->type = COMMAND_NEW;
+            command->value = 4;
+            command->seed = gameSeed(seed, state->deals++);
+        } else {
+            command->type = COMMAND_MOVE;
+            command->value = state->moves[state->dice.next() % state->moveCount];
+        }
+        state->shard.post(*state->actor, command);
+        Reply* reply;
+        while (!(reply = state->client.replies.pop())) {
+            this_thread::yield();
+        }
+        // "ask SEAT ROLL M,M,..." with 0 for entering a token, or "over ..."
+        string_view text = reply->text;
+        size_t ask = text.find("ask ");
+        state->moveCount = 0;
+        if (ask != string_view::npos) {
+            size_t at = text.find(' ', text.find(' ', ask + 4) + 1) + 1;
+            for (; at < text.size() && text[at] != '\n'; at++) {
+                if (text[at] != ',') {
+                    int move = text[at] - '0';
+                    state->moves[state->moveCount++] = move == 0 ? ENTER_TOKEN : move - 1;
+                }
+            }
+        }
+        freeReply(reply);
+    };
+}
+
+}
+
+#ifdef LUDO_ALLOC_TRACE
+
+void* operator new(size_t size) {
+    void* memory = allocate(size, __builtin_return_address(0));
+    if (!memory) {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new[](size_t size) {
+    void* memory = allocate(size, __builtin_return_address(0));
+    if (!memory) {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    return allocate(size, __builtin_return_address(0));
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    return allocate(size, __builtin_return_address(0));
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+    void* memory = allocateAligned(size, (size_t) alignment, __builtin_return_address(0));
+    if (!memory) {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new[](size_t size, align_val_t alignment) {
+    void* memory = allocateAligned(size, (size_t) alignment, __builtin_return_address(0));
+    if (!memory) {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, const nothrow_t&) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, const nothrow_t&) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, align_val_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, align_val_t) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t, align_val_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, size_t, align_val_t) noexcept {
+    free(memory);
+}
+
+bool allocTraceBuiltIn() {
+    return true;
+}
+
+uint64_t threadAllocations() {
+    return allocations;
+}
+
+uint64_t processAllocations() {
+    return totalAllocations.load(memory_order_relaxed);
+}
+
+void recordAllocSites(bool enabled) {
+    if (enabled) {
+        for (auto& site : sites) {
+            site.address.store(0, memory_order_relaxed);
+            site.count.store(0, memory_order_relaxed);
+            site.bytes.store(0, memory_order_relaxed);
+        }
+    }
+    recording.store(enabled, memory_order_release);
+}
+
+void printAllocSites(ostream& out, int top) {
+    struct Site {
+        uintptr_t address;
+        uint64_t count;
+        uint64_t bytes;
+    };
+    vector<Site> found;
+    for (int slot = 0; slot <= SITE_SLOTS; slot++) {
+        uint64_t count = sites[slot].count.load(memory_order_relaxed);
+        if (count) {
+            found.push_back({sites[slot].address.load(memory_order_relaxed), count,
+                             sites[slot].bytes.load(memory_order_relaxed)});
+        }
+    }
+    sort(found.begin(), found.end(), [](const Site& a, const Site& b) { return a.count > b.count; });
+    for (int i = 0; i < (int) found.size() && i < top; i++) {
+        out << "  " << found[i].count << " allocations, " << found[i].bytes << " bytes at "
+            << (found[i].address ? describeSite(found[i].address) : string("(other sites)")) << "\n";
+    }
+}
+
+#else
+
+bool allocTraceBuiltIn() {
+    return false;
+}
+
+uint64_t threadAllocations() {
+    return 0;
+}
+
+uint64_t processAllocations() {
+    return 0;
+}
+
+void recordAllocSites(bool enabled) {}
+
+void printAllocSites(ostream& out, int top) {}
+
+#endif
+
+int runAllocCheck(int argc, char** argv) {
+    long long warmup = 2000, turns = 100000;
+    int top = 10;
+    for (int i = 2; i < argc; i += 2) {
+        string option = argv[i];
+        if (i + 1 >= argc) {
+            cout << "Usage: " << argv[0] << " alloc-check [--warmup TURNS] [--turns TURNS] [--sites N]\n"
+                 << "Search loops run a hundredth of the turns. Exits 1 if any loop allocates after warmup.\n";
+            return 1;
+        }
+        if (option == "--warmup") {
+            warmup = stoll(argv[i + 1]);
+        } else if (option == "--turns") {
+            turns = stoll(argv[i + 1]);
+        } else if (option == "--sites") {
+            top = stoi(argv[i + 1]);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (!allocTraceBuiltIn()) {
+        cout << "Allocation accounting is not built in; configure with -DLUDO_ALLOC_TRACE=ON.\n";
+        return 1;
+    }
+
+    RandomPolicy random(1);
+    HeuristicPolicy heuristic{HeuristicWeights()};
+    SearchPolicy search(32, 3);
+    long long searched = max(1LL, turns / 100);
+    vector<CheckLoop> loops = {
+        {"selfplay random", warmup, turns, selfPlaySteps(random, 11)},
+        {"selfplay heuristic", warmup, turns, selfPlaySteps(heuristic, 12)},
+        {"selfplay search:32", max(1LL, warmup / 10), searched, selfPlaySteps(search, 13)},
+        {"table turns", warmup, turns, tableSteps(0, 14)},
+        {"table bot turns", max(1LL, warmup / 10), searched, tableSteps(32, 15)},
+        {"table commands", warmup, turns, actorSteps(16)},
+    };
+
+    int failed = 0;
+    for (auto& loop : loops) {
+        for (long long s = 0; s < loop.warmup; s++) {
+            loop.step();
+        }
+        recordAllocSites(true);
+        uint64_t before = processAllocations();
+        for (long long s = 0; s < loop.steps; s++) {
+            loop.step();
+        }
+        uint64_t allocated = processAllocations() - before;
+        recordAllocSites(false);
+        cout << loop.name << ": " << loop.steps << " turns after " << loop.warmup << " warmup, " << allocated
+             << " allocations" << (allocated ? "  FAIL" : "") << "\n";
+        if (allocated) {
+            printAllocSites(cout, top);
+            failed++;
+        }
+    }
+    cout << (failed ? to_string(failed) + " loops allocated after warmup\n" : string("No allocations after warmup\n"));
+    return failed ? 1 : 0;
+}
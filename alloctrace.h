@@ -0,0 +1,34 @@
+#ifndef ALLOCTRACE_H
+#define ALLOCTRACE_H
+
+#include <cstdint>
+#include <iostream>
+
+using namespace std;
+
+// Heap accounting for the game executable, built in with -DLUDO_ALLOC_TRACE=ON: the global
+// operator new and delete are replaced by malloc and free plus a per-thread allocation count.
+// While call sites are being recorded, every allocation is also added up by the address it was
+// made from (its caller, after inlining) into a fixed table that itself never allocates.
+
+// Whether operator new is being counted at all
+bool allocTraceBuiltIn();
+
+// operator new calls made by this thread so far
+uint64_t threadAllocations();
+
+// operator new calls made by every thread so far
+uint64_t processAllocations();
+
+// Starts or stops recording call sites (from every thread); starting clears the table
+void recordAllocSites(bool enabled);
+
+// The top sites recorded, by allocation count, as "module+offset symbol"; for addresses
+// without a symbol, addr2line -Cfe MODULE OFFSET names the line
+void printAllocSites(ostream& out, int top);
+
+// "alloc-check" command: fails if the simulation, table-turn or table-command loops allocate, on
+// any thread, once warmed up
+int runAllocCheck(int argc, char** argv);
+
+#endif
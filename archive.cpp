@@ -0,0 +1,124 @@
+#include "archive.h"
+
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char* eventTypeName(int type) {
+    switch (type) {
+        case EVENT_ENTER:
+            return "enter";
+        case EVENT_MOVE:
+            return "move";
+        default:
+            return "unknown";
+    }
+}
+
+int parseEventType(const string& name) {
+    for (int type = 0; type < EVENT_TYPE_COUNT; type++) {
+        if (name == eventTypeName(type)) {
+            return type;
+        }
+    }
+    return -1;
+}
+
+ArchiveWriter::ArchiveWriter(const string& path) : out(path, ios::binary) {
+    out.write(ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+}
+
+bool ArchiveWriter::ok() const {
+    return out.good();
+}
+
+void ArchiveWriter::write(const GameRecord& record) {
+    GameHeader header = record.header;
+    header.eventCount = record.events.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(record.events.data()), record.events.size() * sizeof(GameEvent));
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (mapped) {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+#endif
+}
+
+bool MappedFile::open(const string& path) {
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    size = st.st_size;
+    if (size == 0) {
+        close(fd);
+        return true;
+    }
+    void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    madvise(p, size, MADV_SEQUENTIAL);
+    data = static_cast<const uint8_t*>(p);
+    mapped = true;
+    return true;
+#else
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in) {
+        return false;
+    }
+    size = in.tellg();
+    copy.resize(size);
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(copy.data()), size);
+    data = copy.data();
+    return true;
+#endif
+}
+
+bool ArchiveReader::open(const string& path) {
+    if (!file.open(path) || file.size < sizeof(ARCHIVE_MAGIC)) {
+        return false;
+    }
+    if (memcmp(file.data, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0) {
+        return false;
+    }
+    position = sizeof(ARCHIVE_MAGIC);
+    return true;
+}
+
+bool ArchiveReader::readAt(uint64_t offset, GameHeader& header, const GameEvent*& events) const {
+    if (offset + sizeof(GameHeader) > file.size) {
+        return false;
+    }
+    memcpy(&header, file.data + offset, sizeof(header));
+    uint64_t end = offset + sizeof(GameHeader) + (uint64_t) header.eventCount * sizeof(GameEvent);
+    if (end > file.size) {
+        return false;
+    }
+    events = reinterpret_cast<const GameEvent*>(file.data + offset + sizeof(GameHeader));
+    return true;
+}
+
+bool ArchiveReader::next(GameHeader& header, const GameEvent*& events) {
+    if (!readAt(position, header, events)) {
+        return false;
+    }
+    position += sizeof(GameHeader) + (uint64_t) header.eventCount * sizeof(GameEvent);
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <fstream>
+
+using namespace std;
+
+const char ARCHIVE_MAGIC[8] = {'L', 'U', 'D', 'O', 'A', 'R', 'C', '1'};
+
+enum EventType {
+    EVENT_ENTER = 0, // A token entered play on its start square
+    EVENT_MOVE = 1,  // A token in play moved along its path
+    EVENT_TYPE_COUNT = 2
+};
+
+#pragma pack(push, 1)
+struct GameEvent {
+    uint16_t turn;
+    uint8_t seat;
+    uint8_t type;
+    int8_t token; // Index of the token that entered or moved
+    uint8_t dice;
+    int8_t from;  // Square before the move, -1 if not in play
+    int8_t to;    // Square after the move
+};
+
+struct GameHeader {
+    uint64_t seed;
+    uint8_t numPlayers;
+    uint8_t startingPlayer;
+    int8_t winner; // -1 when the game hit the turn limit without a winner
+    uint8_t leader; // Winner, or the seat furthest along when the turn limit was hit
+    uint32_t turns;
+    uint32_t eventCount;
+};
+#pragma pack(pop)
+
+struct GameRecord {
+    GameHeader header;
+    vector<GameEvent> events;
+};
+
+const char* eventTypeName(int type);
+int parseEventType(const string& name);
+
+// Appends game records to an archive file: magic, then header + events per game
+class ArchiveWriter {
+public:
+    explicit ArchiveWriter(const string& path);
+    bool ok() const;
+    void write(const GameRecord& record);
+
+private:
+    ofstream out;
+};
+
+// Read-only view of a whole file: mmap on POSIX, a heap copy elsewhere
+class MappedFile {
+public:
+    MappedFile() : data(nullptr), size(0) {}
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const string& path);
+
+    const uint8_t* data;
+    size_t size;
+
+private:
+    vector<uint8_t> copy;
+    bool mapped = false;
+};
+
+// Walks the records of a mapped archive without copying events
+class ArchiveReader {
+public:
+    bool open(const string& path);
+
+    // Returns false at the end of the archive; events points into the mapping
+    bool next(GameHeader& header, const GameEvent*& events);
+
+    // Reads the record that starts at a byte offset reported by offset()
+    bool readAt(uint64_t offset, GameHeader& header, const GameEvent*& events) const;
+    uint64_t offset() const { return position; }
+
+private:
+    MappedFile file;
+    uint64_t position = 0;
+};
+
+#endif
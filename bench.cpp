@@ -0,0 +1,338 @@
+// ludo_bench: microbenchmarks of the rules and the board rendering.
+//
+// Each benchmark is warmed up, then timed over several runs of a fixed iteration count chosen
+// during warmup, on one pinned CPU. The report gives the median and spread of nanoseconds per
+// operation; --json saves it and --baseline compares against a saved report, flagging (and
+// failing on) medians slower by more than the threshold and by more than the runs' noise.
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "ludo.h"
+#include "selfplay.h"
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+// Makes the compiler assume value is used, so the work producing it is not optimized away
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+// Stream buffer that drops everything written, reusing one small array
+class DiscardBuffer : public streambuf {
+public:
+    DiscardBuffer() { setp(space, space + sizeof(space)); }
+
+protected:
+    int overflow(int c) override {
+        setp(space, space + sizeof(space));
+        return c;
+    }
+
+private:
+    char space[256];
+};
+
+struct Benchmark {
+    const char* name;
+    function<void(long long iterations)> body;
+};
+
+struct Result {
+    string name;
+    long long iterations = 0;
+    vector<double> runs; // Nanoseconds per operation
+    double median = 0, mean = 0, stddev = 0, minimum = 0, maximum = 0;
+};
+
+double timeBody(const Benchmark& benchmark, long long iterations) {
+    auto started = Clock::now();
+    benchmark.body(iterations);
+    return chrono::duration<double, nano>(Clock::now() - started).count();
+}
+
+Result measure(const Benchmark& benchmark, int runs, double runMs, double warmupMs) {
+    Result result;
+    result.name = benchmark.name;
+
+    // Grow the iteration count until one run lasts runMs, then keep running until warmupMs is spent
+    long long iterations = 1;
+    double elapsed = 0, spent = 0;
+    while ((elapsed = timeBody(benchmark, iterations)) < runMs * 1e6) {
+        spent += elapsed;
+        double scale = elapsed > 0 ? runMs * 1e6 / elapsed : 10;
+        iterations = max(iterations + 1, (long long) (iterations * min(10.0, scale * 1.1)));
+    }
+    for (spent += elapsed; spent < warmupMs * 1e6; spent += timeBody(benchmark, iterations)) {
+    }
+    result.iterations = iterations;
+
+    for (int r = 0; r < runs; r++) {
+        result.runs.push_back(timeBody(benchmark, iterations) / iterations);
+    }
+    vector<double> sorted = result.runs;
+    sort(sorted.begin(), sorted.end());
+    size_t middle = sorted.size() / 2;
+    result.median = sorted.size() % 2 ? sorted[middle] : (sorted[middle - 1] + sorted[middle]) / 2;
+    result.minimum = sorted.front();
+    result.maximum = sorted.back();
+    for (double value : sorted) {
+        result.mean += value / sorted.size();
+    }
+    for (double value : sorted) {
+        result.stddev += (value - result.mean) * (value - result.mean);
+    }
+    result.stddev = sorted.size() > 1 ? sqrt(result.stddev / (sorted.size() - 1)) : 0;
+    return result;
+}
+
+bool writeJson(const string& path, const vector<Result>& results, int cpu) {
+    ofstream out(path);
+    out << setprecision(6) << "{\n  \"cpu\": " << cpu << ",\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        out << "    {\"name\": \"" << result.name << "\", \"median_ns\": " << result.median << ", \"mean_ns\": "
+            << result.mean << ", \"stddev_ns\": " << result.stddev << ", \"min_ns\": " << result.minimum
+            << ", \"max_ns\": " << result.maximum << ", \"runs\": " << result.runs.size() << ", \"iterations\": "
+            << result.iterations << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    return (bool) out;
+}
+
+struct Baseline {
+    double median;
+    double stddev;
+};
+
+// Reads each benchmark's median and spread back from a file written by writeJson
+bool readBaseline(const string& path, map<string, Baseline>& medians) {
+    ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    stringstream text;
+    text << in.rdbuf();
+    string json = text.str();
+    const string nameKey = "\"name\": \"", medianKey = "\"median_ns\": ", stddevKey = "\"stddev_ns\": ";
+    for (size_t at = json.find(nameKey); at != string::npos; at = json.find(nameKey, at)) {
+        at += nameKey.size();
+        size_t end = json.find('"', at);
+        size_t median = json.find(medianKey, end);
+        size_t stddev = json.find(stddevKey, end);
+        if (end == string::npos || median == string::npos || stddev == string::npos) {
+            return false;
+        }
+        medians[json.substr(at, end - at)] = {atof(json.c_str() + median + medianKey.size()),
+                                              atof(json.c_str() + stddev + stddevKey.size())};
+    }
+    return !medians.empty();
+}
+
+// Positions from random four-player games, so predicates and rendering see varied boards
+vector<vector<Player>> samplePositions(int count) {
+    vector<vector<Player>> positions;
+    RandomPolicy policy(5);
+    Dice dice(11);
+    Board board;
+    vector<Player> players;
+    for (int step = 0; (int) positions.size() < count; step++) {
+        if (step % DEFAULT_MAX_TURNS == 0) {
+            players = {Player(0), Player(1), Player(2), Player(3)};
+        }
+        int seat = step % 4;
+        int diceRoll = dice.roll();
+        vector<int> moves = legalMoves(players[seat], diceRoll);
+        if (!moves.empty()) {
+            applyMove(players[seat], policy.chooseMove(players, seat, diceRoll, moves), diceRoll, board);
+        }
+        if (step % 7 == 0) {
+            positions.push_back(players);
+        }
+    }
+    return positions;
+}
+
+}
+
+int main(int argc, char** argv) {
+    string filter, jsonPath, baselinePath;
+    int runs = 15, cpu = 0;
+    double runMs = 20, warmupMs = 100, threshold = 5;
+    for (int i = 1; i < argc; i += 2) {
+        string option = argv[i];
+        if (i + 1 >= argc) {
+            cout << "Usage: " << argv[0] << " [--filter TEXT] [--runs N] [--run-ms MS] [--warmup-ms MS] [--cpu N]\n"
+                 << "       [--json FILE] [--baseline FILE] [--threshold PERCENT]\n"
+                 << "--cpu -1 leaves the thread unpinned. With --baseline, exits 1 if any benchmark regressed.\n";
+            return 1;
+        }
+        string value = argv[i + 1];
+        if (option == "--filter") {
+            filter = value;
+        } else if (option == "--runs") {
+            runs = stoi(value);
+        } else if (option == "--run-ms") {
+            runMs = stod(value);
+        } else if (option == "--warmup-ms") {
+            warmupMs = stod(value);
+        } else if (option == "--cpu") {
+            cpu = stoi(value);
+        } else if (option == "--json") {
+            jsonPath = value;
+        } else if (option == "--baseline") {
+            baselinePath = value;
+        } else if (option == "--threshold") {
+            threshold = stod(value);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (runs < 2 || runMs <= 0 || warmupMs < 0 || threshold < 0) {
+        cout << "Runs must be at least 2, run time positive, warmup and threshold not negative.\n";
+        return 1;
+    }
+    map<string, Baseline> baseline;
+    if (!baselinePath.empty() && !readBaseline(baselinePath, baseline)) {
+        cout << "Could not read baseline " << baselinePath << "\n";
+        return 1;
+    }
+
+#ifdef __linux__
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            cout << "Could not pin to CPU " << cpu << ", running unpinned\n";
+            cpu = -1;
+        }
+    }
+#else
+    cpu = -1;
+#endif
+
+    vector<vector<Player>> positions = samplePositions(64);
+    vector<int> paths[4];
+    for (int i = 0; i < 4; i++) {
+        paths[i] = Board::getPathForPlayer(i);
+    }
+    DiscardBuffer discarded;
+    ostream sink(&discarded);
+    srand(1);
+
+    vector<Benchmark> benchmarks = {
+        {"board/getPathForPlayer", [](long long n) {
+             for (long long i = 0; i < n; i++) {
+                 const vector<int>& path = Board::getPathForPlayer(i & 3);
+                 keep(path[1]);
+             }
+         }},
+        {"token/move", [&](long long n) {
+             Token token;
+             token.enterPlay(START_POSITIONS[1]);
+             for (long long i = 0; i < n; i++) {
+                 token.move(1 + i % 6, paths[1]);
+                 keep(token.position);
+             }
+         }},
+        {"player/allTokensInHome", [&](long long n) {
+             for (long long i = 0; i < n; i++) {
+                 bool value = positions[i & 63][i & 3].allTokensInHome();
+                 keep(value);
+             }
+         }},
+        {"player/hasTokensInPlay", [&](long long n) {
+             for (long long i = 0; i < n; i++) {
+                 bool value = positions[i & 63][i & 3].hasTokensInPlay();
+                 keep(value);
+             }
+         }},
+        {"player/onlyOneTokenInPlay", [&](long long n) {
+             for (long long i = 0; i < n; i++) {
+                 bool value = positions[i & 63][i & 3].onlyOneTokenInPlay();
+                 keep(value);
+             }
+         }},
+        {"dice/rollDice", [](long long n) {
+             for (long long i = 0; i < n; i++) {
+                 int roll = rollDice();
+                 keep(roll);
+             }
+         }},
+        {"dice/Dice::roll", [](long long n) {
+             Dice dice(3);
+             for (long long i = 0; i < n; i++) {
+                 int roll = dice.roll();
+                 keep(roll);
+             }
+         }},
+        {"game/playout", [](long long n) {
+             // A whole four-player random game up to the headless turn limit, per operation
+             RandomPolicy policy(7);
+             vector<Policy*> policies(4, &policy);
+             for (long long i = 0; i < n; i++) {
+                 GameRecord record = playHeadlessGame(4, gameSeed(13, i), DEFAULT_MAX_TURNS, policies);
+                 keep(record.header.turns);
+             }
+         }},
+        {"display/displayBoard", [&](long long n) {
+             for (long long i = 0; i < n; i++) {
+                 displayBoard(positions[i & 63], sink);
+             }
+         }},
+    };
+
+    cout << "CPU " << (cpu >= 0 ? to_string(cpu) : string("unpinned")) << ", " << runs << " runs of about " << runMs
+         << " ms each after " << warmupMs << " ms warmup\n";
+    cout << left << setw(28) << "benchmark" << right << setw(12) << "median ns" << setw(10) << "mean" << setw(10)
+         << "stddev" << setw(10) << "min" << setw(10) << "max" << setw(12) << "iterations" << "\n";
+    vector<Result> results;
+    int regressions = 0;
+    for (const auto& benchmark : benchmarks) {
+        if (!filter.empty() && string(benchmark.name).find(filter) == string::npos) {
+            continue;
+        }
+        Result result = measure(benchmark, runs, runMs, warmupMs);
+        cout << fixed << setprecision(2) << left << setw(28) << result.name << right << setw(12) << result.median
+             << setw(10) << result.mean << setw(10) << result.stddev << setw(10) << result.minimum << setw(10)
+             << result.maximum << setw(12) << result.iterations;
+        auto base = baseline.find(result.name);
+        if (base != baseline.end()) {
+            double change = (result.median / base->second.median - 1) * 100;
+            // Slower by more than the threshold and by more than the noise of both sets of runs
+            double noise = 2 * sqrt(result.stddev * result.stddev + base->second.stddev * base->second.stddev);
+            bool regressed = change > threshold && result.median - base->second.median > noise;
+            cout << "  " << showpos << setprecision(1) << change << noshowpos << "% vs baseline"
+                 << (regressed ? "  REGRESSION" : change < -threshold ? "  faster" : "");
+            regressions += regressed;
+        } else if (!baseline.empty()) {
+            cout << "  (not in baseline)";
+        }
+        cout << "\n";
+        results.push_back(result);
+    }
+    if (!jsonPath.empty() && !writeJson(jsonPath, results, cpu)) {
+        cout << "Could not write " << jsonPath << "\n";
+        return 1;
+    }
+    if (!baseline.empty()) {
+        cout << regressions << " regression" << (regressions == 1 ? "" : "s") << " beyond " << threshold << "%\n";
+    }
+    return regressions > 0;
+}
@@ -0,0 +1,56 @@
+#include "bots.h"
+#include "ponder.h"
+#include "engine.h"
+
+bool BotSpec::load(const string& spec) {
+    name = spec;
+    if (spec == "random") {
+        kind = BOT_RANDOM;
+    } else if (spec.rfind("heuristic", 0) == 0) {
+        kind = BOT_HEURISTIC;
+        if (spec.size() > 10 && !weights.load(spec.substr(10))) {
+            cout << "Could not read weights " << spec.substr(10) << "\n";
+            return false;
+        }
+    } else if (spec.rfind("search", 0) == 0) {
+        kind = BOT_SEARCH;
+        if (spec.size() > 7) {
+            rollouts = atoi(spec.c_str() + 7);
+        }
+        if (rollouts < 1) {
+            cout << "Search needs at least 1 rollout: " << spec << "\n";
+            return false;
+        }
+    } else if (spec.rfind("engine:", 0) == 0) {
+        kind = BOT_ENGINE;
+        command = spec.substr(7);
+        if (command.empty()) {
+            cout << "No engine command given: " << spec << "\n";
+            return false;
+        }
+    } else {
+        kind = BOT_NETWORK;
+        shared_ptr<Network> loaded(new Network());
+        if (!loaded->load(spec)) {
+            cout << "Could not load network " << spec << "\n";
+            return false;
+        }
+        network = loaded;
+    }
+    return true;
+}
+
+unique_ptr<Policy> BotSpec::create(uint64_t seed) const {
+    switch (kind) {
+        case BOT_HEURISTIC:
+            return unique_ptr<Policy>(new HeuristicPolicy(weights));
+        case BOT_SEARCH:
+            return unique_ptr<Policy>(new SearchPolicy(rollouts, seed));
+        case BOT_ENGINE:
+            return unique_ptr<Policy>(new EnginePolicy(command, ENGINE_MOVE_MS));
+        case BOT_NETWORK:
+            return unique_ptr<Policy>(new NeuralPolicy(*network));
+        default:
+            return unique_ptr<Policy>(new RandomPolicy(seed));
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef BOTS_H
+#define BOTS_H
+
+#include <memory>
+#include <string>
+
+#include "selfplay.h"
+#include "heuristic.h"
+#include "network.h"
+
+// A bot named on the command line: "random", "heuristic[:WEIGHTS]", "search[:ROLLOUTS]",
+// "engine:COMMAND" (an external program speaking the engine.h protocol) or a network weights file.
+// Loaded once, then create() hands out independent policies (safe to call from several threads).
+class BotSpec {
+public:
+    string name;
+
+    // Returns false and prints why when the spec cannot be loaded
+    bool load(const string& spec);
+
+    unique_ptr<Policy> create(uint64_t seed) const;
+
+private:
+    enum Kind { BOT_RANDOM, BOT_HEURISTIC, BOT_SEARCH, BOT_ENGINE, BOT_NETWORK };
+    Kind kind = BOT_RANDOM;
+    HeuristicWeights weights;
+    int rollouts = 2000;
+    string command;
+    shared_ptr<const Network> network;
+};
+
+#endif
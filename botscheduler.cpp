@@ -0,0 +1,338 @@
+#include "botscheduler.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iomanip>
+#include <queue>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+const int BOT_NICE = 10; // Pool threads yield the CPU to event loops and table workers
+
+long long nanosSince(TimePoint start, TimePoint end) {
+    return chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+}
+
+}
+
+BotScheduler::BotScheduler(vector<unique_ptr<Shard>>& shards, int threads)
+    : shards(shards), threadCount(max(1, threads)), stats(new BotStats[max(1, threads)]) {}
+
+void BotScheduler::start() {
+    stopping = false;
+    for (int i = 0; i < threadCount; i++) {
+        threads.push_back(thread([this, i]() { work(i); }));
+    }
+}
+
+void BotScheduler::stop() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto& t : threads) {
+        t.join();
+    }
+    threads.clear();
+    jobs.clear();
+}
+
+long long BotScheduler::key(const BotJob& job) const {
+    TimePoint when = earliestDeadlineFirst ? job.deadline : job.submitted;
+    return chrono::duration_cast<chrono::nanoseconds>(when.time_since_epoch()).count();
+}
+
+bool BotScheduler::before(const BotJob& a, const BotJob& b) const {
+    return key(a) < key(b);
+}
+
+void BotScheduler::push(unique_ptr<BotJob> job) {
+    {
+        lock_guard<mutex> guard(lock);
+        jobs.push_back(std::move(job));
+        push_heap(jobs.begin(), jobs.end(),
+                  [this](const unique_ptr<BotJob>& a, const unique_ptr<BotJob>& b) { return before(*b, *a); });
+        earliest.store(key(*jobs.front()), memory_order_relaxed);
+    }
+    ready.notify_one();
+}
+
+void BotScheduler::submit(const shared_ptr<GameActor>& actor, const Table& table, uint32_t decision, int think) {
+    unique_ptr<BotJob> job(new BotJob());
+    job->table = actor;
+    job->traced = traceActive;
+    job->decision = decision;
+    job->submitted = Clock::now();
+    job->deadline = job->submitted + chrono::microseconds(think > 0 ? think : thinkMicros);
+    uint64_t seed;
+    {
+        lock_guard<mutex> guard(lock);
+        seed = gameSeed(actor->id, ++seeds);
+    }
+    job->search.reset(table, seed);
+    push(std::move(job));
+}
+
+size_t BotScheduler::queued() {
+    lock_guard<mutex> guard(lock);
+    return jobs.size();
+}
+
+void BotScheduler::collect(BotStats& total) {
+    for (int i = 0; i < threadCount; i++) {
+        lock_guard<mutex> guard(stats[i].lock);
+        total.queueLatency.add(stats[i].queueLatency);
+        total.decisions += stats[i].decisions;
+        total.missed += stats[i].missed;
+        total.preempted += stats[i].preempted;
+        total.rollouts += stats[i].rollouts;
+        stats[i].queueLatency.clear();
+        stats[i].decisions = stats[i].missed = stats[i].preempted = stats[i].rollouts = 0;
+    }
+}
+
+void BotScheduler::answer(BotJob& job, BotStats& counters) {
+    Command* command = newCommand();
+    command->type = COMMAND_BOT_MOVE;
+    command->value = job.search.best();
+    command->seed = job.decision;
+    command->received = job.submitted;
+    TimePoint now = Clock::now();
+    METRIC_RECORD(METRIC_BOT_SEARCH, nanosSince(job.firstSlice, now));
+    shards[job.table->shard]->post(*job.table, command);
+    lock_guard<mutex> guard(counters.lock);
+    counters.decisions++;
+    counters.missed += now > job.deadline;
+    counters.rollouts += job.search.rollouts();
+}
+
+// Runs the most urgent job one slice at a time; after each slice it either answers, keeps going,
+// or parks the job behind one that is due sooner
+void BotScheduler::work(int index) {
+#ifdef __linux__
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), BOT_NICE); // Linux nice values are per thread
+#endif
+    BotStats& counters = stats[index];
+    auto later = [this](const unique_ptr<BotJob>& a, const unique_ptr<BotJob>& b) { return before(*b, *a); };
+    while (true) {
+        unique_ptr<BotJob> job;
+        {
+            unique_lock<mutex> guard(lock);
+            ready.wait(guard, [this]() { return stopping || !jobs.empty(); });
+            if (stopping) {
+                return;
+            }
+            pop_heap(jobs.begin(), jobs.end(), later);
+            job = std::move(jobs.back());
+            jobs.pop_back();
+            earliest.store(jobs.empty() ? LLONG_MAX : key(*jobs.front()), memory_order_relaxed);
+        }
+        if (!job->started) {
+            job->started = true;
+            job->firstSlice = Clock::now();
+            lock_guard<mutex> guard(counters.lock);
+            counters.queueLatency.record(nanosSince(job->submitted, Clock::now()));
+        }
+        TraceGame quiet(false);
+        while (true) {
+            TraceSpan span("bot search slice", job->traced);
+            int slice = min(sliceRollouts, budget - job->search.rollouts());
+            span.arg = slice;
+            if (slice <= 0 || job->search.run(slice, job->deadline) < slice) {
+                answer(*job, counters); // Budget spent or time up: the best move so far
+                break;
+            }
+            if (earliest.load(memory_order_relaxed) < key(*job)) {
+                {
+                    lock_guard<mutex> guard(counters.lock);
+                    counters.preempted++;
+                }
+                push(std::move(job));
+                break;
+            }
+        }
+    }
+}
+
+namespace {
+
+// Stands in for the event loops and the human at seat 1 of every table: collects the asks it must
+// answer, the tables that finished, and how long its own moves took to be acknowledged
+class BenchSink : public ReplySink {
+public:
+    mutex lock;
+    vector<pair<int, string>> asks; // Table slot and ask line for seat 1
+    vector<int> finished;
+    LatencyHistogram humanLatency;  // Human move to its reply, through the same workers as the bots
+
+    void deliver(Reply* reply) override {
+        lock_guard<mutex> guard(lock);
+        if (reply->received != TimePoint()) {
+            humanLatency.record(nanosSince(reply->received, Clock::now()));
+        }
+        if (reply->text.rfind("over ", 0) == 0) {
+            finished.push_back(reply->session);
+        } else if (reply->text.rfind("ask 1 ", 0) == 0) {
+            asks.push_back(make_pair((int) reply->session, reply->text));
+        }
+        freeReply(reply);
+    }
+};
+
+}
+
+int runBotBench(int argc, char** argv) {
+    int tableCount = 200, workers = 1, botThreads = max(1u, thread::hardware_concurrency());
+    int players = 4, budget = 200;
+    double thinkMs = 20, humanMs = 500, seconds = 5;
+    string order = "edf";
+    for (int i = 2; i < argc; i += 2) {
+        string option = argv[i];
+        if (i + 1 >= argc) {
+            cout << "Usage: " << argv[0] << " bot-bench [--tables N] [--players P] [--workers W] [--bot-threads B]\n"
+                 << "       [--think-ms MS] [--budget ROLLOUTS] [--human-ms MS] [--order edf|fifo] [--seconds S]\n"
+                 << "Seat 1 of every table is a simulated human answering after a random delay averaging\n"
+                 << "--human-ms; the other seats are bots, with a deadline of MS on half of the tables and\n"
+                 << "ten times that on the rest.\n";
+            return 1;
+        }
+        string value = argv[i + 1];
+        if (option == "--tables") {
+            tableCount = stoi(value);
+        } else if (option == "--players") {
+            players = stoi(value);
+        } else if (option == "--workers") {
+            workers = stoi(value);
+        } else if (option == "--bot-threads") {
+            botThreads = stoi(value);
+        } else if (option == "--think-ms") {
+            thinkMs = stod(value);
+        } else if (option == "--budget") {
+            budget = stoi(value);
+        } else if (option == "--human-ms") {
+            humanMs = stod(value);
+        } else if (option == "--order") {
+            order = value;
+        } else if (option == "--seconds") {
+            seconds = stod(value);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (tableCount < 1 || workers < 1 || botThreads < 1 || players < 2 || players > 4 || budget < 1 || thinkMs <= 0 ||
+        humanMs < 0 || (order != "edf" && order != "fifo")) {
+        cout << "Tables, workers, threads and budget must be at least 1, players 2-4, order edf or fifo.\n";
+        return 1;
+    }
+
+    vector<unique_ptr<Shard>> shards;
+    for (int w = 0; w < workers; w++) {
+        shards.push_back(unique_ptr<Shard>(new Shard(-1)));
+        shards.back()->start();
+    }
+    BotScheduler scheduler(shards, botThreads);
+    scheduler.budget = budget;
+    scheduler.earliestDeadlineFirst = order == "edf";
+    scheduler.start();
+    BenchSink sink;
+
+    vector<shared_ptr<GameActor>> tables(tableCount);
+    uint64_t nextId = 0;
+    long long games = 0, humanMoves = 0;
+    auto send = [&](int slot, CommandType type, int value, uint64_t seed) {
+        Command* command = newCommand();
+        command->type = type;
+        command->from.sink = &sink;
+        command->from.session = slot;
+        command->value = value;
+        command->seed = seed;
+        if (type == COMMAND_MOVE) {
+            command->received = Clock::now();
+        }
+        shards[tables[slot]->shard]->post(*tables[slot], command);
+    };
+    auto deal = [&](int slot) {
+        uint64_t id = ++nextId;
+        tables[slot] = make_shared<GameActor>(id, id % workers);
+        tables[slot]->bots = &scheduler;
+        send(slot, COMMAND_NEW, players, gameSeed(99, id));
+        for (int seat = 1; seat < players; seat++) {
+            send(slot, COMMAND_BOT, seat, (uint64_t) (thinkMs * 1000 * (slot % 2 ? 10 : 1)));
+        }
+    };
+    for (int slot = 0; slot < tableCount; slot++) {
+        deal(slot);
+    }
+
+    // The human side: every ask for seat 1 is answered with a random legal move after its delay
+    Dice dice(5);
+    priority_queue<pair<TimePoint, pair<int, int>>, vector<pair<TimePoint, pair<int, int>>>,
+                   greater<pair<TimePoint, pair<int, int>>>> answers;
+    auto started = Clock::now();
+    auto end = started + chrono::duration<double>(seconds);
+    while (Clock::now() < end) {
+        this_thread::sleep_for(chrono::microseconds(500));
+        vector<pair<int, string>> asks;
+        vector<int> over;
+        {
+            lock_guard<mutex> guard(sink.lock);
+            asks.swap(sink.asks);
+            over.swap(sink.finished);
+        }
+        TimePoint now = Clock::now();
+        for (const auto& ask : asks) {
+            // "ask 1 ROLL M,M,...", where 0 enters a token and N moves token N
+            vector<int> moves;
+            for (size_t at = ask.second.rfind(' ') + 1; at < ask.second.size() - 1;) {
+                size_t comma = min(ask.second.find(',', at), ask.second.size() - 1);
+                int move = stoi(ask.second.substr(at, comma - at));
+                moves.push_back(move == 0 ? ENTER_TOKEN : move - 1);
+                at = comma + 1;
+            }
+            double uniform = (dice.next() >> 11) * (1.0 / 9007199254740992.0);
+            auto delay = chrono::microseconds((long long) (-humanMs * 1000 * log(1 - uniform)));
+            answers.push(make_pair(now + delay, make_pair(ask.first, moves[dice.next() % moves.size()])));
+        }
+        while (!answers.empty() && answers.top().first <= now) {
+            send(answers.top().second.first, COMMAND_MOVE, answers.top().second.second, 0);
+            answers.pop();
+            humanMoves++;
+        }
+        for (int slot : over) {
+            games++;
+            deal(slot);
+        }
+    }
+    double elapsed = chrono::duration<double>(Clock::now() - started).count();
+    scheduler.stop();
+    for (auto& shard : shards) {
+        shard->stop();
+    }
+
+    BotStats total;
+    scheduler.collect(total);
+    cout << fixed << setprecision(1) << tableCount << " tables, " << botThreads << " bot threads, " << order << ": "
+         << total.decisions / elapsed << " bot decisions/s, " << humanMoves / elapsed << " human moves/s, " << games
+         << " games finished, " << (total.decisions ? total.rollouts / (double) total.decisions : 0)
+         << " rollouts per decision\n"
+         << "bot queue latency p50 " << total.queueLatency.percentile(50) / 1000.0 << " us, p99 "
+         << total.queueLatency.percentile(99) / 1000.0 << " us; missed deadlines " << total.missed << " ("
+         << (total.decisions ? 100.0 * total.missed / total.decisions : 0) << "%), preempted slices " << total.preempted
+         << "\n";
+    lock_guard<mutex> guard(sink.lock);
+    cout << "human move replies p50 " << sink.humanLatency.percentile(50) / 1000.0 << " us, p99 "
+         << sink.humanLatency.percentile(99) / 1000.0 << " us\n";
+    return 0;
+}
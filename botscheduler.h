@@ -0,0 +1,86 @@
+#ifndef BOTSCHEDULER_H
+#define BOTSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "actor.h"
+#include "histogram.h"
+#include "rollout.h"
+
+// Bot seats on served tables. When a bot has to choose, its table's worker only copies the table
+// into a job with a deadline and a rollout budget; the search itself runs on a separate pool of
+// lower-priority threads, so human moves on the same worker never wait behind it. The pool runs
+// jobs earliest deadline first in short slices, parking a job whenever one due sooner arrives,
+// and each search answers with the best move found so far once its time or budget is spent.
+
+struct BotJob {
+    shared_ptr<GameActor> table;
+    uint32_t decision = 0; // The table's move count when asked; a later answer is stale and dropped
+    TimePoint submitted;
+    TimePoint deadline;
+    bool started = false;
+    bool traced = false;   // The table was sampled for tracing
+    TimePoint firstSlice;
+    RolloutSearch search;
+};
+
+// Counters for one pool thread, merged by whoever reports
+struct BotStats {
+    mutex lock;
+    LatencyHistogram queueLatency; // Submit to first slice, in nanoseconds
+    long long decisions = 0;
+    long long missed = 0;          // Answered after the deadline
+    long long preempted = 0;       // Slices cut short by a job due sooner
+    long long rollouts = 0;
+};
+
+class BotScheduler {
+public:
+    int thinkMicros = 50000;  // Deadline of a bot choice, counted from when the table asks
+    int budget = 2000;        // Rollouts after which a search answers early
+    int sliceRollouts = 8;    // Rollouts between looks at the queue
+    bool earliestDeadlineFirst = true; // Off: first come, first served, for comparison
+
+    BotScheduler(vector<unique_ptr<Shard>>& shards, int threads);
+    ~BotScheduler() { stop(); }
+
+    void start();
+    void stop();
+
+    // Called on the table's worker: copies table and returns at once. thinkMicros 0 uses the default.
+    void submit(const shared_ptr<GameActor>& actor, const Table& table, uint32_t decision, int thinkMicros);
+
+    // Adds every pool thread's counters since the last call into total and resets them
+    void collect(BotStats& total);
+
+    size_t queued();
+
+private:
+    vector<unique_ptr<Shard>>& shards;
+    int threadCount;
+    vector<thread> threads;
+    unique_ptr<BotStats[]> stats;
+
+    mutex lock;
+    condition_variable ready;
+    vector<unique_ptr<BotJob>> jobs; // Heap on deadline (or submit time without EDF)
+    atomic<long long> earliest{0};   // Sort key of the queue head, so a slice can check without the lock
+    bool stopping = false;
+    uint64_t seeds = 0;
+
+    void work(int index);
+    bool before(const BotJob& a, const BotJob& b) const;
+    long long key(const BotJob& job) const;
+    void push(unique_ptr<BotJob> job);
+    void answer(BotJob& job, BotStats& counters);
+};
+
+// "bot-bench" command: tables with a simulated human at seat 1 and bots with short and long
+// deadlines elsewhere, measuring missed deadlines and how long the human's moves wait meanwhile
+int runBotBench(int argc, char** argv);
+
+#endif
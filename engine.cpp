@@ -0,0 +1,455 @@
+#include "engine.h"
+#include "bots.h"
+#include "histogram.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+int moveNumber(int move) {
+    return move == ENTER_TOKEN ? 0 : move + 1;
+}
+
+// Appends " TEXT ROLL M M ..." for one query
+void appendQuery(string& out, const EngineQuery& query) {
+    char text[MAX_POSITION_TEXT];
+    serializePosition(query.position, text, sizeof(text));
+    out += text;
+    out += ' ';
+    out += to_string(query.diceRoll);
+    for (int move : query.moves) {
+        out += ' ';
+        out += to_string(moveNumber(move));
+    }
+}
+
+// Reads "TEXT ROLL M M ..." (the position being its first three fields) into query
+bool parseQuery(istringstream& in, EngineQuery& query) {
+    string seats, seat, chances;
+    if (!(in >> seats >> seat >> chances) || !parsePosition(seats + " " + seat + " " + chances, query.position) ||
+        !(in >> query.diceRoll) || query.diceRoll < 1 || query.diceRoll > 6) {
+        return false;
+    }
+    query.moves.clear();
+    int number;
+    while (in >> number) {
+        if (number < 0 || number > POSITION_TOKENS) {
+            return false;
+        }
+        query.moves.push_back(number == 0 ? ENTER_TOKEN : number - 1);
+    }
+    return true;
+}
+
+}
+
+bool EngineProcess::start() {
+    if (pid > 0) {
+        return true;
+    }
+    if (failedInARow > maxRestarts) {
+        return false;
+    }
+    signal(SIGPIPE, SIG_IGN); // An engine that died must show up as a failed write, not end the driver
+    // Close-on-exec from creation, so a child forked by another thread meanwhile cannot inherit
+    // them and hold the engine's input open; dup2 below clears the flag on stdin/stdout
+    int input[2], output[2];
+    if (pipe2(input, O_CLOEXEC) != 0) {
+        cout << "Engine " << command << ": no pipes\n";
+        return false;
+    }
+    if (pipe2(output, O_CLOEXEC) != 0) {
+        close(input[0]);
+        close(input[1]);
+        cout << "Engine " << command << ": no pipes\n";
+        return false;
+    }
+    pid = fork();
+    if (pid == 0) {
+        dup2(input[0], 0);
+        dup2(output[1], 1);
+        execl("/bin/sh", "sh", "-c", command.c_str(), (char*) nullptr);
+        _exit(127);
+    }
+    close(input[0]);
+    close(output[1]);
+    if (pid < 0) {
+        close(input[1]);
+        close(output[0]);
+        cout << "Engine " << command << ": could not fork\n";
+        return false;
+    }
+    toEngine = input[1];
+    fromEngine = output[0];
+    pending.clear();
+    if (failedInARow > 0) {
+        restarts++;
+    }
+
+    string line;
+    if (!send("ludo\n")) {
+        fail("closed its input");
+        return false;
+    }
+    auto deadline = Clock::now() + chrono::milliseconds(handshakeMs);
+    while (readLine(line, deadline)) {
+        if (line.rfind("id name ", 0) == 0) {
+            name = line.substr(8);
+        } else if (line == "ludook") {
+            return true;
+        }
+    }
+    fail(lost);
+    return false;
+}
+
+void EngineProcess::stop() {
+    if (pid <= 0) {
+        return;
+    }
+    send("quit\n");
+    close(toEngine);
+    close(fromEngine);
+    // A well-behaved engine exits on quit (or on end of input); anything else is killed
+    int status;
+    pid_t exited = 0;
+    for (int i = 0; i < 50 && (exited = waitpid(pid, &status, WNOHANG)) == 0; i++) {
+        usleep(2000);
+    }
+    if (exited == 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+    }
+    pid = -1;
+    toEngine = fromEngine = -1;
+}
+
+void EngineProcess::fail(const char* why) {
+    failures++;
+    failedInARow++;
+    cout << "Engine " << command << ": " << why << (failedInARow > maxRestarts ? ", giving up\n" : ", restarting\n");
+    if (pid > 0) {
+        kill(pid, SIGKILL); // It may still be busy with the request, and a late answer would be read as the next one's
+    }
+    stop();
+}
+
+bool EngineProcess::send(const string& text) {
+    size_t sent = 0;
+    while (sent < text.size()) {
+        ssize_t count = write(toEngine, text.data() + sent, text.size() - sent);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        sent += count;
+    }
+    return true;
+}
+
+bool EngineProcess::readLine(string& line, Clock::time_point deadline) {
+    while (true) {
+        size_t end = pending.find('\n');
+        if (end != string::npos) {
+            line.assign(pending, 0, end > 0 && pending[end - 1] == '\r' ? end - 1 : end);
+            pending.erase(0, end + 1);
+            return true;
+        }
+        auto left = chrono::duration_cast<chrono::milliseconds>(deadline - Clock::now()).count();
+        pollfd ready = {fromEngine, POLLIN, 0};
+        int count;
+        {
+            METRIC_TIME(METRIC_IO_WAIT);
+            count = poll(&ready, 1, max<long long>(0, left));
+        }
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            lost = "no answer in time";
+            return false;
+        }
+        char buffer[4096];
+        ssize_t got = read(fromEngine, buffer, sizeof(buffer));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            lost = "exited";
+            return false;
+        }
+        pending.append(buffer, got);
+    }
+}
+
+bool EngineProcess::choose(const vector<EngineQuery>& queries, int timeMs, vector<int>& moves) {
+    moves.clear();
+    if (queries.empty()) {
+        return true;
+    }
+    if (!start()) {
+        return false;
+    }
+    requests++;
+    bool single = queries.size() == 1;
+    string request;
+    if (single) {
+        char text[MAX_POSITION_TEXT];
+        serializePosition(queries[0].position, text, sizeof(text));
+        request = string("position ") + text + "\ndice " + to_string(queries[0].diceRoll) + "\nmoves";
+        for (int move : queries[0].moves) {
+            request += ' ';
+            request += to_string(moveNumber(move));
+        }
+        request += "\ngo " + to_string(timeMs) + "\n";
+    } else {
+        request = "batch " + to_string(queries.size()) + " " + to_string(timeMs) + "\n";
+        for (const auto& query : queries) {
+            request += "query ";
+            appendQuery(request, query);
+            request += '\n';
+        }
+    }
+    if (!send(request)) {
+        fail("closed its input");
+        return false;
+    }
+
+    const char* expected = single ? "bestmove" : "bestmoves";
+    auto deadline = Clock::now() + chrono::milliseconds(timeMs + graceMs);
+    string line, word;
+    while (readLine(line, deadline)) {
+        istringstream in(line);
+        if (!(in >> word) || word != expected) {
+            continue;
+        }
+        for (const auto& query : queries) {
+            int number;
+            if (!(in >> number)) {
+                break;
+            }
+            int move = number == 0 ? ENTER_TOKEN : number - 1;
+            if (find(query.moves.begin(), query.moves.end(), move) == query.moves.end()) {
+                break;
+            }
+            moves.push_back(move);
+        }
+        if (moves.size() != queries.size()) {
+            moves.clear();
+            fail("answered with an illegal move");
+            return false;
+        }
+        failedInARow = 0;
+        return true;
+    }
+    fail(lost);
+    return false;
+}
+
+int EnginePolicy::chooseMove(const vector<Player>& players, int playerIndex, int diceRoll, const vector<int>& moves) {
+    query.resize(1);
+    query[0].position = positionFromPlayers(players, playerIndex, 0);
+    query[0].diceRoll = diceRoll;
+    query[0].moves = moves;
+    if (engine.choose(query, timeMs, answer)) {
+        return answer[0];
+    }
+    return fallback.chooseMove(players, playerIndex, diceRoll, moves);
+}
+
+int runEngine(int argc, char** argv) {
+    BotSpec spec;
+    if (!spec.load(argc > 2 ? argv[2] : "heuristic")) {
+        return 1;
+    }
+    unique_ptr<Policy> policy = spec.create(time(0));
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    // The time budget of go and batch is not used: every bot spec already bounds its own thinking
+    EngineQuery current;
+    bool havePosition = false; // Cleared by a rejected position line, so go never reads a half-parsed one
+    vector<Player> players;
+    auto best = [&](EngineQuery& query) {
+        playersFromPosition(query.position, players);
+        if (query.moves.empty()) {
+            legalMoves(players[query.position.seat], query.diceRoll, query.moves);
+        }
+        if (query.moves.empty()) {
+            return -1; // Nothing to move; answered as 0, which the driver rejects
+        }
+        int move = query.moves.size() == 1 ? query.moves[0]
+                                           : policy->chooseMove(players, query.position.seat, query.diceRoll, query.moves);
+        return moveNumber(move);
+    };
+    string line, word;
+    while (getline(cin, line)) {
+        istringstream in(line);
+        if (!(in >> word)) {
+            continue;
+        }
+        if (word == "ludo") {
+            cout << "id name " << spec.name << "\nludook\n";
+        } else if (word == "isready") {
+            cout << "readyok\n";
+        } else if (word == "position") {
+            havePosition = parsePosition(line.substr(min(line.size(), (size_t) 9)), current.position);
+            if (!havePosition) {
+                cout << "info error bad position\n";
+            }
+            current.moves.clear();
+        } else if (word == "dice") {
+            if (!(in >> current.diceRoll) || current.diceRoll < 1 || current.diceRoll > 6) {
+                current.diceRoll = 0;
+                cout << "info error bad dice\n";
+            }
+        } else if (word == "moves") {
+            current.moves.clear();
+            int number;
+            while (in >> number) {
+                if (number < 0 || number > POSITION_TOKENS) {
+                    current.moves.clear();
+                    cout << "info error bad moves\n";
+                    break;
+                }
+                current.moves.push_back(number == 0 ? ENTER_TOKEN : number - 1);
+            }
+        } else if (word == "go") {
+            if (!havePosition) {
+                cout << "info error no position\nbestmove 0\n";
+            } else if (current.diceRoll == 0) {
+                cout << "info error no dice\nbestmove 0\n";
+            } else {
+                cout << "bestmove " << max(0, best(current)) << "\n";
+            }
+        } else if (word == "batch") {
+            int count = 0;
+            in >> count;
+            string answers = "bestmoves";
+            for (int i = 0; i < count && getline(cin, line); i++) {
+                istringstream query(line);
+                EngineQuery parsed;
+                int move = 0;
+                if (query >> word && word == "query" && parseQuery(query, parsed)) {
+                    move = max(0, best(parsed));
+                }
+                answers += ' ';
+                answers += to_string(move);
+            }
+            cout << answers << "\n";
+        } else if (word == "quit") {
+            break;
+        } else {
+            cout << "info error unknown command " << word << "\n";
+        }
+        cout.flush();
+    }
+    return 0;
+}
+
+int runEngineBench(int argc, char** argv) {
+    string command = string(argv[0]) + " engine heuristic";
+    int count = 2000, batch = 64, timeMs = 1000;
+    for (int i = 2; i < argc; i += 2) {
+        string option = argv[i];
+        if (i + 1 >= argc) {
+            cout << "Usage: " << argv[0] << " engine-bench [--engine COMMAND] [--positions N] [--batch B] [--ms MS]\n"
+                 << "COMMAND defaults to this program's own engine command with the heuristic bot.\n";
+            return 1;
+        }
+        string value = argv[i + 1];
+        if (option == "--engine") {
+            command = value;
+        } else if (option == "--positions") {
+            count = stoi(value);
+        } else if (option == "--batch") {
+            batch = stoi(value);
+        } else if (option == "--ms") {
+            timeMs = stoi(value);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (count < 1 || batch < 1 || timeMs < 1) {
+        cout << "Positions, batch and time must be at least 1.\n";
+        return 1;
+    }
+
+    // Real choices from random four-player games
+    vector<EngineQuery> queries;
+    RandomPolicy mover(41);
+    Dice dice(43);
+    Board board;
+    vector<Player> players;
+    int seat = 0, chances = 0, turns = 0;
+    while ((int) queries.size() < count) {
+        if (players.empty()) {
+            players = {Player(0), Player(1), Player(2), Player(3)};
+            seat = chooseStartingPlayer(dice, 4);
+            chances = turns = 0;
+        }
+        int diceRoll = dice.roll();
+        vector<int> moves = legalMoves(players[seat], diceRoll);
+        if (moves.size() > 1) {
+            queries.push_back({positionFromPlayers(players, seat, chances), diceRoll, moves});
+        }
+        if (!moves.empty()) {
+            applyMove(players[seat], mover.chooseMove(players, seat, diceRoll, moves), diceRoll, board);
+        }
+        if (players[seat].allTokensInHome() || ++turns > DEFAULT_MAX_TURNS) {
+            players.clear();
+        } else if (diceRoll == 6 && ++chances < MAX_CHANCES) {
+            continue;
+        } else {
+            chances = 0;
+            seat = (seat + 1) % 4;
+        }
+    }
+
+    EngineProcess engine(command);
+    if (!engine.start()) {
+        return 1;
+    }
+    cout << "Engine: " << engine.name << "\n";
+    vector<int> single, batched, answer;
+    for (int pass = 0; pass < 2; pass++) {
+        int size = pass == 0 ? 1 : batch;
+        vector<int>& moves = pass == 0 ? single : batched;
+        LatencyHistogram roundTrips;
+        auto started = Clock::now();
+        for (int first = 0; first < count; first += size) {
+            vector<EngineQuery> part(queries.begin() + first, queries.begin() + min(count, first + size));
+            auto sent = Clock::now();
+            if (!engine.choose(part, timeMs, answer)) {
+                answer.assign(part.size(), -2); // Counted as a disagreement below
+            }
+            roundTrips.record(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - sent).count());
+            moves.insert(moves.end(), answer.begin(), answer.end());
+        }
+        double seconds = chrono::duration<double>(Clock::now() - started).count();
+        cout << fixed << setprecision(1) << "batch " << setw(4) << size << ": " << count / seconds << " positions/s, "
+             << seconds * 1e6 / count << " us per position, round trip p50 " << roundTrips.percentile(50) / 1e3
+             << " us, p99 " << roundTrips.percentile(99) / 1e3 << " us\n";
+    }
+    int agree = 0;
+    for (int i = 0; i < count; i++) {
+        agree += single[i] == batched[i] && single[i] != -2;
+    }
+    cout << agree << "/" << count << " answers agree between single and batched requests; " << engine.failures
+         << " failures, " << engine.restarts << " restarts\n";
+    return 0;
+}
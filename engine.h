@@ -0,0 +1,98 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <string>
+
+#include "position.h"
+#include "heuristic.h"
+#include "selfplay.h"
+
+// Line-based protocol for bots running as separate programs, in the spirit of UCI. The driver
+// writes to the engine's stdin and reads its stdout; moves are 0 to enter a token, 1-4 to move one.
+//
+//   ludo                      -> id name NAME ... ludook     handshake, once after starting
+//   isready                   -> readyok
+//   position TEXT             position.h notation, the seat to move included
+//   dice N                    the roll to play, 1-6
+//   moves M M ...             the legal moves for that roll
+//   go MS                     -> bestmove M                  think at most MS milliseconds
+//   batch N MS                followed by N lines "query TEXT ROLL M M ..."
+//                             -> bestmoves M M ...           one answer per query, in order
+//   quit
+//
+// A position's text is three space-separated fields, so a query line splits on spaces alone.
+// Other lines from the engine ("info ..." and the like) are ignored while waiting for an answer.
+// Batches answer many positions in one round trip, which matters when the engine is fast
+// compared with a context switch through the pipes.
+
+const int ENGINE_MOVE_MS = 1000; // Time budget of an engine bot named on the command line
+
+struct EngineQuery {
+    Position position;
+    int diceRoll = 0;
+    vector<int> moves; // As returned by legalMoves
+};
+
+// One engine as a child process. Anything unexpected -- a crash, garbage, an illegal move, no
+// answer within the time plus a grace period -- kills the process and starts a fresh one for the
+// next request, so a broken engine costs one answer rather than the game.
+class EngineProcess {
+public:
+    int graceMs = 200;      // Allowance over the time budget for pipes and scheduling
+    int handshakeMs = 5000; // Time to start up and answer "ludo"
+    int maxRestarts = 5;    // Gives up on the engine after this many failures in a row
+    string name;            // From "id name", once started
+
+    long long requests = 0;
+    long long failures = 0;
+    long long restarts = 0;
+
+    explicit EngineProcess(const string& command) : command(command) {}
+    ~EngineProcess() { stop(); }
+
+    // Starts the engine if it is not running; false (and prints why) if it will not start
+    bool start();
+    void stop();
+
+    // Fills moves with the engine's choice for every query, taking at most timeMs in total
+    bool choose(const vector<EngineQuery>& queries, int timeMs, vector<int>& moves);
+
+private:
+    string command;
+    pid_t pid = -1;
+    int toEngine = -1;
+    int fromEngine = -1;
+    string pending;        // Read but not yet returned as a line
+    const char* lost = ""; // Why readLine last came back empty
+    int failedInARow = 0;
+
+    bool send(const string& text);
+    bool readLine(string& line, chrono::steady_clock::time_point deadline);
+    void fail(const char* why);
+};
+
+// An engine as a Policy. Falls back to the heuristic for a choice the engine failed to make.
+class EnginePolicy : public Policy {
+public:
+    EnginePolicy(const string& command, int timeMs) : engine(command), timeMs(timeMs) {}
+
+    int chooseMove(const vector<Player>& players, int playerIndex, int diceRoll, const vector<int>& moves) override;
+
+private:
+    EngineProcess engine;
+    int timeMs;
+    HeuristicPolicy fallback{HeuristicWeights()};
+    vector<EngineQuery> query;
+    vector<int> answer;
+};
+
+// "engine" command: speaks the protocol on stdin/stdout for a bot spec, as a reference engine
+int runEngine(int argc, char** argv);
+
+// "engine-bench" command: round trips per position with single and batched requests
+int runEngineBench(int argc, char** argv);
+
+#endif
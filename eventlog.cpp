@@ -0,0 +1,310 @@
+#include "eventlog.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+const int RING_SIZE = 1 << 12;       // Events queued before a producer waits for the drain
+const int BATCH_BYTES = 1 << 16;     // Rendered text written out in one go
+const int DRAIN_MS = 10;
+
+// Bounded multi-producer ring: a cell's sequence says whose turn it is, so producers only race
+// for the enqueue position and the single drain needs no atomic read-modify-write at all
+struct Cell {
+    atomic<uint64_t> sequence;
+    LogEvent event;
+};
+
+Cell cells[RING_SIZE];
+atomic<uint64_t> enqueued{0};
+uint64_t dequeued = 0;          // Drain thread only
+atomic<uint64_t> written{0};    // Events rendered and handed to stdout
+char batch[BATCH_BYTES];
+
+mutex control; // Serializes start and stop
+mutex sleepLock;
+condition_variable wake;
+condition_variable flushed;
+atomic<bool> running{false};
+bool stopping = false;
+LogFormat logFormat = LOG_TEXT;
+int logLevel = LUDO_LOG_LEVEL;
+thread drainer;
+
+// Text of token's square: its number, H when home, NP when not in play
+char* putSquare(char* out, int square) {
+    if (square == HOME_POSITION) {
+        *out++ = 'H';
+    } else if (square < 0) {
+        *out++ = 'N';
+        *out++ = 'P';
+    } else {
+        out += sprintf(out, "%d", square);
+    }
+    return out;
+}
+
+int renderText(const LogEvent& event, char* out) {
+    int seat = event.seat + 1;
+    switch (event.type) {
+        case GAME_ASK_PLAYERS:
+            return sprintf(out, "Enter the number of players (2-4): ");
+        case GAME_ASK_START_ROLL:
+            return sprintf(out, "Player %d's turn. Press Enter to roll the dice.", seat);
+        case GAME_START_ROLL:
+            return sprintf(out, "Player %d rolled a %d\n", seat, event.value);
+        case GAME_STARTS:
+            return sprintf(out, "Player %d starts the game!\n", seat);
+        case GAME_TURN:
+            return sprintf(out, "\nPlayer %d's turn.\n", seat);
+        case GAME_ROLL:
+            return sprintf(out, "You rolled a %d\n", event.value);
+        case GAME_BOT_ENTER:
+            return sprintf(out, "The bot enters a new token into play.\n");
+        case GAME_BOT_MOVE:
+            return sprintf(out, "The bot moves token %d %d spaces.\n", event.token + 1, event.value);
+        case GAME_SKIP:
+            return sprintf(out, "No tokens in play and you did not roll a 6. Turn skipped.\n");
+        case GAME_MUST_ENTER:
+            return sprintf(out, "You rolled a 6. No tokens are in play, so you must enter a token into play.\n");
+        case GAME_ASK_SIX:
+            return sprintf(out, "You rolled a 6. Choose an option:\n1. Move a token 6 spaces.\n"
+                                "2. Enter a new token into play.\n");
+        case GAME_MUST_MOVE:
+            return sprintf(out, "You rolled a 6. No tokens are out of play, so you must move a token 6 spaces.\n");
+        case GAME_ASK_TOKEN:
+            return sprintf(out, "Choose a token to move %d spaces (1-%d):\n", event.value, event.token);
+        case GAME_INVALID:
+            return sprintf(out, "Invalid choice. Try again:\n");
+        case GAME_INPUT_CLOSED:
+            return sprintf(out, "\nInput closed, quitting.\n");
+        case GAME_BOARD: {
+            char* at = out + sprintf(out, "\nCurrent Board:\n");
+            for (int p = 0; p < event.value; p++) {
+                at += sprintf(at, "Player %d tokens: ", p + 1);
+                for (int t = 0; t < 4; t++) {
+                    at = putSquare(at, event.squares[p][t]);
+                    *at++ = ' ';
+                }
+                *at++ = '\n';
+            }
+            return at - out;
+        }
+        case GAME_WIN:
+            return sprintf(out, "Player %d wins!\n", seat);
+    }
+    return 0;
+}
+
+const char* const COMPACT_NAMES[] = {"ask-players", "ask-start-roll", "start-roll", "starts", "turn", "roll",
+                                     "enter", "move", "skip", "must-enter", "ask-six", "must-move", "ask-token",
+                                     "invalid", "input-closed", "board", "win"};
+
+int renderCompact(const LogEvent& event, char* out) {
+    char* at = out + sprintf(out, "%s", COMPACT_NAMES[event.type]);
+    if (event.type != GAME_BOARD) {
+        at += sprintf(at, " %d", event.seat + 1);
+    }
+    switch (event.type) {
+        case GAME_START_ROLL:
+        case GAME_ROLL:
+            at += sprintf(at, " %d", event.value);
+            break;
+        case GAME_BOT_MOVE:
+            at += sprintf(at, " %d %d", event.token + 1, event.value);
+            break;
+        case GAME_ASK_TOKEN:
+            at += sprintf(at, " %d", event.value);
+            break;
+        case GAME_BOARD:
+            for (int p = 0; p < event.value; p++) {
+                *at++ = p ? '/' : ' ';
+                for (int t = 0; t < 4; t++) {
+                    if (t) {
+                        *at++ = ',';
+                    }
+                    at = putSquare(at, event.squares[p][t]);
+                }
+            }
+            break;
+    }
+    *at++ = '\n';
+    return at - out;
+}
+
+// Prompts wait for an answer, so in compact logs they still read as text
+bool isPrompt(const LogEvent& event) {
+    switch (event.type) {
+        case GAME_ASK_PLAYERS:
+        case GAME_ASK_START_ROLL:
+        case GAME_MUST_ENTER:
+        case GAME_ASK_SIX:
+        case GAME_MUST_MOVE:
+        case GAME_ASK_TOKEN:
+        case GAME_INVALID:
+        case GAME_INPUT_CLOSED:
+            return true;
+    }
+    return false;
+}
+
+void resetCells() {
+    for (int i = 0; i < RING_SIZE; i++) {
+        cells[i].sequence.store(i, memory_order_relaxed);
+    }
+    enqueued.store(0, memory_order_relaxed);
+    dequeued = 0;
+    written.store(0, memory_order_relaxed);
+}
+
+// Renders everything published so far into the batch, writing it whenever it fills up
+void drain() {
+    int length = 0;
+    while (true) {
+        Cell& cell = cells[dequeued & (RING_SIZE - 1)];
+        if (cell.sequence.load(memory_order_acquire) != dequeued + 1) {
+            break;
+        }
+        if (length > BATCH_BYTES - EVENT_TEXT_MAX) {
+            fwrite(batch, 1, length, stdout);
+            length = 0;
+        }
+        length += renderEvent(cell.event, logFormat, batch + length);
+        cell.sequence.store(dequeued + RING_SIZE, memory_order_release);
+        dequeued++;
+    }
+    if (length) {
+        fwrite(batch, 1, length, stdout);
+        fflush(stdout);
+    }
+    {
+        lock_guard<mutex> guard(sleepLock);
+        written.store(dequeued, memory_order_release);
+    }
+    flushed.notify_all();
+}
+
+void drainLoop() {
+    unique_lock<mutex> guard(sleepLock);
+    while (!stopping) {
+        wake.wait_for(guard, chrono::milliseconds(DRAIN_MS));
+        guard.unlock();
+        drain();
+        guard.lock();
+    }
+}
+
+void wakeDrainer() {
+    lock_guard<mutex> guard(sleepLock);
+    wake.notify_one();
+}
+
+void writeNow(const LogEvent& event) {
+    char text[EVENT_TEXT_MAX];
+    fwrite(text, 1, renderEvent(event, logFormat, text), stdout);
+}
+
+}
+
+LogEvent boardEvent(const vector<Player>& players) {
+    LogEvent event;
+    event.type = GAME_BOARD;
+    event.value = players.size();
+    for (size_t p = 0; p < players.size() && p < 4; p++) {
+        for (size_t t = 0; t < players[p].tokens.size() && t < 4; t++) {
+            const Token& token = players[p].tokens[t];
+            event.squares[p][t] = token.hasWon() ? HOME_POSITION : token.inPlay ? token.position : -1;
+        }
+    }
+    return event;
+}
+
+int renderEvent(const LogEvent& event, LogFormat format, char* out) {
+    if (event.type > GAME_WIN) {
+        return 0;
+    }
+    return format == LOG_COMPACT && !isPrompt(event) ? renderCompact(event, out) : renderText(event, out);
+}
+
+void startEventLog(LogFormat format, int level) {
+    lock_guard<mutex> guard(control);
+    if (running) {
+        return;
+    }
+    static bool registered = false;
+    if (!registered) {
+        atexit(stopEventLog); // Runs before the drain thread object is destroyed
+        registered = true;
+    }
+    logFormat = format;
+    logLevel = level;
+    resetCells();
+    stopping = false;
+    drainer = thread(drainLoop);
+    running.store(true, memory_order_release);
+}
+
+void logEvent(int level, const LogEvent& event) {
+    if (level > logLevel) {
+        return;
+    }
+    if (!running.load(memory_order_acquire)) {
+        writeNow(event);
+        return;
+    }
+    uint64_t position = enqueued.load(memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[position & (RING_SIZE - 1)];
+        int64_t lag = (int64_t) (cell->sequence.load(memory_order_acquire) - position);
+        if (lag == 0) {
+            if (enqueued.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                break;
+            }
+        } else if (lag < 0) {
+            // Full: the transcript must stay whole, so wait for the drain rather than drop
+            wakeDrainer();
+            this_thread::yield();
+            position = enqueued.load(memory_order_relaxed);
+        } else {
+            position = enqueued.load(memory_order_relaxed);
+        }
+    }
+    cell->event = event;
+    cell->sequence.store(position + 1, memory_order_release);
+}
+
+void flushEvents() {
+    if (!running.load(memory_order_acquire)) {
+        fflush(stdout);
+        return;
+    }
+    uint64_t target = enqueued.load(memory_order_acquire);
+    unique_lock<mutex> guard(sleepLock);
+    while (written.load(memory_order_acquire) < target) {
+        wake.notify_one();
+        flushed.wait_for(guard, chrono::milliseconds(DRAIN_MS));
+    }
+}
+
+void stopEventLog() {
+    lock_guard<mutex> guard(control);
+    if (!running) {
+        return;
+    }
+    {
+        lock_guard<mutex> sleeping(sleepLock);
+        stopping = true;
+    }
+    wake.notify_one();
+    drainer.join();
+    running.store(false, memory_order_release);
+    drain(); // Anything posted while the thread was finishing
+}
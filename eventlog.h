@@ -0,0 +1,106 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <cstdint>
+#include <vector>
+
+#include "ludo.h"
+
+// Console output of the game as structured events. A turn posts small fixed-size events into a
+// lock-free ring buffer and goes on; a background thread renders them, as the familiar text or
+// as one compact line per event, into a large buffer that is written out in batches. Nothing is
+// flushed per line: whoever reads input calls flushEvents() first so the prompt is on screen.
+//
+// Events above LUDO_LOG_LEVEL (a CMake cache variable) compile to nothing; prompts and the
+// messages a human needs to play are always built in.
+
+#ifndef LUDO_LOG_LEVEL
+#define LUDO_LOG_LEVEL 3
+#endif
+
+enum LogLevel {
+    LOG_LEVEL_PROMPT = 0, // Prompts and the answers to them
+    LOG_LEVEL_RESULT = 1, // Who starts and who wins
+    LOG_LEVEL_TURN = 2,   // Turns, rolls and moves
+    LOG_LEVEL_BOARD = 3,  // The board after every turn
+};
+
+enum LogEventType : uint8_t {
+    GAME_ASK_PLAYERS = 0,
+    GAME_ASK_START_ROLL,
+    GAME_START_ROLL, // value: the roll
+    GAME_STARTS,
+    GAME_TURN,
+    GAME_ROLL,      // value: the roll
+    GAME_BOT_ENTER,
+    GAME_BOT_MOVE,  // value: the steps, token: which
+    GAME_SKIP,
+    GAME_MUST_ENTER,
+    GAME_ASK_SIX,
+    GAME_MUST_MOVE,
+    GAME_ASK_TOKEN, // value: the steps, token: how many tokens
+    GAME_INVALID,
+    GAME_INPUT_CLOSED,
+    GAME_BOARD,     // value: the number of players, squares: the tokens
+    GAME_WIN,
+};
+
+struct LogEvent {
+    uint8_t type = 0;
+    int8_t seat = 0;
+    int8_t value = 0;
+    int8_t token = 0;
+    int8_t squares[4][4] = {}; // Board square per token, -1 off the board, HOME_POSITION when home
+};
+
+enum LogFormat {
+    LOG_TEXT = 0, // What the game has always printed
+    LOG_COMPACT,  // "roll 2 6": the event, the seat from 1, then its numbers
+};
+
+const int EVENT_TEXT_MAX = 256; // Longest rendering of one event
+
+inline LogEvent logEventOf(LogEventType type, int seat = 0, int value = 0, int token = 0) {
+    LogEvent event;
+    event.type = type;
+    event.seat = seat;
+    event.value = value;
+    event.token = token;
+    return event;
+}
+
+LogEvent boardEvent(const vector<Player>& players);
+
+// Writes event into out (EVENT_TEXT_MAX bytes), returning the length
+int renderEvent(const LogEvent& event, LogFormat format, char* out);
+
+// Starts the drain thread writing to stdout, keeping events up to level; stopped at exit
+void startEventLog(LogFormat format, int level);
+
+// Queues event; before startEventLog, or when stopped, writes it straight away
+void logEvent(int level, const LogEvent& event);
+
+// Returns once everything logged so far is written
+void flushEvents();
+
+// Drains the ring and ends the drain thread
+void stopEventLog();
+
+#define LOG_PROMPT(...) logEvent(LOG_LEVEL_PROMPT, logEventOf(__VA_ARGS__))
+#if LUDO_LOG_LEVEL >= 1
+#define LOG_RESULT(...) logEvent(LOG_LEVEL_RESULT, logEventOf(__VA_ARGS__))
+#else
+#define LOG_RESULT(...) ((void) 0)
+#endif
+#if LUDO_LOG_LEVEL >= 2
+#define LOG_TURN(...) logEvent(LOG_LEVEL_TURN, logEventOf(__VA_ARGS__))
+#else
+#define LOG_TURN(...) ((void) 0)
+#endif
+#if LUDO_LOG_LEVEL >= 3
+#define LOG_BOARD(players) logEvent(LOG_LEVEL_BOARD, boardEvent(players))
+#else
+#define LOG_BOARD(players) ((void) 0)
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+#include "heuristic.h"
+
+#include <fstream>
+
+const char* heuristicTermName(int term) {
+    switch (term) {
+        case TERM_PROGRESS:
+            return "progress";
+        case TERM_IN_PLAY:
+            return "in_play";
+        case TERM_HOME:
+            return "home";
+        case TERM_SAFE:
+            return "safe";
+        case TERM_DANGER:
+            return "danger";
+        default:
+            return "unknown";
+    }
+}
+
+bool HeuristicWeights::load(const string& path) {
+    ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    string name;
+    double value;
+    while (in >> name >> value) {
+        for (int term = 0; term < TERM_COUNT; term++) {
+            if (name == heuristicTermName(term)) {
+                values[term] = value;
+            }
+        }
+    }
+    return in.eof();
+}
+
+bool HeuristicWeights::save(const string& path) const {
+    ofstream out(path);
+    write(out);
+    return out.good();
+}
+
+void HeuristicWeights::write(ostream& out) const {
+    out.precision(17);
+    for (int term = 0; term < TERM_COUNT; term++) {
+        out << heuristicTermName(term) << " " << values[term] << "\n";
+    }
+}
+
+void heuristicFeatures(const vector<Player>& players, const Player& mover, double features[TERM_COUNT]) {
+    for (int term = 0; term < TERM_COUNT; term++) {
+        features[term] = 0;
+    }
+    for (const auto& token : mover.tokens) {
+        if (!token.inPlay) {
+            continue;
+        }
+        features[TERM_IN_PLAY] += 1;
+        if (token.hasWon()) {
+            features[TERM_HOME] += 1;
+            continue;
+        }
+        features[TERM_PROGRESS] += tokenProgress(token, mover.playerIndex) / (double) BOARD_SIZE;
+        if (find(START_POSITIONS.begin(), START_POSITIONS.end(), token.position) != START_POSITIONS.end()) {
+            features[TERM_SAFE] += 1;
+            continue;
+        }
+        bool threatened = false;
+        for (const auto& other : players) {
+            if (other.playerIndex == mover.playerIndex) {
+                continue;
+            }
+            for (const auto& opponent : other.tokens) {
+                int gap = (token.position - opponent.position + BOARD_SIZE) % BOARD_SIZE;
+                if (opponent.inPlay && !opponent.hasWon() && gap >= 1 && gap <= 6) {
+                    threatened = true;
+                }
+            }
+        }
+        if (threatened) {
+            features[TERM_DANGER] += 1;
+        }
+    }
+}
+
+int HeuristicPolicy::chooseMove(const vector<Player>& players, int playerIndex, int diceRoll, const vector<int>& moves) {
+    Board board;
+    int best = moves[0];
+    double bestScore = 0;
+    for (int i = 0; i < moves.size(); i++) {
+        next = players[playerIndex];
+        applyMove(next, moves[i], diceRoll, board);
+        double features[TERM_COUNT];
+        heuristicFeatures(players, next, features);
+        double score = 0;
+        for (int term = 0; term < TERM_COUNT; term++) {
+            score += weights.values[term] * features[term];
+        }
+        if (i == 0 || score > bestScore) {
+            best = moves[i];
+            bestScore = score;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,44 @@
+#ifndef HEURISTIC_H
+#define HEURISTIC_H
+
+#include <string>
+
+#include "ludo.h"
+#include "selfplay.h"
+
+enum HeuristicTerm {
+    TERM_PROGRESS = 0, // Steps travelled by tokens in play, in board laps
+    TERM_IN_PLAY,      // Tokens entered into play
+    TERM_HOME,         // Tokens at the home position
+    TERM_SAFE,         // Tokens on a start square
+    TERM_DANGER,       // Tokens with an opponent 1-6 squares behind them off the start squares
+    TERM_COUNT
+};
+
+struct HeuristicWeights {
+    double values[TERM_COUNT] = {1.0, 0.5, 2.0, 0.3, -0.5};
+
+    // Text file with one "name value" line per term; missing terms keep their defaults
+    bool load(const string& path);
+    bool save(const string& path) const;
+    void write(ostream& out) const;
+};
+
+const char* heuristicTermName(int term);
+
+// Features of the mover's tokens, given the other players' positions
+void heuristicFeatures(const vector<Player>& players, const Player& mover, double features[TERM_COUNT]);
+
+// Cheap bot: plays the move whose resulting position scores highest under the weights
+class HeuristicPolicy : public Policy {
+public:
+    explicit HeuristicPolicy(const HeuristicWeights& weights) : weights(weights) {}
+
+    int chooseMove(const vector<Player>& players, int playerIndex, int diceRoll, const vector<int>& moves) override;
+
+private:
+    HeuristicWeights weights;
+    Player next{0}; // Scratch for the position after each move, reused so choosing allocates nothing
+};
+
+#endif
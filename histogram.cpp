@@ -0,0 +1,58 @@
+#include "histogram.h"
+
+#include <algorithm>
+
+using namespace std;
+
+int LatencyHistogram::bucketOf(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return value;
+    }
+    int magnitude = (63 - __builtin_clzll(value)) - (SUB_BUCKET_BITS - 1); // value >> magnitude is in [64, 128)
+    int bucket = SUB_BUCKETS + (magnitude - 1) * HALF_BUCKETS + (int) ((value >> magnitude) - HALF_BUCKETS);
+    return min(bucket, BUCKETS - 1);
+}
+
+uint64_t LatencyHistogram::highestIn(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    int magnitude = (bucket - SUB_BUCKETS) / HALF_BUCKETS + 1;
+    uint64_t sub = (bucket - SUB_BUCKETS) % HALF_BUCKETS + HALF_BUCKETS;
+    return ((sub + 1) << magnitude) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    counts[bucketOf(value)]++;
+    total++;
+    largest = std::max(largest, value);
+}
+
+void LatencyHistogram::add(const LatencyHistogram& other) {
+    for (int i = 0; i < BUCKETS; i++) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    largest = std::max(largest, other.largest);
+}
+
+void LatencyHistogram::clear() {
+    fill(counts, counts + BUCKETS, 0);
+    total = 0;
+    largest = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double percent) const {
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t wanted = std::max<uint64_t>(1, (uint64_t) (total * percent / 100 + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= wanted) {
+            return min(highestIn(i), largest);
+        }
+    }
+    return largest;
+}
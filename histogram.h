@@ -0,0 +1,36 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <cstdint>
+
+// Log-linear latency histogram in the style of HdrHistogram: every value up to about 2^46 keeps
+// two significant digits (under 1% error) in a fixed array, so record() is a few shifts and an
+// increment, and histograms from several threads merge by adding counts.
+class LatencyHistogram {
+public:
+    void record(uint64_t value);
+    void add(const LatencyHistogram& other);
+    void clear();
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return largest; }
+
+    // Value at or below which percent of the records fall, to bucket precision
+    uint64_t percentile(double percent) const;
+
+private:
+    static const int SUB_BUCKET_BITS = 7;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int HALF_BUCKETS = SUB_BUCKETS / 2;
+    static const int MAGNITUDES = 40;
+    static const int BUCKETS = SUB_BUCKETS + MAGNITUDES * HALF_BUCKETS;
+
+    uint64_t counts[BUCKETS] = {};
+    uint64_t total = 0;
+    uint64_t largest = 0;
+
+    static int bucketOf(uint64_t value);
+    static uint64_t highestIn(int bucket);
+};
+
+#endif
@@ -0,0 +1,498 @@
+#include "loadgen.h"
+#include "histogram.h"
+#include "selfplay.h"
+#include "net.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+enum LoadCommand { LOAD_NEW, LOAD_MOVE, LOAD_COMMAND_COUNT };
+const char* LOAD_COMMAND_NAMES[LOAD_COMMAND_COUNT] = {"new", "move"};
+
+const int MAX_EVENTS = 256;
+
+struct LoadSettings {
+    string unixPath;
+    string host = "127.0.0.1";
+    int port = 7777;
+    int players = 2;
+    double thinkMs = 0; // Mean of an exponential think time; 0 answers as fast as possible
+    int spectators = 0; // Connections watching each client's current table
+    int bots = 0;       // Trailing seats of each table handed to server bots
+};
+
+const uint32_t SPECTATOR_FLAG = 0x80000000; // Marks epoll data that indexes spectators, not clients
+
+struct Client {
+    int fd = -1;
+    string input;
+    int outstanding = -1;      // LoadCommand waiting for its reply, or -1
+    Clock::time_point sentAt;
+    string next;               // Sent when the think time is over
+    int nextType = LOAD_NEW;
+    int firstSpectator = 0;    // This client's spectators are the next settings.spectators entries
+};
+
+// What one generator thread hands to the reporter; latencies are in nanoseconds since the last report
+struct GeneratorStats {
+    mutex lock;
+    LatencyHistogram latency[LOAD_COMMAND_COUNT];
+    long long errors = 0;
+    long long games = 0;
+    long long spectatorBytes = 0;
+};
+
+// One thread's share of the simulated clients, multiplexed over its own epoll instance.
+// Each client deals a table, answers every ask with a random legal move and deals again at the end.
+class Generator {
+public:
+    atomic<int> target{0}; // Sessions this thread should hold open
+    atomic<bool> failed{false};
+
+    Generator(const LoadSettings& settings, GeneratorStats& stats, uint64_t seed)
+        : settings(settings), stats(stats), dice(seed) {}
+
+    ~Generator() {
+        for (auto& client : clients) {
+            close(client.fd);
+        }
+        for (int fd : spectators) {
+            close(fd);
+        }
+        if (epoll >= 0) {
+            close(epoll);
+        }
+    }
+
+    void run(const atomic<bool>& stop) {
+        epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll < 0) {
+            failed = true;
+            return;
+        }
+        epoll_event events[MAX_EVENTS];
+        while (!stop && !failed) {
+            while ((int) clients.size() < target && !failed) {
+                openClient();
+            }
+
+            auto now = Clock::now();
+            while (!timers.empty() && timers.top().first <= now) {
+                Client& client = clients[timers.top().second];
+                timers.pop();
+                send(client, client.next, client.nextType);
+            }
+            int timeout = 50;
+            if (!timers.empty()) {
+                auto wait = chrono::duration_cast<chrono::milliseconds>(timers.top().first - now).count();
+                timeout = (int) max<long long>(0, min<long long>(wait, timeout));
+            }
+
+            int ready = epoll_wait(epoll, events, MAX_EVENTS, timeout);
+            for (int i = 0; i < ready; i++) {
+                uint32_t tag = events[i].data.u32;
+                if (tag & SPECTATOR_FLAG) {
+                    readFrames(spectators[tag & ~SPECTATOR_FLAG]);
+                } else {
+                    readReplies(tag);
+                }
+            }
+        }
+    }
+
+private:
+    const LoadSettings& settings;
+    GeneratorStats& stats;
+    Dice dice;
+    int epoll = -1;
+    vector<Client> clients;
+    vector<int> spectators;
+    priority_queue<pair<Clock::time_point, int>, vector<pair<Clock::time_point, int>>,
+                   greater<pair<Clock::time_point, int>>> timers;
+
+    void openClient() {
+        int fd = connectTo(settings.unixPath, settings.host, settings.port);
+        if (fd >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u32 = clients.size();
+        if (fd < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            failed = true;
+            return;
+        }
+        clients.push_back(Client());
+        clients.back().fd = fd;
+        clients.back().firstSpectator = spectators.size();
+        for (int s = 0; s < settings.spectators; s++) {
+            int watcher = connectTo(settings.unixPath, settings.host, settings.port);
+            if (watcher >= 0) {
+                fcntl(watcher, F_SETFL, fcntl(watcher, F_GETFL) | O_NONBLOCK);
+            }
+            event.data.u32 = spectators.size() | SPECTATOR_FLAG;
+            if (watcher < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, watcher, &event) != 0) {
+                close(watcher);
+                failed = true;
+                return;
+            }
+            spectators.push_back(watcher);
+        }
+        send(clients.back(), "new " + to_string(settings.players) + "\n", LOAD_NEW);
+    }
+
+    // Spectators only count what the server streams to them
+    void readFrames(int fd) {
+        char buffer[16384];
+        long long bytes = 0;
+        while (true) {
+            ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+            if (count > 0) {
+                bytes += count;
+            } else if (count < 0 && errno == EINTR) {
+                continue;
+            } else {
+                if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                    failed = true;
+                }
+                break;
+            }
+        }
+        lock_guard<mutex> guard(stats.lock);
+        stats.spectatorBytes += bytes;
+    }
+
+    void send(Client& client, const string& text, int type) {
+        client.outstanding = type;
+        client.sentAt = Clock::now();
+        // Commands are a few bytes, so a healthy socket always takes them whole
+        if (::send(client.fd, text.data(), text.size(), MSG_NOSIGNAL) != (ssize_t) text.size()) {
+            failed = true;
+        }
+    }
+
+    // Sends now, or after an exponentially distributed think time
+    void schedule(int index, const string& text, int type) {
+        Client& client = clients[index];
+        if (settings.thinkMs <= 0) {
+            send(client, text, type);
+            return;
+        }
+        double uniform = (dice.next() >> 11) * (1.0 / 9007199254740992.0);
+        double millis = -settings.thinkMs * log(1 - uniform);
+        client.next = text;
+        client.nextType = type;
+        timers.push(make_pair(Clock::now() + chrono::microseconds((long long) (millis * 1000)), index));
+    }
+
+    void complete(Client& client, bool error) {
+        long long nanos = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - client.sentAt).count();
+        lock_guard<mutex> guard(stats.lock);
+        if (error) {
+            stats.errors++;
+        } else if (client.outstanding >= 0) {
+            stats.latency[client.outstanding].record(nanos);
+        }
+        client.outstanding = -1;
+    }
+
+    void readReplies(int index) {
+        Client& client = clients[index];
+        char buffer[4096];
+        while (true) {
+            ssize_t count = recv(client.fd, buffer, sizeof(buffer), 0);
+            if (count > 0) {
+                client.input.append(buffer, count);
+            } else if (count < 0 && errno == EINTR) {
+                continue;
+            } else {
+                if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                    failed = true; // The server hung up
+                }
+                break;
+            }
+        }
+
+        size_t start = 0, end;
+        while ((end = client.input.find('\n', start)) != string::npos) {
+            string line = client.input.substr(start, end - start);
+            start = end + 1;
+            if (line.rfind("table ", 0) == 0) {
+                // Point this client's spectators at its new table
+                string watch = "watch " + line.substr(6) + "\n";
+                for (int s = 0; s < settings.spectators; s++) {
+                    if (::send(spectators[client.firstSpectator + s], watch.data(), watch.size(), MSG_NOSIGNAL) !=
+                        (ssize_t) watch.size()) {
+                        failed = true;
+                    }
+                }
+                string hand;
+                for (int seat = settings.players - settings.bots + 1; seat <= settings.players; seat++) {
+                    hand += "bot " + to_string(seat) + "\n";
+                }
+                if (!hand.empty() && ::send(client.fd, hand.data(), hand.size(), MSG_NOSIGNAL) != (ssize_t) hand.size()) {
+                    failed = true;
+                }
+            } else if (line.rfind("ask ", 0) == 0) {
+                complete(client, false);
+                if (stoi(line.substr(4)) > settings.players - settings.bots) {
+                    continue; // A bot's turn; its move arrives as the next ask
+                }
+                // "ask SEAT ROLL M,M,...": every other seat belongs to this client, so answer with any listed move
+                size_t list = line.rfind(' ') + 1;
+                vector<string> moves;
+                for (size_t at = list; at < line.size();) {
+                    size_t comma = min(line.find(',', at), line.size());
+                    moves.push_back(line.substr(at, comma - at));
+                    at = comma + 1;
+                }
+                schedule(index, "move " + moves[dice.next() % moves.size()] + "\n", LOAD_MOVE);
+            } else if (line.rfind("over ", 0) == 0) {
+                complete(client, false);
+                {
+                    lock_guard<mutex> guard(stats.lock);
+                    stats.games++;
+                }
+                schedule(index, "new " + to_string(settings.players) + "\n", LOAD_NEW);
+            } else if (line.rfind("error", 0) == 0) {
+                complete(client, true);
+                schedule(index, "new " + to_string(settings.players) + "\n", LOAD_NEW);
+            }
+        }
+        client.input.erase(0, start);
+    }
+};
+
+void printPercentiles(const LatencyHistogram& histogram) {
+    cout << "p50 " << histogram.percentile(50) / 1000.0 << " us, p99 " << histogram.percentile(99) / 1000.0
+         << " us, p99.9 " << histogram.percentile(99.9) / 1000.0 << " us";
+}
+
+}
+
+int runLoadGenerator(int argc, char** argv) {
+    LoadSettings settings;
+    int threadCount = max(1u, thread::hardware_concurrency());
+    int sessions = 100;
+    int rampStep = 0;
+    int maxSessions = 1000000;
+    int serverCores = max(1u, thread::hardware_concurrency());
+    double interval = 2, duration = 10, sloMs = 5;
+    uint64_t seed = 1;
+    for (int i = 2; i < argc; i += 2) {
+        string option = argv[i];
+        if (i + 1 >= argc) {
+            cout << "Usage: " << argv[0] << " loadgen [--port P] [--host ADDRESS] [--unix PATH] [--threads K]\n"
+                 << "       [--sessions N] [--players N] [--think-ms MS] [--interval SEC] [--duration SEC]\n"
+                 << "       [--ramp-step N] [--slo-ms MS] [--max-sessions N] [--server-cores C] [--seed S]\n"
+                 << "       [--spectators N] [--bots N]\n"
+                 << "--spectators opens N more connections per session that watch its table as it plays.\n"
+                 << "--bots hands the last N seats of every table to the server's bots.\n";
+            return 1;
+        }
+        string value = argv[i + 1];
+        if (option == "--port") {
+            settings.port = stoi(value);
+        } else if (option == "--host") {
+            settings.host = value;
+        } else if (option == "--unix") {
+            settings.unixPath = value;
+        } else if (option == "--threads") {
+            threadCount = stoi(value);
+        } else if (option == "--sessions") {
+            sessions = stoi(value);
+        } else if (option == "--players") {
+            settings.players = stoi(value);
+        } else if (option == "--think-ms") {
+            settings.thinkMs = stod(value);
+        } else if (option == "--interval") {
+            interval = stod(value);
+        } else if (option == "--duration") {
+            duration = stod(value);
+        } else if (option == "--ramp-step") {
+            rampStep = stoi(value);
+        } else if (option == "--slo-ms") {
+            sloMs = stod(value);
+        } else if (option == "--max-sessions") {
+            maxSessions = stoi(value);
+        } else if (option == "--server-cores") {
+            serverCores = stoi(value);
+        } else if (option == "--seed") {
+            seed = stoull(value);
+        } else if (option == "--spectators") {
+            settings.spectators = stoi(value);
+        } else if (option == "--bots") {
+            settings.bots = stoi(value);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (threadCount < 1 || sessions < 1 || settings.players < 2 || settings.players > 4 || interval <= 0 ||
+        rampStep < 0 || serverCores < 1 || settings.spectators < 0 ||
+        settings.bots < 0 || settings.bots >= settings.players) {
+        cout << "Threads and sessions must be at least 1, players 2-4, the interval positive.\n";
+        return 1;
+    }
+
+    rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    vector<unique_ptr<GeneratorStats>> stats;
+    vector<unique_ptr<Generator>> generators;
+    for (int t = 0; t < threadCount; t++) {
+        stats.push_back(unique_ptr<GeneratorStats>(new GeneratorStats()));
+        generators.push_back(unique_ptr<Generator>(new Generator(settings, *stats.back(), gameSeed(seed, t))));
+    }
+    auto setSessions = [&](int total) {
+        for (int t = 0; t < threadCount; t++) {
+            generators[t]->target = total / threadCount + (t < total % threadCount);
+        }
+    };
+    setSessions(sessions);
+
+    atomic<bool> stop(false);
+    vector<thread> threads;
+    for (auto& generator : generators) {
+        Generator* target = generator.get();
+        threads.push_back(thread([target, &stop]() { target->run(stop); }));
+    }
+
+    cout << fixed << setprecision(1);
+    LatencyHistogram total[LOAD_COMMAND_COUNT];
+    long long totalErrors = 0, totalGames = 0;
+    int sustainable = 0;
+    bool warmingUp = true; // The first interval after a change of load is not judged against the SLO
+    string verdict;
+    auto started = Clock::now();
+    auto lastReport = started;
+    while (true) {
+        this_thread::sleep_for(chrono::milliseconds(20));
+        bool failed = false;
+        for (auto& generator : generators) {
+            failed = failed || generator->failed;
+        }
+        auto now = Clock::now();
+        double elapsed = chrono::duration<double>(now - started).count();
+        double sinceReport = chrono::duration<double>(now - lastReport).count();
+        if (failed) {
+            verdict = "stopped: lost or could not open a connection to the server";
+            break;
+        }
+        if (sinceReport < interval) {
+            continue;
+        }
+
+        LatencyHistogram current[LOAD_COMMAND_COUNT];
+        long long errors = 0, games = 0, spectatorBytes = 0;
+        for (auto& threadStats : stats) {
+            lock_guard<mutex> guard(threadStats->lock);
+            for (int c = 0; c < LOAD_COMMAND_COUNT; c++) {
+                current[c].add(threadStats->latency[c]);
+                threadStats->latency[c].clear();
+            }
+            errors += threadStats->errors;
+            games += threadStats->games;
+            spectatorBytes += threadStats->spectatorBytes;
+            threadStats->errors = threadStats->games = threadStats->spectatorBytes = 0;
+        }
+        for (int c = 0; c < LOAD_COMMAND_COUNT; c++) {
+            total[c].add(current[c]);
+        }
+        totalErrors += errors;
+        totalGames += games;
+        lastReport = now;
+
+        cout << "sessions " << sessions << ": " << (long long) (current[LOAD_MOVE].count() / sinceReport)
+             << " moves/s, " << (long long) (games / sinceReport) << " games/s, move ";
+        printPercentiles(current[LOAD_MOVE]);
+        cout << ", new p99 " << current[LOAD_NEW].percentile(99) / 1000.0 << " us, errors " << errors;
+        if (settings.spectators > 0) {
+            cout << ", spectators read " << (long long) (spectatorBytes / sinceReport) << " bytes/s";
+        }
+        cout << (warmingUp ? " (warm-up)" : "") << "\n";
+
+        if (rampStep > 0) {
+            if (!warmingUp) {
+                if (current[LOAD_MOVE].percentile(99) > sloMs * 1e6) {
+                    verdict = "move p99 broke the SLO at " + to_string(sessions) + " sessions";
+                    break;
+                }
+                sustainable = sessions;
+                if (sessions + rampStep > maxSessions) {
+                    verdict = "reached --max-sessions without breaking the SLO";
+                    break;
+                }
+                sessions += rampStep;
+                setSessions(sessions);
+            }
+            warmingUp = !warmingUp;
+        } else {
+            warmingUp = false;
+            if (elapsed >= duration) {
+                break;
+            }
+        }
+    }
+
+    stop = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    double elapsed = chrono::duration<double>(Clock::now() - started).count();
+
+    cout << "\nTotals over " << elapsed << " s: " << totalGames << " games, " << totalErrors << " errors\n";
+    for (int c = 0; c < LOAD_COMMAND_COUNT; c++) {
+        const LatencyHistogram& histogram = total[c];
+        cout << "  " << LOAD_COMMAND_NAMES[c] << ": " << histogram.count() << " (" << (long long) (histogram.count() / elapsed)
+             << "/s), p50 " << histogram.percentile(50) / 1000.0 << " us, p90 " << histogram.percentile(90) / 1000.0
+             << " us, p99 " << histogram.percentile(99) / 1000.0 << " us, p99.9 " << histogram.percentile(99.9) / 1000.0
+             << " us, p99.99 " << histogram.percentile(99.99) / 1000.0 << " us, max " << histogram.max() / 1000.0
+             << " us\n";
+    }
+    if (!verdict.empty()) {
+        cout << verdict << "\n";
+    }
+    if (rampStep > 0) {
+        cout << "Sustainable: " << sustainable << " sessions with move p99 <= " << sloMs << " ms, "
+             << sustainable / (double) serverCores << " sessions per server core (" << serverCores << " cores)\n";
+    }
+    return verdict.rfind("stopped", 0) == 0 ? 1 : 0;
+}
+
+#else
+
+int runLoadGenerator(int argc, char** argv) {
+    cout << "loadgen needs epoll, which is only available on Linux.\n";
+    return 1;
+}
+
+#endif
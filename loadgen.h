@@ -0,0 +1,10 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+// "loadgen" command: simulated clients play full games against a running "serve" over loopback
+// TCP or a Unix socket, recording throughput and per-command latency histograms. With
+// --ramp-step it keeps adding sessions until the latency SLO breaks and reports how many
+// sessions per server core were sustainable.
+int runLoadGenerator(int argc, char** argv);
+
+#endif
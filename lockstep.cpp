@@ -0,0 +1,227 @@
+#include "lockstep.h"
+#include "bots.h"
+#include "net.h"
+#include "table.h"
+
+#include <sstream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+namespace {
+
+// Blocking line I/O on one socket, counting bytes both ways
+class LineConnection {
+public:
+    long long sent = 0;
+    long long received = 0;
+
+    explicit LineConnection(int fd) : fd(fd) {}
+    ~LineConnection() { close(fd); }
+
+    bool write(const string& line) {
+        for (size_t at = 0; at < line.size();) {
+            ssize_t count = ::send(fd, line.data() + at, line.size() - at, MSG_NOSIGNAL);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return false;
+            }
+            at += count;
+        }
+        sent += line.size();
+        return true;
+    }
+
+    bool read(string& line) {
+        size_t end;
+        while ((end = buffer.find('\n')) == string::npos) {
+            char chunk[4096];
+            ssize_t count = recv(fd, chunk, sizeof(chunk), 0);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return false;
+            }
+            buffer.append(chunk, count);
+            received += count;
+        }
+        line = buffer.substr(0, end);
+        buffer.erase(0, end + 1);
+        return true;
+    }
+
+private:
+    int fd;
+    string buffer;
+};
+
+string encodeMove(int move) {
+    return to_string(move == ENTER_TOKEN ? 0 : move + 1);
+}
+
+}
+
+int runLockstepClient(int argc, char** argv) {
+    string unixPath, host = "127.0.0.1";
+    int port = 7777;
+    int create = 0;
+    long long join = -1;
+    uint64_t seed = 0;
+    bool seeded = false;
+    string seats, botName = "random";
+    int hashEvery = 16;
+    long long desyncAt = -1;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        string value = argv[i + 1];
+        if (option == "--port") {
+            port = stoi(value);
+        } else if (option == "--host") {
+            host = value;
+        } else if (option == "--unix") {
+            unixPath = value;
+        } else if (option == "--create") {
+            create = stoi(value);
+        } else if (option == "--join") {
+            join = stoll(value);
+        } else if (option == "--seed") {
+            seed = stoull(value);
+            seeded = true;
+        } else if (option == "--seats") {
+            seats = value;
+        } else if (option == "--bot") {
+            botName = value;
+        } else if (option == "--hash-every") {
+            hashEvery = stoi(value);
+        } else if (option == "--desync-at") {
+            desyncAt = stoll(value);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if ((create == 0) == (join < 0) || (create != 0 && (create < 2 || create > 4)) || hashEvery < 1) {
+        cout << "Usage: " << argv[0] << " lockstep-client (--create PLAYERS [--seed S] | --join TABLE)\n"
+             << "       [--seats 1,2,...] [--bot SPEC] [--port P] [--host ADDRESS] [--unix PATH]\n"
+             << "       [--hash-every N] [--desync-at MOVES]\n"
+             << "--seats lists the seats this client plays (default: all when creating, none when joining).\n"
+             << "--desync-at corrupts the local copy after that many moves, to exercise desync detection.\n";
+        return 1;
+    }
+
+    BotSpec spec;
+    if (!spec.load(botName)) {
+        return 1;
+    }
+    int fd = connectTo(unixPath, host, port);
+    if (fd < 0) {
+        cout << "Could not connect to " << (unixPath.empty() ? host + ":" + to_string(port) : unixPath) << "\n";
+        return 1;
+    }
+    bool mine[4] = {create != 0, create != 0, create != 0, create != 0};
+    if (!seats.empty()) {
+        fill(begin(mine), end(mine), false);
+        stringstream list(seats);
+        string seat;
+        while (getline(list, seat, ',')) {
+            int index = stoi(seat) - 1;
+            if (index >= 0 && index < 4) {
+                mine[index] = true;
+            }
+        }
+    }
+    // The server takes a choice only from the member owning the seat: a joiner claims its seats,
+    // the first one as it joins
+    vector<int> claims;
+    for (int s = 0; s < 4 && join >= 0; s++) {
+        if (mine[s]) {
+            claims.push_back(s);
+        }
+    }
+    LineConnection server(fd);
+    server.write(create ? "lockstep " + to_string(create) + (seeded ? " " + to_string(seed) : "") + "\n"
+                        : "join " + to_string(join) + (claims.empty() ? "" : " " + to_string(claims[0] + 1)) + "\n");
+
+    string line, word;
+    long long id;
+    int numPlayers, turnLimit;
+    if (!server.read(line) || !(istringstream(line) >> word >> id >> numPlayers >> seed >> turnLimit) ||
+        word != "lockstep") {
+        cout << "Unexpected reply: " << line << "\n";
+        return 1;
+    }
+    cout << "lockstep table " << id << "\n" << flush; // Scripts read this to start the other participants
+    for (size_t c = 1; c < claims.size(); c++) {
+        server.write("join " + to_string(id) + " " + to_string(claims[c] + 1) + "\n");
+    }
+
+    unique_ptr<Policy> bot = spec.create(seed ^ (uint64_t) (id * 0x9E3779B97F4A7C15ULL));
+
+    Table table;
+    table.start(numPlayers, seed, turnLimit);
+    long long applied = 0;
+    bool asked = false;
+    while (table.state == Table::TABLE_WAITING) {
+        if (!asked && mine[table.seat]) {
+            int move = bot->chooseMove(table.players, table.seat, table.diceRoll, table.moves);
+            server.write("m " + encodeMove(move) + "\n");
+            asked = true;
+        }
+        if (!server.read(line)) {
+            cout << "Lost the connection after " << applied << " moves\n";
+            return 1;
+        }
+        istringstream reply(line);
+        reply >> word;
+        if (word == "m") {
+            int choice = -1;
+            reply >> choice;
+            if (!table.play(choice == 0 ? ENTER_TOKEN : choice - 1)) {
+                cout << "desync: relayed move " << choice << " is illegal on this copy after " << applied << " moves\n";
+                return 1;
+            }
+            applied++;
+            asked = false;
+            if (applied == desyncAt) {
+                Token& token = table.players[0].tokens[0];
+                if (token.inPlay) {
+                    token.position = (token.position + 1) % BOARD_SIZE;
+                } else {
+                    token.enterPlay(START_POSITIONS[0]);
+                }
+            }
+            if (applied % hashEvery == 0) {
+                server.write("h " + to_string(applied) + " " + to_string(table.hash()) + "\n");
+            }
+        } else if (word == "desync") {
+            cout << line << ": the copies disagree\n";
+            return 1;
+        } else if (word == "error") {
+            cout << line << "\n";
+            return 1;
+        }
+    }
+    server.write("h " + to_string(applied) + " " + to_string(table.hash()) + "\nquit\n");
+
+    cout << "over " << table.leader() + 1 << " " << table.turn << " after " << applied << " relayed moves, hash "
+         << table.hash() << "\nsent " << server.sent << " bytes, received " << server.received << " bytes ("
+         << (applied ? server.received / (double) applied : 0) << " received per move)\n";
+    return 0;
+}
+
+#else
+
+int runLockstepClient(int argc, char** argv) {
+    cout << "lockstep-client is only available on Linux.\n";
+    return 1;
+}
+
+#endif
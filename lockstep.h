@@ -0,0 +1,20 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+// Lockstep replication: every participant runs its own Table from the seed the server deals, so
+// dice rolls never cross the wire. The server puts the seats' choices in one order and relays them,
+// taking each only from the member that owns the seat to move (its own copy of the game tells it
+// whose turn it is), and compares the state hashes clients report. The creator owns every seat
+// until another member claims one.
+//   client: lockstep PLAYERS [SEED] or join TABLE [SEAT], then
+//           join TABLE SEAT  claims one more seat (answered with seat SEAT)
+//           m M            a choice for a seat this client owns (0 enters a token, 1-4 moves one)
+//           h MOVES HASH   Table::hash() after applying MOVES relayed moves
+//   server: lockstep ID PLAYERS SEED TURN_LIMIT   then, for a late joiner, every m line so far
+//           m M            the next choice; every copy applies them in this order
+//           desync MOVES   two members reported different hashes after MOVES moves
+
+// "lockstep-client" command: plays chosen seats of a lockstep table with a bot and reports bytes per move
+int runLockstepClient(int argc, char** argv);
+
+#endif
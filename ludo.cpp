@@ -0,0 +1,98 @@
+#include "ludo.h"
+
+#include <cstdlib>
+
+#include "eventlog.h"
+
+void displayBoard(const vector<Player>& players, ostream& out) {
+    char text[EVENT_TEXT_MAX];
+    out.write(text, renderEvent(boardEvent(players), LOG_TEXT, text));
+}
+
+int rollDice() {
+    METRIC_COUNT(METRIC_DICE_ROLLS);
+    return (rand() % 6) + 1;
+}
+
+int tokenProgress(const Token& token, int playerIndex) {
+    if (!token.inPlay) {
+        return -1;
+    }
+    if (token.hasWon()) {
+        return BOARD_SIZE;
+    }
+    return (token.position - START_POSITIONS[playerIndex] + BOARD_SIZE) % BOARD_SIZE;
+}
+
+int leadingPlayer(const vector<Player>& players) {
+    int leader = 0;
+    int bestTotal = -1;
+    for (int i = 0; i < players.size(); i++) {
+        int total = 0;
+        for (const auto& token : players[i].tokens) {
+            total += tokenProgress(token, i) + 1;
+        }
+        if (total > bestTotal) {
+            leader = i;
+            bestTotal = total;
+        }
+    }
+    return leader;
+}
+
+vector<int> legalMoves(const Player& player, int diceRoll) {
+    vector<int> moves;
+    legalMoves(player, diceRoll, moves);
+    return moves;
+}
+
+void legalMoves(const Player& player, int diceRoll, vector<int>& moves) {
+    METRIC_COUNT(METRIC_MOVE_GENERATIONS);
+    moves.clear();
+    bool canEnterNewToken = false;
+    for (const auto& token : player.tokens) {
+        if (!token.inPlay) {
+            canEnterNewToken = true;
+            break;
+        }
+    }
+
+    if (diceRoll == 6 && !player.hasTokensInPlay()) {
+        // No tokens are in play, so a token must be entered
+        if (canEnterNewToken) {
+            moves.push_back(ENTER_TOKEN);
+        }
+        return;
+    }
+
+    if (diceRoll != 6 && player.onlyOneTokenInPlay()) {
+        // The only token in play moves automatically
+        for (int i = 0; i < player.tokens.size(); i++) {
+            if (player.tokens[i].inPlay && !player.tokens[i].hasWon()) {
+                moves.push_back(i);
+                break;
+            }
+        }
+        return;
+    }
+
+    if (player.hasTokensInPlay()) {
+        // Tokens already home are done moving
+        for (int i = 0; i < player.tokens.size(); i++) {
+            if (player.tokens[i].inPlay && !player.tokens[i].hasWon()) {
+                moves.push_back(i);
+            }
+        }
+    }
+    if (diceRoll == 6 && canEnterNewToken) {
+        moves.push_back(ENTER_TOKEN);
+    }
+}
+
+void applyMove(Player& player, int move, int diceRoll, const Board& board) {
+    if (move == ENTER_TOKEN) {
+        player.enterTokenIntoPlay();
+    } else {
+        player.tokens[move].move(diceRoll, board.getPathForPlayer(player.playerIndex));
+    }
+}
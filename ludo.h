@@ -0,0 +1,177 @@
+#ifndef LUDO_H
+#define LUDO_H
+
+#include <iostream>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "metrics.h"
+
+using namespace std;
+
+const int HOME_POSITION = 100;
+const int BOARD_SIZE = 52;
+const vector<int> START_POSITIONS = {0, 13, 26, 39}; // Define starting positions for 4 players
+const int ENTER_TOKEN = -1; // Move value meaning "enter a new token into play"
+const int MAX_CHANCES = 3; // Maximum number of rolls per turn (a 6 grants another roll)
+
+class Board {
+public:
+    // Built once per seat and shared, so moving a token allocates nothing
+    static const vector<int>& getPathForPlayer(int playerIndex) {
+        static const vector<int> paths[4] = {buildPath(0), buildPath(1), buildPath(2), buildPath(3)};
+        return paths[playerIndex];
+    }
+
+private:
+    static vector<int> buildPath(int playerIndex) {
+        vector<int> path(BOARD_SIZE);
+        for (int i = 0; i < BOARD_SIZE; i++) {
+            path[i] = (START_POSITIONS[playerIndex] + i) % BOARD_SIZE; // Circular path starting from player's start position
+        }
+        return path;
+    }
+};
+
+class Token {
+public:
+    int position;
+    bool inPlay;
+
+    Token() {
+        position = -1; // -1 indicates the token is not yet in play
+        inPlay = false;
+    }
+
+    void move(int steps, const vector<int>& path) {
+        if (position == -1) {
+            return;
+        }
+
+        auto it = find(path.begin(), path.end(), position);
+        if (it == path.end()) {
+            cout << "Error: Current position not found in path." << endl;
+            return;
+        }
+
+        METRIC_COUNT(METRIC_MOVES_APPLIED);
+        int currentPositionIndex = distance(path.begin(), it);
+        int newPositionIndex = (currentPositionIndex + steps) % path.size();
+        position = path[newPositionIndex];
+    }
+
+    void enterPlay(int startPos) {
+        if (!inPlay) {
+            METRIC_COUNT(METRIC_MOVES_APPLIED);
+            position = startPos; // Enter the board at the player's start position
+            inPlay = true;
+        }
+    }
+
+    bool hasWon() const {
+        return position == HOME_POSITION;
+    }
+};
+
+class Player {
+public:
+    vector<Token> tokens;
+    int playerIndex;
+
+    Player(int index, int tokenCount = 4) : tokens(tokenCount), playerIndex(index) {}
+
+    // Takes every token off the board again for a new game, keeping the token storage
+    void reset(int index, int tokenCount = 4) {
+        playerIndex = index;
+        tokens.assign(tokenCount, Token());
+    }
+
+    bool allTokensInHome() const {
+        for (const auto& token : tokens) {
+            if (!token.hasWon()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool hasTokensInPlay() const {
+        for (const auto& token : tokens) {
+            if (token.inPlay && !token.hasWon()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool onlyOneTokenInPlay() const {
+        int inPlayCount = 0;
+        for (const auto& token : tokens) {
+            if (token.inPlay && !token.hasWon()) {
+                inPlayCount++;
+            }
+        }
+        return inPlayCount == 1;
+    }
+
+    void moveToken(int tokenIndex, int steps, const Board& board) {
+        if (tokenIndex >= 0 && tokenIndex < tokens.size() && tokens[tokenIndex].inPlay) {
+            tokens[tokenIndex].move(steps, board.getPathForPlayer(playerIndex));
+        } else {
+            cout << "Invalid token index or token is not in play.\n";
+        }
+    }
+
+    void enterTokenIntoPlay() {
+        for (auto& token : tokens) {
+            if (!token.inPlay) {
+                token.enterPlay(START_POSITIONS[playerIndex]);
+                break;
+            }
+        }
+    }
+};
+
+// Deterministic dice stream (splitmix64), so headless games can be replayed from a seed
+class Dice {
+public:
+    uint64_t state;
+
+    explicit Dice(uint64_t seed = 0) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    int roll() {
+        METRIC_COUNT(METRIC_DICE_ROLLS);
+        return (int) (next() % 6) + 1;
+    }
+};
+
+// The interactive game's board listing
+void displayBoard(const vector<Player>& players, ostream& out = cout);
+
+// The interactive game's dice, from rand(); headless play uses Dice
+int rollDice();
+
+// Steps a token has travelled from its player's start square, or -1 if not in play
+int tokenProgress(const Token& token, int playerIndex);
+
+// Seat furthest along the board by total token progress (ties go to the lower seat)
+int leadingPlayer(const vector<Player>& players);
+
+// Legal choices for a roll, following the same rules as playerTurn: token indices, or ENTER_TOKEN
+vector<int> legalMoves(const Player& player, int diceRoll);
+
+// The same into moves, which keeps its capacity: loops that run every roll call this one
+void legalMoves(const Player& player, int diceRoll, vector<int>& moves);
+
+// Applies one choice returned by legalMoves without printing anything
+void applyMove(Player& player, int move, int diceRoll, const Board& board);
+
+#endif
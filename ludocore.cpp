@@ -0,0 +1,170 @@
+#include "ludocore.h"
+#include "position.h"
+
+#include <algorithm>
+#include <cstring>
+
+static_assert(sizeof(ludo_state) == 20, "ludo_state layout is part of the ABI");
+static_assert(sizeof(ludo_moves) == 6, "ludo_moves layout is part of the ABI");
+static_assert(LUDO_HOME == POSITION_HOME && LUDO_TOKENS == POSITION_TOKENS && LUDO_ENTER == ENTER_TOKEN,
+              "ludocore.h constants follow the engine's");
+static_assert(LUDO_MAX_TEXT == MAX_POSITION_TEXT, "ludocore.h constants follow the engine's");
+
+namespace {
+
+bool validState(const ludo_state& state) {
+    if (state.num_players < 2 || state.num_players > LUDO_SEATS || state.seat >= state.num_players ||
+        state.chances >= MAX_CHANCES) {
+        return false;
+    }
+    for (int i = 0; i < state.num_players; i++) {
+        for (int t = 0; t < LUDO_TOKENS; t++) {
+            if (state.progress[i][t] < -1 || state.progress[i][t] > LUDO_HOME) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// legalMoves' rules worked on the progress values themselves, so the batch calls neither build a
+// Player nor reach Token::move, which reports rule errors on the console. Returns the move count.
+int seatMoves(const ludo_state& state, int roll, int8_t moves[LUDO_MAX_MOVES]) {
+    const int8_t* tokens = state.progress[state.seat];
+    int count = 0;
+    bool waiting = false;
+    for (int t = 0; t < LUDO_TOKENS; t++) {
+        if (tokens[t] >= 0 && tokens[t] != LUDO_HOME) { // Tokens home are done moving
+            moves[count++] = t;
+        }
+        waiting = waiting || tokens[t] < 0;
+    }
+    if (roll == 6 && waiting) {
+        moves[count++] = LUDO_ENTER;
+    }
+    return count;
+}
+
+// As applyMove: a new token enters at the start of the seat's route, a token on it moves round
+void playMove(ludo_state& state, int move, int roll) {
+    int8_t* tokens = state.progress[state.seat];
+    if (move == LUDO_ENTER) {
+        *find(tokens, tokens + LUDO_TOKENS, -1) = 0;
+    } else {
+        tokens[move] = (tokens[move] + roll) % BOARD_SIZE;
+    }
+}
+
+Position toPosition(const ludo_state& state) {
+    Position position;
+    position.numPlayers = state.num_players;
+    memcpy(position.progress, state.progress, sizeof(position.progress));
+    position.seat = state.seat;
+    position.chances = state.chances;
+    return position;
+}
+
+}
+
+uint32_t ludo_abi_version(void) {
+    return LUDO_ABI_VERSION;
+}
+
+int ludo_new_game(ludo_state* state, int num_players, int first_seat) {
+    if (num_players < 2 || num_players > LUDO_SEATS || first_seat < 0 || first_seat >= num_players) {
+        return LUDO_BAD_STATE;
+    }
+    memset(state, 0, sizeof(*state));
+    memset(state->progress, -1, sizeof(state->progress));
+    state->num_players = num_players;
+    state->seat = first_seat;
+    return LUDO_OK;
+}
+
+int ludo_parse_state(const char* text, ludo_state* state) {
+    Position position;
+    if (!text || !parsePosition(text, position) || position.chances >= MAX_CHANCES) {
+        return LUDO_BAD_STATE;
+    }
+    memset(state, 0, sizeof(*state));
+    memcpy(state->progress, position.progress, sizeof(state->progress));
+    state->num_players = position.numPlayers;
+    state->seat = position.seat;
+    state->chances = position.chances;
+    return LUDO_OK;
+}
+
+size_t ludo_format_state(const ludo_state* state, char* buffer, size_t size) {
+    if (!validState(*state)) {
+        return 0;
+    }
+    return serializePosition(toPosition(*state), buffer, size);
+}
+
+int ludo_winner(const ludo_state* state) {
+    for (int i = 0; i < state->num_players && i < LUDO_SEATS; i++) {
+        int home = 0;
+        for (int t = 0; t < LUDO_TOKENS; t++) {
+            home += state->progress[i][t] == LUDO_HOME;
+        }
+        if (home == LUDO_TOKENS) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void ludo_roll_dice(uint64_t* seed, uint8_t* rolls, size_t count) {
+    Dice dice(*seed);
+    for (size_t i = 0; i < count; i++) {
+        rolls[i] = dice.roll();
+    }
+    *seed = dice.state;
+}
+
+size_t ludo_generate_moves(const ludo_state* states, const uint8_t* rolls, ludo_moves* out, size_t count) {
+    size_t valid = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!validState(states[i]) || rolls[i] < 1 || rolls[i] > 6) {
+            out[i].count = -1;
+            continue;
+        }
+        out[i].count = seatMoves(states[i], rolls[i], out[i].moves);
+        valid++;
+    }
+    return valid;
+}
+
+size_t ludo_apply_moves(ludo_state* states, const uint8_t* rolls, const int8_t* moves, int32_t* results,
+                        size_t count) {
+    size_t applied = 0;
+    for (size_t i = 0; i < count; i++) {
+        ludo_state& state = states[i];
+        int result = LUDO_OK;
+        if (!validState(state) || rolls[i] < 1 || rolls[i] > 6) {
+            result = LUDO_BAD_STATE;
+        } else {
+            int8_t legal[LUDO_MAX_MOVES];
+            int legalCount = seatMoves(state, rolls[i], legal);
+            if (moves[i] == LUDO_PASS ? legalCount > 0 : find(legal, legal + legalCount, moves[i]) == legal + legalCount) {
+                result = LUDO_ILLEGAL_MOVE;
+            } else {
+                if (moves[i] != LUDO_PASS) {
+                    playMove(state, moves[i], rolls[i]);
+                }
+                // As Table::endRoll: a 6 rolls again until the turn's rolls are used up
+                if (rolls[i] == 6 && state.chances + 1 < MAX_CHANCES) {
+                    state.chances++;
+                } else {
+                    state.chances = 0;
+                    state.seat = (state.seat + 1) % state.num_players;
+                }
+                applied++;
+            }
+        }
+        if (results) {
+            results[i] = result;
+        }
+    }
+    return applied;
+}
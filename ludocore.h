@@ -0,0 +1,86 @@
+#ifndef LUDOCORE_H
+#define LUDOCORE_H
+
+/* C interface to the rules, for programs that embed them instead of running this one.
+ * Built into the ludo_core library (static and shared). Everything is plain C with fixed-width
+ * fields and caller-owned buffers; the batch calls take N entries per call, so a caller going
+ * through a foreign function interface crosses it once per batch rather than once per move.
+ * Nothing here allocates or keeps state between calls, and every call is thread-safe. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define LUDO_API __declspec(dllexport)
+#else
+#define LUDO_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped whenever a struct layout or a call's meaning changes */
+#define LUDO_ABI_VERSION 1
+
+#define LUDO_SEATS 4
+#define LUDO_TOKENS 4
+#define LUDO_HOME 52        /* Progress of a token at home */
+#define LUDO_MAX_MOVES 5    /* Every token plus entering a new one */
+#define LUDO_ENTER (-1)     /* Move: enter a new token into play */
+#define LUDO_PASS (-2)      /* Move: nothing to move for this roll */
+#define LUDO_MAX_TEXT 96    /* Longest ludo_format_state text, with its terminating null */
+
+/* Results of a single entry */
+#define LUDO_OK 0
+#define LUDO_ILLEGAL_MOVE 1 /* Not one of ludo_generate_moves' moves for that roll; the state is unchanged */
+#define LUDO_BAD_STATE 2    /* Out-of-range fields, or a roll outside 1-6 */
+
+/* A position between rolls: the same content as the text form in position.h */
+typedef struct ludo_state {
+    int8_t progress[LUDO_SEATS][LUDO_TOKENS]; /* -1 not in play, 0-51 along the seat's route, LUDO_HOME */
+    uint8_t num_players;                     /* 2-4; seats past it are ignored */
+    uint8_t seat;                            /* Seat to roll */
+    uint8_t chances;                         /* Rolls that seat already used this turn */
+    uint8_t reserved;                        /* Zero */
+} ludo_state;
+
+/* Legal moves for one roll: token indices 0-3 or LUDO_ENTER. count is 0 when the roll must be
+ * passed, -1 when the state or roll was invalid. */
+typedef struct ludo_moves {
+    int8_t count;
+    int8_t moves[LUDO_MAX_MOVES];
+} ludo_moves;
+
+LUDO_API uint32_t ludo_abi_version(void);
+
+/* Starting position with every token off the board; LUDO_BAD_STATE for a bad player count or seat */
+LUDO_API int ludo_new_game(ludo_state* state, int num_players, int first_seat);
+
+/* Text form, e.g. "0,5,-,-/h,51,-,-/-,-,-,- 2 1"; parse returns LUDO_OK or LUDO_BAD_STATE */
+LUDO_API int ludo_parse_state(const char* text, ludo_state* state);
+/* Returns the text length, or 0 if the state is invalid or size too small */
+LUDO_API size_t ludo_format_state(const ludo_state* state, char* buffer, size_t size);
+
+/* Seat with every token home, or -1 */
+LUDO_API int ludo_winner(const ludo_state* state);
+
+/* Fills rolls with count dice from the engine's own stream (splitmix64), advancing *seed */
+LUDO_API void ludo_roll_dice(uint64_t* seed, uint8_t* rolls, size_t count);
+
+/* Batch: for each i, the legal moves of states[i]'s seat for rolls[i].
+ * Returns how many entries were valid. */
+LUDO_API size_t ludo_generate_moves(const ludo_state* states, const uint8_t* rolls, ludo_moves* out, size_t count);
+
+/* Batch: plays moves[i] (or LUDO_PASS when there is none) for rolls[i] on states[i] in place,
+ * then passes the turn on as the game does: a 6 rolls again, up to three rolls a turn.
+ * results may be null; otherwise results[i] gets LUDO_OK or why entry i was left unchanged.
+ * Returns how many entries were applied. */
+LUDO_API size_t ludo_apply_moves(ludo_state* states, const uint8_t* rolls, const int8_t* moves, int32_t* results,
+                                 size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
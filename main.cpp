@@ -4,154 +4,79 @@
 #include <vector>
 #include <limits>
 #include <algorithm>
+#include <string>
+#include <memory>
+#include <functional>
+#include <sstream>
+
+#include "ludo.h"
+#include "selfplay.h"
+#include "query.h"
+#include "training.h"
+#include "replay.h"
+#include "tuner.h"
+#include "bots.h"
+#include "tournament.h"
+#include "perft.h"
+#include "position.h"
+#include "server.h"
+#include "actor.h"
+#include "loadgen.h"
+#include "lockstep.h"
+#include "sharedstate.h"
+#include "wal.h"
+#include "botscheduler.h"
+#include "ponder.h"
+#include "engine.h"
+#include "eventlog.h"
+#include "alloctrace.h"
+#include "timeline.h"
 
 using namespace std;
 
-const int HOME_POSITION = 100;
-const int BOARD_SIZE = 52;
-const vector<int> START_POSITIONS = {0, 13, 26, 39}; // Define starting positions for 4 players
-
-class Board {
-public:
-    static vector<int> getPathForPlayer(int playerIndex) {
-        vector<int> path(BOARD_SIZE);
-        for (int i = 0; i < BOARD_SIZE; i++) {
-            path[i] = (START_POSITIONS[playerIndex] + i) % BOARD_SIZE; // Circular path starting from player's start position
-        }
-        return path;
-    }
-};
-
-class Token {
-public:
-    int position;
-    bool inPlay;
-
-    Token() {
-        position = -1; // -1 indicates the token is not yet in play
-        inPlay = false;
-    }
-
-    void move(int steps, const vector<int>& path) {
-        if (position == -1) {
-            return;
-        }
-
-        auto it = find(path.begin(), path.end(), position);
-        if (it == path.end()) {
-            cout << "Error: Current position not found in path." << endl;
-            return;
-        }
-
-        int currentPositionIndex = distance(path.begin(), it);
-        int newPositionIndex = (currentPositionIndex + steps) % path.size();
-        position = path[newPositionIndex];
-    }
-
-    void enterPlay(int startPos) {
-        if (!inPlay) {
-            position = startPos; // Enter the board at the player's start position
-            inPlay = true;
-        }
-    }
-
-    bool hasWon() const {
-        return position == HOME_POSITION;
-    }
-};
-
-class Player {
-public:
-    vector<Token> tokens;
-    int playerIndex;
-
-    Player(int index, int tokenCount = 4) : playerIndex(index) {
-        for (int i = 0; i < tokenCount; i++) {
-            tokens.push_back(Token());
-        }
-    }
-
-    bool allTokensInHome() const {
-        for (const auto& token : tokens) {
-            if (!token.hasWon()) {
-                return false;
-            }
-        }
-        return true;
-    }
-
-    bool hasTokensInPlay() const {
-        for (const auto& token : tokens) {
-            if (token.inPlay && !token.hasWon()) {
-                return true;
-            }
-        }
-        return false;
-    }
-
-    bool onlyOneTokenInPlay() const {
-        int inPlayCount = 0;
-        for (const auto& token : tokens) {
-            if (token.inPlay) {
-                inPlayCount++;
-            }
-        }
-        return inPlayCount == 1;
-    }
-
-    void moveToken(int tokenIndex, int steps, const Board& board) {
-        if (tokenIndex >= 0 && tokenIndex < tokens.size() && tokens[tokenIndex].inPlay) {
-            tokens[tokenIndex].move(steps, board.getPathForPlayer(playerIndex));
-        } else {
-            cout << "Invalid token index or token is not in play.\n";
+// Reads whole lines until one holds just a number from low to high that valid accepts, so stray
+// words or characters cannot leave cin stuck in a failed state. Ends the game when input runs out.
+int readChoice(int low, int high, function<bool(int)> valid = nullptr) {
+    string line;
+    flushEvents();
+    while (getline(cin, line)) {
+        istringstream in(line);
+        int value;
+        char extra;
+        if (in >> value && !(in >> extra) && value >= low && value <= high && (!valid || valid(value))) {
+            return value;
         }
+        LOG_PROMPT(GAME_INVALID);
+        flushEvents();
     }
-
-    void enterTokenIntoPlay() {
-        for (auto& token : tokens) {
-            if (!token.inPlay) {
-                token.enterPlay(START_POSITIONS[playerIndex]);
-                break;
-            }
-        }
-    }
-};
-
-void displayBoard(const vector<Player>& players) {
-    cout << "\nCurrent Board:\n";
-    for (int i = 0; i < players.size(); i++) {
-        cout << "Player " << i + 1 << " tokens: ";
-        for (const auto& token : players[i].tokens) {
-            if (token.hasWon()) {
-                cout << "H "; // Token has won and is at the home position
-            } else if (token.inPlay) {
-                cout << token.position << " ";
-            } else {
-                cout << "NP "; // NP for Not in Play
-            }
-        }
-        cout << endl;
-    }
+    LOG_PROMPT(GAME_INPUT_CLOSED);
+    exit(0); // The log is drained at exit
 }
 
-int rollDice() {
-    return (rand() % 6) + 1;
+// Asks for a token in play, and not yet home, to move by steps; returns its index
+int readToken(const Player& player, int steps) {
+    LOG_PROMPT(GAME_ASK_TOKEN, player.playerIndex, steps, player.tokens.size());
+    return readChoice(1, player.tokens.size(), [&](int token) {
+        const Token& chosen = player.tokens[token - 1];
+        return chosen.inPlay && !chosen.hasWon();
+    }) - 1;
 }
 
 int chooseToStart(int numPlayers) {
     int currentPlayer = 0;
     int highestRoll = 0;
     int startingPlayer = -1;
-    vector<int> rolls(numPlayers, 0);
+    int rolls[4] = {0, 0, 0, 0};
 
     while (true) {
-        cout << "Player " << currentPlayer + 1 << "'s turn. Press Enter to roll the dice.";
-        cin.ignore(numeric_limits<streamsize>::max(), '\n');
-        cin.get();
+        LOG_PROMPT(GAME_ASK_START_ROLL, currentPlayer);
+        flushEvents();
+        string line;
+        getline(cin, line);
 
         int diceRoll = rollDice();
         rolls[currentPlayer] = diceRoll;
-        cout << "Player " << currentPlayer + 1 << " rolled a " << diceRoll << "\n";
+        LOG_PROMPT(GAME_START_ROLL, currentPlayer, diceRoll);
 
         if (diceRoll == 6) {
             startingPlayer = currentPlayer;
@@ -182,18 +107,53 @@ int chooseToStart(int numPlayers) {
     return startingPlayer;
 }
 
-void playerTurn(Player& player, const Board& board) {
-    int maxChances = 3; // Maximum number of chances per turn
-    int chances = 0; // Counter for the number of chances used
+// Lets a bot make the choice for one roll; returns false when there was nothing to move
+bool botMove(vector<Player>& players, int playerIndex, const Board& board, Policy& bot, int diceRoll) {
+    Player& player = players[playerIndex];
+    vector<int> moves = legalMoves(player, diceRoll);
+    if (moves.empty()) {
+        return false;
+    }
+    int move = moves.size() == 1 ? moves[0] : bot.chooseMove(players, playerIndex, diceRoll, moves);
+    if (move == ENTER_TOKEN) {
+        LOG_TURN(GAME_BOT_ENTER, playerIndex);
+    } else {
+        LOG_TURN(GAME_BOT_MOVE, playerIndex, diceRoll, move);
+    }
+    applyMove(player, move, diceRoll, board);
+    return true;
+}
+
+// chances is the number of rolls already used this turn (non-zero only when resuming a loaded position);
+// next is the bot at the following seat, if any, which may ponder while a human chooses
+void playerTurn(vector<Player>& players, int playerIndex, const Board& board, Policy* bot, int chances = 0,
+                Policy* next = nullptr) {
+    Player& player = players[playerIndex];
+    int maxChances = MAX_CHANCES; // Maximum number of chances per turn
 
     while (chances < maxChances) {
         int diceRoll = rollDice();
-        cout << "You rolled a " << diceRoll << endl;
+        if (bot) {
+            LOG_TURN(GAME_ROLL, playerIndex, diceRoll);
+        } else {
+            LOG_PROMPT(GAME_ROLL, playerIndex, diceRoll);
+        }
+        if (!bot && next) {
+            next->ponder(players, playerIndex, diceRoll, legalMoves(player, diceRoll), (playerIndex + 1) % players.size());
+        }
 
-        if (diceRoll == 6) {
+        if (bot) {
+            if (!botMove(players, playerIndex, board, *bot, diceRoll) && diceRoll != 6) {
+                LOG_TURN(GAME_SKIP, playerIndex);
+            }
+            if (diceRoll != 6) {
+                break;
+            }
+            chances++;
+        } else if (diceRoll == 6) {
             if (!player.hasTokensInPlay()) {
                 // If no tokens are in play, enter a new token into play
-                cout << "You rolled a 6. No tokens are in play, so you must enter a token into play.\n";
+                LOG_PROMPT(GAME_MUST_ENTER, playerIndex);
                 player.enterTokenIntoPlay();
             } else {
                 // Check if there are tokens not in play
@@ -207,105 +167,215 @@ void playerTurn(Player& player, const Board& board) {
 
                 // If there are tokens not in play, give the player a choice
                 if (canEnterNewToken) {
-                    int choice = 0;
-                    while (choice != 1 && choice != 2) {
-                        cout << "You rolled a 6. Choose an option:\n";
-                        cout << "1. Move a token 6 spaces.\n";
-                        cout << "2. Enter a new token into play.\n";
-                        cin >> choice;
-                        if (choice != 1 && choice != 2) {
-                            cout << "Invalid choice. Try again.\n";
-                        }
-                    }
-                    if (choice == 1) {
+                    LOG_PROMPT(GAME_ASK_SIX, playerIndex);
+                    if (readChoice(1, 2) == 1) {
                         // Prompt the user to choose a token to move 6 spaces
-                        cout << "Choose a token to move 6 spaces (1-" << player.tokens.size() << "):\n";
-                        int tokenIndex;
-                        cin >> tokenIndex;
-                        while (tokenIndex < 1 || tokenIndex > player.tokens.size() || !player.tokens[tokenIndex - 1].inPlay) {
-                            cout << "Invalid choice. Try again:\n";
-                            cin >> tokenIndex;
-                        }
-                        player.moveToken(tokenIndex - 1, 6, board);
+                        player.moveToken(readToken(player, 6), 6, board);
                     } else {
                         // Enter a new token into play
                         player.enterTokenIntoPlay();
                     }
                 } else {
                     // No tokens are out of play, so move a token 6 spaces
-                    cout << "You rolled a 6. No tokens are out of play, so you must move a token 6 spaces.\n";
-                    cout << "Choose a token to move 6 spaces (1-" << player.tokens.size() << "):\n";
-                    int tokenIndex;
-                    cin >> tokenIndex;
-                    while (tokenIndex < 1 || tokenIndex > player.tokens.size() || !player.tokens[tokenIndex - 1].inPlay) {
-                        cout << "Invalid choice. Try again:\n";
-                        cin >> tokenIndex;
-                    }
-                    player.moveToken(tokenIndex - 1, 6, board);
+                    LOG_PROMPT(GAME_MUST_MOVE, playerIndex);
+                    player.moveToken(readToken(player, 6), 6, board);
                 }
             }
             chances++;
         } else {
             if (player.onlyOneTokenInPlay()) {
                 for (int i = 0; i < player.tokens.size(); i++) {
-                    if (player.tokens[i].inPlay) {
+                    if (player.tokens[i].inPlay && !player.tokens[i].hasWon()) {
                         player.moveToken(i, diceRoll, board);
                         break;
                     }
                 }
             } else if (player.hasTokensInPlay()) {
-                cout << "Choose a token to move " << diceRoll << " spaces (1-" << player.tokens.size() << "):\n";
-                int tokenIndex;
-                cin >> tokenIndex;
-                while (tokenIndex < 1 || tokenIndex > player.tokens.size() || !player.tokens[tokenIndex - 1].inPlay) {
-                    cout << "Invalid choice. Try again:\n";
-                    cin >> tokenIndex;
-                }
-                player.moveToken(tokenIndex - 1, diceRoll, board);
+                player.moveToken(readToken(player, diceRoll), diceRoll, board);
             } else {
-                cout << "No tokens in play and you did not roll a 6. Turn skipped.\n";
+                LOG_PROMPT(GAME_SKIP, playerIndex);
             }
             break;
         }
     }
 }
 
-int main() {
-    srand(time(0));
-    int numPlayers;
+int main(int argc, char** argv) {
+    int firstOption = 1;
+    if (argc > 1 && string(argv[1]) == "play") {
+        firstOption = 2;
+    } else if (argc > 1 && string(argv[1]).rfind("--", 0) != 0) {
+        string command = argv[1];
+        if (command == "selfplay") {
+            return runSelfPlay(argc, argv);
+        } else if (command == "index") {
+            return runIndexer(argc, argv);
+        } else if (command == "query") {
+            return runQuery(argc, argv);
+        } else if (command == "export") {
+            return runTrainingExport(argc, argv);
+        } else if (command == "nn-init") {
+            return runNetworkInit(argc, argv);
+        } else if (command == "nn-bench") {
+            return runNetworkBench(argc, argv);
+        } else if (command == "selfplay-loop") {
+            return runSelfPlayLoop(argc, argv);
+        } else if (command == "tune") {
+            return runTuner(argc, argv);
+        } else if (command == "tournament") {
+            return runTournament(argc, argv);
+        } else if (command == "perft") {
+            return runPerft(argc, argv);
+        } else if (command == "serve") {
+            return runServe(argc, argv);
+        } else if (command == "actor-bench") {
+            return runActorBench(argc, argv);
+        } else if (command == "loadgen") {
+            return runLoadGenerator(argc, argv);
+        } else if (command == "lockstep-client") {
+            return runLockstepClient(argc, argv);
+        } else if (command == "state-bench") {
+            return runStateBench(argc, argv);
+        } else if (command == "state-watch") {
+            return runStateWatch(argc, argv);
+        } else if (command == "wal-bench") {
+            return runWalBench(argc, argv);
+        } else if (command == "bot-bench") {
+            return runBotBench(argc, argv);
+        } else if (command == "ponder-bench") {
+            return runPonderBench(argc, argv);
+        } else if (command == "engine") {
+            return runEngine(argc, argv);
+        } else if (command == "engine-bench") {
+            return runEngineBench(argc, argv);
+        } else if (command == "alloc-check") {
+            return runAllocCheck(argc, argv);
+        } else if (command == "timeline-bench") {
+            return runTimelineBench(argc, argv);
+        }
+        cout << "Unknown command " << command << ". Commands: play, selfplay, index, query, export, nn-init, nn-bench,\n"
+             << "selfplay-loop, tune, tournament, perft, serve, actor-bench, loadgen,\n"
+             << "lockstep-client, state-bench, state-watch, wal-bench, bot-bench,\n"
+             << "ponder-bench, engine, engine-bench, alloc-check,\n"
+             << "timeline-bench\n";
+        return 1;
+    }
 
-    while (true) {
-        cout << "Enter the number of players (2-4): ";
-        cin >> numPlayers;
-        if (numPlayers >= 2 && numPlayers <= 4) {
-            break;
+    // Bot seats: --bot SEAT=random, SEAT=heuristic[:WEIGHTS], SEAT=search[:ROLLOUTS], SEAT=engine:COMMAND
+    // or SEAT=<network weights file>
+    BotSpec specs[4];
+    vector<unique_ptr<Policy>> bots(4);
+    Position start;
+    bool loadPosition = false;
+    StatePublisher publisher;
+    LogFormat logFormat = LOG_TEXT;
+    int logLevel = LUDO_LOG_LEVEL;
+    for (int i = firstOption; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--position" && i + 1 < argc) {
+            loadPosition = parsePosition(argv[++i], start);
+            if (!loadPosition) {
+                cout << "Invalid position: " << argv[i] << "\n";
+                return 1;
+            }
+            continue;
+        }
+        if (option == "--publish" && i + 1 < argc) {
+            // Frontends read the board from shared memory (see state-watch) instead of parsing it
+            if (!publisher.open(argv[++i], 1)) {
+                cout << "Could not create shared memory " << argv[i] << "\n";
+                return 1;
+            }
+            continue;
+        }
+        if (option == "--log-format" && i + 1 < argc) {
+            string format = argv[++i];
+            if (format != "text" && format != "compact") {
+                cout << "Log formats are text and compact.\n";
+                return 1;
+            }
+            logFormat = format == "compact" ? LOG_COMPACT : LOG_TEXT;
+            continue;
+        }
+        if (option == "--log-level" && i + 1 < argc) {
+            // Only lowers what was built in: 0 prompts, 1 results, 2 turns, 3 boards
+            logLevel = min(stoi(argv[++i]), LUDO_LOG_LEVEL);
+            continue;
+        }
+        size_t split = i + 1 < argc ? string(argv[i + 1]).find('=') : string::npos;
+        if (option != "--bot" || split == string::npos) {
+            cout << "Usage: " << argv[0] << " [play] [--position TEXT] [--publish NAME] [--log-format text|compact]\n"
+                 << "       [--log-level 0-" << LUDO_LOG_LEVEL << "]\n"
+                 << "       [--bot SEAT=random|heuristic[:WEIGHTS]|search[:ROLLOUTS]|engine:COMMAND|NETWORK]...\n";
+            return 1;
+        }
+        string value = argv[++i];
+        int seat = stoi(value.substr(0, split)) - 1;
+        if (seat < 0 || seat >= 4) {
+            cout << "Bot seats are 1-4.\n";
+            return 1;
+        }
+        if (!specs[seat].load(value.substr(split + 1))) {
+            return 1;
         }
-        cout << "Invalid number of players. Please enter a number between 2 and 4.\n";
+        bots[seat] = specs[seat].create(time(0) + seat);
     }
 
+    srand(time(0));
+    startEventLog(logFormat, logLevel);
+    int numPlayers;
     vector<Player> players;
     Board board;
-    for (int i = 0; i < numPlayers; i++) {
-        players.push_back(Player(i));
-    }
+    int currentPlayerIndex;
+    int chances = 0;
+
+    if (loadPosition) {
+        numPlayers = start.numPlayers;
+        playersFromPosition(start, players);
+        currentPlayerIndex = start.seat;
+        chances = start.chances;
+        LOG_BOARD(players);
+    } else {
+        LOG_PROMPT(GAME_ASK_PLAYERS);
+        numPlayers = readChoice(2, 4);
+
+        players.reserve(numPlayers);
+        for (int i = 0; i < numPlayers; i++) {
+            players.push_back(Player(i));
+        }
 
-    int currentPlayerIndex = chooseToStart(numPlayers);
-    cout << "Player " << currentPlayerIndex + 1 << " starts the game!\n";
+        currentPlayerIndex = chooseToStart(numPlayers);
+        LOG_RESULT(GAME_STARTS, currentPlayerIndex);
+    }
 
     bool gameOver = false;
+    int turn = 0;
+    if (publisher.slots()) {
+        publisher.publish(0, snapshotPlayers(0, players, currentPlayerIndex, turn));
+    }
 
     while (!gameOver) {
         Player& currentPlayer = players[currentPlayerIndex];
-        cout << "\nPlayer " << currentPlayerIndex + 1 << "'s turn.\n";
-        playerTurn(currentPlayer, board);
-        displayBoard(players);
+        if (bots[currentPlayerIndex]) {
+            LOG_TURN(GAME_TURN, currentPlayerIndex);
+        } else {
+            LOG_PROMPT(GAME_TURN, currentPlayerIndex);
+        }
+        playerTurn(players, currentPlayerIndex, board, bots[currentPlayerIndex].get(), chances,
+                   bots[(currentPlayerIndex + 1) % numPlayers].get());
+        chances = 0;
+        LOG_BOARD(players);
+        turn++;
 
         if (currentPlayer.allTokensInHome()) {
-            cout << "Player " << currentPlayerIndex + 1 << " wins!\n";
+            LOG_RESULT(GAME_WIN, currentPlayerIndex);
             gameOver = true;
         } else {
             currentPlayerIndex = (currentPlayerIndex + 1) % numPlayers;
         }
+        if (publisher.slots()) {
+            publisher.publish(0, snapshotPlayers(0, players, currentPlayerIndex, turn));
+        }
     }
 
     return 0;
@@ -0,0 +1,127 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <sstream>
+
+thread_local ThreadMetrics* currentMetrics = nullptr;
+
+namespace {
+
+atomic<ThreadMetrics*> allMetrics{nullptr};
+atomic<int> blockCount{0};
+
+// Hands the block back when its thread exits
+struct MetricsRelease {
+    ~MetricsRelease() {
+        if (currentMetrics) {
+            currentMetrics->inUse.store(false, memory_order_release);
+            currentMetrics = nullptr;
+        }
+    }
+};
+
+struct CounterInfo {
+    const char* name;
+    const char* help;
+};
+
+const CounterInfo COUNTER_INFO[METRIC_COUNTER_COUNT] = {
+    {"ludo_dice_rolls_total", "Dice rolled"},
+    {"ludo_move_generations_total", "Legal move lists generated"},
+    {"ludo_moves_applied_total", "Tokens moved or entered into play"},
+};
+
+const CounterInfo HISTOGRAM_INFO[METRIC_HISTOGRAM_COUNT] = {
+    {"ludo_command_seconds", "Time to handle one command on a served table"},
+    {"ludo_io_wait_seconds", "Time blocked on log syncs and engine replies"},
+    {"ludo_bot_search_seconds", "Time from a bot search's first slice to its answer"},
+};
+
+}
+
+ThreadMetrics::ThreadMetrics() {
+    for (auto& counter : counters) {
+        counter.store(0, memory_order_relaxed);
+    }
+    for (auto& histogram : buckets) {
+        for (auto& bucket : histogram) {
+            bucket.store(0, memory_order_relaxed);
+        }
+    }
+    for (auto& sum : sums) {
+        sum.store(0, memory_order_relaxed);
+    }
+}
+
+void ThreadMetrics::record(int histogram, uint64_t nanos) {
+    int width = nanos ? 64 - __builtin_clzll(nanos) : 0; // Bits needed for nanos
+    int bucket = min(METRIC_BUCKETS - 1, max(0, width - METRIC_FIRST_BIT));
+    auto& count = buckets[histogram][bucket];
+    count.store(count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    sums[histogram].store(sums[histogram].load(memory_order_relaxed) + nanos, memory_order_relaxed);
+}
+
+ThreadMetrics& attachMetrics() {
+    thread_local MetricsRelease release;
+    for (ThreadMetrics* block = allMetrics.load(memory_order_acquire); block; block = block->next) {
+        bool idle = false;
+        if (block->inUse.compare_exchange_strong(idle, true, memory_order_acquire)) {
+            return *(currentMetrics = block);
+        }
+    }
+    ThreadMetrics* block = new ThreadMetrics();
+    block->inUse.store(true, memory_order_relaxed);
+    block->next = allMetrics.load(memory_order_relaxed);
+    while (!allMetrics.compare_exchange_weak(block->next, block, memory_order_release)) {
+    }
+    blockCount.fetch_add(1, memory_order_relaxed);
+    return *(currentMetrics = block);
+}
+
+void snapshotMetrics(MetricsSnapshot& snapshot) {
+    snapshot = MetricsSnapshot();
+    for (ThreadMetrics* block = allMetrics.load(memory_order_acquire); block; block = block->next) {
+        for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+            snapshot.counters[c] += block->counters[c].load(memory_order_relaxed);
+        }
+        for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+            for (int b = 0; b < METRIC_BUCKETS; b++) {
+                snapshot.buckets[h][b] += block->buckets[h][b].load(memory_order_relaxed);
+            }
+            snapshot.sums[h] += block->sums[h].load(memory_order_relaxed);
+        }
+    }
+    snapshot.threads = blockCount.load(memory_order_relaxed);
+}
+
+string prometheusText(const MetricsSnapshot& snapshot) {
+    ostringstream out;
+    for (int c = 0; c < METRIC_TURNS_1_ROLL; c++) {
+        out << "# HELP " << COUNTER_INFO[c].name << " " << COUNTER_INFO[c].help << "\n# TYPE " << COUNTER_INFO[c].name
+            << " counter\n" << COUNTER_INFO[c].name << " " << snapshot.counters[c] << "\n";
+    }
+    out << "# HELP ludo_turns_total Turns by the number of rolls taken, a 6 granting another\n"
+        << "# TYPE ludo_turns_total counter\n";
+    for (int c = METRIC_TURNS_1_ROLL; c <= METRIC_TURNS_3_ROLLS; c++) {
+        out << "ludo_turns_total{rolls=\"" << c - METRIC_TURNS_1_ROLL + 1 << "\"} " << snapshot.counters[c] << "\n";
+    }
+    for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+        const char* name = HISTOGRAM_INFO[h].name;
+        out << "# HELP " << name << " " << HISTOGRAM_INFO[h].help << "\n# TYPE " << name << " histogram\n";
+        uint64_t cumulative = 0;
+        for (int b = 0; b < METRIC_BUCKETS; b++) {
+            cumulative += snapshot.buckets[h][b];
+            out << name << "_bucket{le=\"";
+            if (b == METRIC_BUCKETS - 1) {
+                out << "+Inf";
+            } else {
+                out << (double) (1ULL << (b + METRIC_FIRST_BIT)) / 1e9;
+            }
+            out << "\"} " << cumulative << "\n";
+        }
+        out << name << "_sum " << snapshot.sums[h] / 1e9 << "\n" << name << "_count " << cumulative << "\n";
+    }
+    out << "# HELP ludo_metrics_threads Per-thread metric blocks allocated\n# TYPE ludo_metrics_threads gauge\n"
+        << "ludo_metrics_threads " << snapshot.threads << "\n";
+    return out.str();
+}
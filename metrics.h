@@ -0,0 +1,103 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+// Counters and latency histograms for the hot paths, built in only with -DLUDO_METRICS=ON.
+// Every thread writes its own cache-line-aligned block with plain relaxed stores (no locked
+// instructions, no sharing), and a snapshot adds the blocks up while they are being written.
+// Blocks are never freed: a thread that exits hands its block, counts and all, to the next one.
+// Compiled out, the METRIC_ macros expand to nothing.
+
+enum MetricCounter {
+    METRIC_DICE_ROLLS = 0,
+    METRIC_MOVE_GENERATIONS, // legalMoves calls
+    METRIC_MOVES_APPLIED,    // Tokens moved or entered
+    METRIC_TURNS_1_ROLL,     // Turns by how many rolls they took: a 6 grants another, up to MAX_CHANCES
+    METRIC_TURNS_2_ROLLS,
+    METRIC_TURNS_3_ROLLS,
+    METRIC_COUNTER_COUNT
+};
+
+// Counter for a turn that used rolls rolls (1 to MAX_CHANCES)
+#define METRIC_TURN(rolls) METRIC_COUNT(METRIC_TURNS_1_ROLL + min(rolls, 3) - 1)
+
+enum MetricHistogram {
+    METRIC_COMMAND = 0, // Handling one command on a served table
+    METRIC_IO_WAIT,     // Blocked on the disk or a pipe: log syncs, engine replies
+    METRIC_BOT_SEARCH,  // One bot choice on the scheduler pool, from first slice to answer
+    METRIC_HISTOGRAM_COUNT
+};
+
+const int METRIC_BUCKETS = 32;  // Bucket b holds durations under 2^(b + METRIC_FIRST_BIT) ns
+const int METRIC_FIRST_BIT = 7; // 128 ns; the last bucket is unbounded
+
+struct alignas(64) ThreadMetrics {
+    atomic<uint64_t> counters[METRIC_COUNTER_COUNT];
+    atomic<uint64_t> buckets[METRIC_HISTOGRAM_COUNT][METRIC_BUCKETS];
+    atomic<uint64_t> sums[METRIC_HISTOGRAM_COUNT]; // Nanoseconds
+    atomic<bool> inUse{false};
+    ThreadMetrics* next = nullptr;
+
+    ThreadMetrics();
+
+    // Single writer, so a load and a store instead of a locked add
+    void add(int counter, uint64_t amount) {
+        counters[counter].store(counters[counter].load(memory_order_relaxed) + amount, memory_order_relaxed);
+    }
+
+    void record(int histogram, uint64_t nanos);
+};
+
+struct MetricsSnapshot {
+    uint64_t counters[METRIC_COUNTER_COUNT] = {};
+    uint64_t buckets[METRIC_HISTOGRAM_COUNT][METRIC_BUCKETS] = {};
+    uint64_t sums[METRIC_HISTOGRAM_COUNT] = {};
+    int threads = 0; // Blocks ever handed out
+};
+
+extern thread_local ThreadMetrics* currentMetrics;
+ThreadMetrics& attachMetrics();
+
+inline ThreadMetrics& threadMetrics() {
+    return currentMetrics ? *currentMetrics : attachMetrics();
+}
+
+// Totals over every thread so far; safe to call from any thread at any time
+void snapshotMetrics(MetricsSnapshot& snapshot);
+
+// Prometheus text exposition format
+string prometheusText(const MetricsSnapshot& snapshot);
+
+// Times a scope into a histogram
+class MetricTimer {
+public:
+    explicit MetricTimer(int histogram) : histogram(histogram), started(chrono::steady_clock::now()) {}
+    ~MetricTimer() {
+        auto nanos = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started).count();
+        threadMetrics().record(histogram, nanos);
+    }
+
+private:
+    int histogram;
+    chrono::steady_clock::time_point started;
+};
+
+#ifdef LUDO_METRICS
+#define METRIC_COUNT(counter) threadMetrics().add(counter, 1)
+#define METRIC_RECORD(histogram, nanos) threadMetrics().record(histogram, nanos)
+#define METRIC_TIME_JOIN(name, line) name##line
+#define METRIC_TIME_NAME(line) METRIC_TIME_JOIN(metricTimer, line)
+#define METRIC_TIME(histogram) MetricTimer METRIC_TIME_NAME(__LINE__)(histogram)
+#else
+#define METRIC_COUNT(counter) ((void) 0)
+#define METRIC_RECORD(histogram, nanos) ((void) 0)
+#define METRIC_TIME(histogram) ((void) 0)
+#endif
+
+#endif
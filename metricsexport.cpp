@@ -0,0 +1,121 @@
+#include "metricsexport.h"
+#include "net.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+bool MetricsExporter::start(const string& path, int port, int periodMs) {
+    this->path = path;
+    this->periodMs = max(1, periodMs);
+    if (port > 0) {
+        listener = openListener("", "127.0.0.1", port);
+        if (listener < 0) {
+            cout << "Could not listen for metrics on 127.0.0.1:" << port << "\n";
+            return false;
+        }
+    }
+    if (path.empty() && listener < 0) {
+        return true;
+    }
+    stopping = false;
+    worker = thread([this]() { run(); });
+    return true;
+}
+
+void MetricsExporter::stop() {
+    if (worker.joinable()) {
+        stopping = true;
+        worker.join();
+        if (!path.empty()) {
+            writeFile(); // Final totals
+        }
+    }
+#ifdef __linux__
+    if (listener >= 0) {
+        close(listener);
+        listener = -1;
+    }
+#endif
+}
+
+void MetricsExporter::writeFile() {
+    string partial = path + ".partial";
+    {
+        MetricsSnapshot snapshot;
+        snapshotMetrics(snapshot);
+        ofstream out(partial);
+        out << prometheusText(snapshot);
+    }
+    rename(partial.c_str(), path.c_str());
+}
+
+#ifdef __linux__
+
+void MetricsExporter::run() {
+    auto nextWrite = chrono::steady_clock::now();
+    while (!stopping) {
+        auto now = chrono::steady_clock::now();
+        if (!path.empty() && now >= nextWrite) {
+            writeFile();
+            nextWrite = now + chrono::milliseconds(periodMs);
+        }
+        // Wakes at least every 100 ms to notice stop()
+        pollfd ready = {listener, POLLIN, 0};
+        int waitMs = min<long long>(100, max<long long>(1, chrono::duration_cast<chrono::milliseconds>(nextWrite - now).count()));
+        if (poll(&ready, listener >= 0 ? 1 : 0, waitMs) > 0) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0) {
+                answer(fd);
+                close(fd);
+            }
+        }
+    }
+}
+
+// One request per connection; whatever was asked for, the answer is the metrics
+void MetricsExporter::answer(int fd) {
+    char request[1024];
+    pollfd ready = {fd, POLLIN, 0};
+    if (poll(&ready, 1, 1000) <= 0 || recv(fd, request, sizeof(request), 0) <= 0) {
+        return;
+    }
+    MetricsSnapshot snapshot;
+    snapshotMetrics(snapshot);
+    string body = prometheusText(snapshot);
+    string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                      to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    for (size_t sent = 0; sent < response.size();) {
+        pollfd writable = {fd, POLLOUT, 0};
+        if (poll(&writable, 1, 1000) <= 0) {
+            return;
+        }
+        ssize_t count = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (count <= 0) {
+            return;
+        }
+        sent += count;
+    }
+}
+
+#else
+
+void MetricsExporter::run() {
+    while (!stopping) {
+        if (!path.empty()) {
+            writeFile();
+        }
+        this_thread::sleep_for(chrono::milliseconds(periodMs));
+    }
+}
+
+void MetricsExporter::answer(int fd) {}
+
+#endif
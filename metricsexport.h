@@ -0,0 +1,33 @@
+#ifndef METRICSEXPORT_H
+#define METRICSEXPORT_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "metrics.h"
+
+// Publishes metric snapshots in the Prometheus text format: rewritten every period into a file
+// (replaced by rename, as node_exporter's textfile collector expects) and/or served to
+// "GET /metrics" on a local HTTP port. Either may be left out.
+class MetricsExporter {
+public:
+    ~MetricsExporter() { stop(); }
+
+    // False (and prints why) if the port cannot be bound
+    bool start(const string& path, int port, int periodMs);
+    void stop();
+
+private:
+    string path;
+    int listener = -1;
+    int periodMs = 1000;
+    atomic<bool> stopping{false};
+    thread worker;
+
+    void run();
+    void writeFile();
+    void answer(int fd);
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "net.h"
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+int openListener(const string& unixPath, const string& address, int port) {
+    int fd;
+    if (!unixPath.empty()) {
+        sockaddr_un local = {};
+        if (unixPath.size() >= sizeof(local.sun_path)) {
+            return -1;
+        }
+        local.sun_family = AF_UNIX;
+        unixPath.copy(local.sun_path, unixPath.size());
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        unlink(unixPath.c_str());
+        if (fd < 0 || bind(fd, (sockaddr*) &local, sizeof(local)) != 0) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        sockaddr_in inet = {};
+        inet.sin_family = AF_INET;
+        inet.sin_port = htons(port);
+        if (inet_pton(AF_INET, address.c_str(), &inet.sin_addr) != 1) {
+            return -1;
+        }
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+            bind(fd, (sockaddr*) &inet, sizeof(inet)) != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    if (listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int connectTo(const string& unixPath, const string& host, int port) {
+    int fd;
+    if (!unixPath.empty()) {
+        sockaddr_un local = {};
+        if (unixPath.size() >= sizeof(local.sun_path)) {
+            return -1;
+        }
+        local.sun_family = AF_UNIX;
+        unixPath.copy(local.sun_path, unixPath.size());
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, (sockaddr*) &local, sizeof(local)) != 0) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        sockaddr_in inet = {};
+        inet.sin_family = AF_INET;
+        inet.sin_port = htons(port);
+        if (inet_pton(AF_INET, host.c_str(), &inet.sin_addr) != 1) {
+            return -1;
+        }
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, (sockaddr*) &inet, sizeof(inet)) != 0) {
+            close(fd);
+            return -1;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+#else
+
+int openListener(const string& unixPath, const string& address, int port) {
+    return -1;
+}
+
+int connectTo(const string& unixPath, const string& host, int port) {
+    return -1;
+}
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef NET_H
+#define NET_H
+
+#include <string>
+
+using namespace std;
+
+// Listening socket (non-blocking) on a Unix path when unixPath is set, else on address:port; -1 on failure
+int openListener(const string& unixPath, const string& address, int port);
+
+// Blocking connection to a Unix path when unixPath is set, else to host:port (with TCP_NODELAY); -1 on failure
+int connectTo(const string& unixPath, const string& host, int port);
+
+#endif
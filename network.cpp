@@ -0,0 +1,422 @@
+#include "network.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define NETWORK_HAVE_AVX2 1
+#endif
+
+namespace {
+
+// acc[0..n) += x * row[0..n)
+void axpyScalar(float* acc, float x, const float* row, int n) {
+    for (int i = 0; i < n; i++) {
+        acc[i] += x * row[i];
+    }
+}
+
+void reluScalar(float* v, int n) {
+    for (int i = 0; i < n; i++) {
+        v[i] = v[i] > 0 ? v[i] : 0;
+    }
+}
+
+#ifdef NETWORK_HAVE_AVX2
+__attribute__((target("avx2,fma")))
+void axpyAvx2(float* acc, float x, const float* row, int n) {
+    __m256 scale = _mm256_set1_ps(x);
+    for (int i = 0; i < n; i += NETWORK_LANES) {
+        __m256 a = _mm256_loadu_ps(acc + i);
+        a = _mm256_fmadd_ps(scale, _mm256_loadu_ps(row + i), a);
+        _mm256_storeu_ps(acc + i, a);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+void reluAvx2(float* v, int n) {
+    __m256 zero = _mm256_setzero_ps();
+    for (int i = 0; i < n; i += NETWORK_LANES) {
+        _mm256_storeu_ps(v + i, _mm256_max_ps(_mm256_loadu_ps(v + i), zero));
+    }
+}
+#endif
+
+struct Kernels {
+    void (*axpy)(float*, float, const float*, int);
+    void (*relu)(float*, int);
+    const char* name;
+};
+
+// Picked once per process from what the CPU supports
+const Kernels& kernels() {
+    static const Kernels picked = []() {
+#ifdef NETWORK_HAVE_AVX2
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return Kernels{axpyAvx2, reluAvx2, "avx2"};
+        }
+#endif
+        return Kernels{axpyScalar, reluScalar, "scalar"};
+    }();
+    return picked;
+}
+
+template <typename T>
+bool readValues(ifstream& in, vector<T>& values, size_t count) {
+    values.resize(count);
+    in.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+    return (bool) in;
+}
+
+template <typename T>
+void writeValues(ofstream& out, const vector<T>& values, size_t count) {
+    out.write(reinterpret_cast<const char*>(values.data()), count * sizeof(T));
+}
+
+}
+
+const char* Network::kernelName() {
+    return kernels().name;
+}
+
+bool Network::load(const string& path) {
+    ifstream in(path, ios::binary);
+    NetworkFileHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        memcmp(header.magic, NETWORK_MAGIC, sizeof(header.magic)) != 0) {
+        return false;
+    }
+    if (header.inputs != FEATURE_WIDTH || header.outputs != NETWORK_OUTPUTS || header.hidden1 == 0 ||
+        header.hidden2 == 0 || header.hidden1 % NETWORK_LANES != 0 || header.hidden2 % NETWORK_LANES != 0) {
+        return false;
+    }
+    hidden1 = header.hidden1;
+    hidden2 = header.hidden2;
+    vector<float> output, outputBias;
+    if (!readValues(in, w1, (size_t) FEATURE_WIDTH * hidden1) || !readValues(in, b1, hidden1) ||
+        !readValues(in, w2, (size_t) hidden1 * hidden2) || !readValues(in, b2, hidden2) ||
+        !readValues(in, output, (size_t) hidden2 * NETWORK_OUTPUTS) || !readValues(in, outputBias, NETWORK_OUTPUTS)) {
+        return false;
+    }
+
+    // The output layer is padded in memory so every row is one vector register
+    w3.assign((size_t) hidden2 * NETWORK_OUTPUT_STRIDE, 0);
+    b3.assign(NETWORK_OUTPUT_STRIDE, 0);
+    for (int i = 0; i < hidden2; i++) {
+        copy(output.begin() + i * NETWORK_OUTPUTS, output.begin() + (i + 1) * NETWORK_OUTPUTS,
+             w3.begin() + i * NETWORK_OUTPUT_STRIDE);
+    }
+    copy(outputBias.begin(), outputBias.end(), b3.begin());
+    return true;
+}
+
+bool Network::save(const string& path) const {
+    ofstream out(path, ios::binary);
+    NetworkFileHeader header;
+    memcpy(header.magic, NETWORK_MAGIC, sizeof(header.magic));
+    header.inputs = FEATURE_WIDTH;
+    header.hidden1 = hidden1;
+    header.hidden2 = hidden2;
+    header.outputs = NETWORK_OUTPUTS;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeValues(out, w1, w1.size());
+    writeValues(out, b1, b1.size());
+    writeValues(out, w2, w2.size());
+    writeValues(out, b2, b2.size());
+    for (int i = 0; i < hidden2; i++) {
+        out.write(reinterpret_cast<const char*>(&w3[i * NETWORK_OUTPUT_STRIDE]), NETWORK_OUTPUTS * sizeof(float));
+    }
+    writeValues(out, b3, NETWORK_OUTPUTS);
+    return out.good();
+}
+
+void Network::randomize(int hidden1Size, int hidden2Size, uint64_t seed) {
+    hidden1 = hidden1Size;
+    hidden2 = hidden2Size;
+    Dice dice(seed);
+    auto uniform = [&](vector<float>& values, size_t count, float scale) {
+        values.resize(count);
+        for (auto& v : values) {
+            v = ((dice.next() >> 11) * (1.0 / 9007199254740992.0) * 2 - 1) * scale;
+        }
+    };
+    // Only FEATURE_SEATS * FEATURE_TOKENS inputs are ever set, so that is the first layer's fan-in
+    uniform(w1, (size_t) FEATURE_WIDTH * hidden1, sqrt(6.0f / (FEATURE_SEATS * FEATURE_TOKENS + hidden1)));
+    b1.assign(hidden1, 0);
+    uniform(w2, (size_t) hidden1 * hidden2, sqrt(6.0f / (hidden1 + hidden2)));
+    b2.assign(hidden2, 0);
+    uniform(w3, (size_t) hidden2 * NETWORK_OUTPUT_STRIDE, sqrt(6.0f / (hidden2 + NETWORK_OUTPUTS)));
+    for (int i = 0; i < hidden2; i++) {
+        fill(w3.begin() + i * NETWORK_OUTPUT_STRIDE + NETWORK_OUTPUTS, w3.begin() + (i + 1) * NETWORK_OUTPUT_STRIDE, 0.0f);
+    }
+    b3.assign(NETWORK_OUTPUT_STRIDE, 0);
+}
+
+void Network::evaluate(const uint8_t* features, int batch, float* policy, float* value) const {
+    const Kernels& k = kernels();
+    static thread_local vector<float> scratch;
+    scratch.resize((size_t) batch * (hidden1 + hidden2 + NETWORK_OUTPUT_STRIDE));
+    float* h1 = scratch.data();
+    float* h2 = h1 + (size_t) batch * hidden1;
+    float* out = h2 + (size_t) batch * hidden2;
+
+    // Input layer: the input is one-hot, so each set feature adds one weight row
+    for (int b = 0; b < batch; b++) {
+        float* acc = h1 + (size_t) b * hidden1;
+        const uint8_t* row = features + (size_t) b * FEATURE_WIDTH;
+        copy(b1.begin(), b1.end(), acc);
+        for (int f = 0; f < FEATURE_WIDTH; f++) {
+            if (row[f]) {
+                k.axpy(acc, 1.0f, &w1[(size_t) f * hidden1], hidden1);
+            }
+        }
+        k.relu(acc, hidden1);
+    }
+
+    // Hidden layers walk the weights once per input unit for the whole batch
+    for (int b = 0; b < batch; b++) {
+        copy(b2.begin(), b2.end(), h2 + (size_t) b * hidden2);
+        copy(b3.begin(), b3.end(), out + (size_t) b * NETWORK_OUTPUT_STRIDE);
+    }
+    for (int i = 0; i < hidden1; i++) {
+        const float* weights = &w2[(size_t) i * hidden2];
+        for (int b = 0; b < batch; b++) {
+            float x = h1[(size_t) b * hidden1 + i];
+            if (x != 0) {
+                k.axpy(h2 + (size_t) b * hidden2, x, weights, hidden2);
+            }
+        }
+    }
+    k.relu(h2, batch * hidden2);
+    for (int i = 0; i < hidden2; i++) {
+        const float* weights = &w3[(size_t) i * NETWORK_OUTPUT_STRIDE];
+        for (int b = 0; b < batch; b++) {
+            float x = h2[(size_t) b * hidden2 + i];
+            if (x != 0) {
+                k.axpy(out + (size_t) b * NETWORK_OUTPUT_STRIDE, x, weights, NETWORK_OUTPUT_STRIDE);
+            }
+        }
+    }
+
+    for (int b = 0; b < batch; b++) {
+        const float* row = out + (size_t) b * NETWORK_OUTPUT_STRIDE;
+        if (policy) {
+            copy(row, row + ACTION_COUNT, policy + (size_t) b * ACTION_COUNT);
+        }
+        if (value) {
+            value[b] = tanh(row[ACTION_COUNT]);
+        }
+    }
+}
+
+int NeuralPolicy::chooseMove(const vector<Player>& players, int playerIndex, int diceRoll, const vector<int>& moves) {
+    Board board;
+    features.resize(moves.size() * FEATURE_WIDTH);
+    values.resize(moves.size());
+    for (int i = 0; i < moves.size(); i++) {
+        next = players;
+        applyMove(next[playerIndex], moves[i], diceRoll, board);
+        encodeFeatures(next, playerIndex, &features[i * FEATURE_WIDTH]);
+    }
+    network.evaluate(features.data(), moves.size(), nullptr, values.data());
+    int best = 0;
+    for (int i = 1; i < moves.size(); i++) {
+        if (values[i] > values[best]) {
+            best = i;
+        }
+    }
+    return moves[best];
+}
+
+int NeuralBatch::playAll(vector<Table>& tables) {
+    int moved = chooseAll(tables, chosen);
+    for (size_t i = 0; i < tables.size(); i++) {
+        if (tables[i].state == Table::TABLE_WAITING) {
+            tables[i].play(chosen[i]);
+        }
+    }
+    return moved;
+}
+
+int NeuralBatch::chooseAll(const vector<Table>& tables, vector<int>& choices) {
+    Board board;
+    rows = 0;
+    for (const auto& table : tables) {
+        if (table.state == Table::TABLE_WAITING) {
+            rows += table.moves.size();
+        }
+    }
+    choices.resize(tables.size());
+    features.resize((size_t) rows * FEATURE_WIDTH);
+    values.resize(rows);
+    size_t row = 0;
+    for (const auto& table : tables) {
+        if (table.state != Table::TABLE_WAITING) {
+            continue;
+        }
+        for (int move : table.moves) {
+            next = table.players;
+            applyMove(next[table.seat], move, table.diceRoll, board);
+            encodeFeatures(next, table.seat, &features[row++ * FEATURE_WIDTH]);
+        }
+    }
+    if (rows == 0) {
+        return 0;
+    }
+    network.evaluate(features.data(), rows, nullptr, values.data());
+
+    // Same pick as NeuralPolicy: the first of the best-valued moves
+    int waiting = 0;
+    const float* value = values.data();
+    for (size_t t = 0; t < tables.size(); t++) {
+        const Table& table = tables[t];
+        if (table.state != Table::TABLE_WAITING) {
+            continue;
+        }
+        int count = table.moves.size();
+        int best = 0;
+        for (int i = 1; i < count; i++) {
+            if (value[i] > value[best]) {
+                best = i;
+            }
+        }
+        value += count;
+        choices[t] = table.moves[best];
+        waiting++;
+    }
+    return waiting;
+}
+
+int runNetworkInit(int argc, char** argv) {
+    if (argc < 3) {
+        cout << "Usage: " << argv[0] << " nn-init <weights> [--hidden H1 H2] [--seed S]\n";
+        return 1;
+    }
+    int hidden1 = 128, hidden2 = 32;
+    uint64_t seed = 1;
+    for (int i = 3; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--hidden" && i + 2 < argc) {
+            hidden1 = stoi(argv[++i]);
+            hidden2 = stoi(argv[++i]);
+        } else if (option == "--seed" && i + 1 < argc) {
+            seed = stoull(argv[++i]);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (hidden1 <= 0 || hidden2 <= 0 || hidden1 % NETWORK_LANES != 0 || hidden2 % NETWORK_LANES != 0) {
+        cout << "Hidden sizes must be positive multiples of " << NETWORK_LANES << ".\n";
+        return 1;
+    }
+    Network network;
+    network.randomize(hidden1, hidden2, seed);
+    if (!network.save(argv[2])) {
+        cout << "Could not write " << argv[2] << "\n";
+        return 1;
+    }
+    cout << "Wrote " << FEATURE_WIDTH << "-" << hidden1 << "-" << hidden2 << "-" << NETWORK_OUTPUTS
+         << " network to " << argv[2] << "\n";
+    return 0;
+}
+
+int runNetworkBench(int argc, char** argv) {
+    if (argc < 3) {
+        cout << "Usage: " << argv[0] << " nn-bench <weights> [--positions N]\n";
+        return 1;
+    }
+    Network network;
+    if (!network.load(argv[2])) {
+        cout << "Could not load network " << argv[2] << "\n";
+        return 1;
+    }
+    int positionCount = 4096, gameCount = 256;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        if (option == "--positions") {
+            positionCount = max(256, stoi(argv[i + 1]));
+        } else if (option == "--games") {
+            gameCount = max(1, stoi(argv[i + 1]));
+        } else {
+            cout << "Usage: " << argv[0] << " nn-bench <weights> [--positions N] [--games G]\n";
+            return 1;
+        }
+    }
+
+    // Realistic inputs: positions reached by random self-play
+    vector<uint8_t> positions((size_t) positionCount * FEATURE_WIDTH);
+    Board board;
+    Dice dice(1);
+    RandomPolicy random(2);
+    vector<Player> players;
+    int filled = 0;
+    for (int turn = 0; filled < positionCount; turn++) {
+        if (turn % DEFAULT_MAX_TURNS == 0) {
+            players.clear();
+            for (int i = 0; i < 4; i++) {
+                players.push_back(Player(i));
+            }
+        }
+        playHeadlessTurn(players, turn % 4, board, dice, random, turn, nullptr);
+        encodeFeatures(players, (turn + 1) % 4, &positions[(size_t) filled++ * FEATURE_WIDTH]);
+    }
+
+    cout << "Kernels: " << Network::kernelName() << ", network " << FEATURE_WIDTH << "-" << network.hidden1 << "-"
+         << network.hidden2 << "-" << NETWORK_OUTPUTS << "\n";
+    vector<float> policy(256 * ACTION_COUNT), value(256);
+    for (int batch : {1, 32, 256}) {
+        long long evaluated = 0;
+        auto started = chrono::steady_clock::now();
+        double elapsed = 0;
+        while (elapsed < 0.5) {
+            for (int first = 0; first + batch <= positionCount; first += batch) {
+                network.evaluate(&positions[(size_t) first * FEATURE_WIDTH], batch, policy.data(), value.data());
+                evaluated += batch;
+            }
+            elapsed = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        }
+        cout << "batch " << batch << ": " << (long long) (evaluated / elapsed) << " positions/sec\n";
+    }
+
+    // The same games with every seat neural: each decision on its own, then every waiting game at once
+    NeuralPolicy single(network);
+    vector<Table> tables(gameCount);
+    long long decisions = 0;
+    uint64_t singleHash = 0;
+    auto started = chrono::steady_clock::now();
+    for (int g = 0; g < gameCount; g++) {
+        Table& table = tables[g];
+        table.start(4, gameSeed(1, g), DEFAULT_MAX_TURNS);
+        while (table.state == Table::TABLE_WAITING) {
+            table.play(single.chooseMove(table.players, table.seat, table.diceRoll, table.moves));
+            decisions++;
+        }
+        singleHash += table.hash();
+    }
+    double singleSeconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+    NeuralBatch batched(network);
+    long long passes = 0, rows = 0;
+    uint64_t batchHash = 0;
+    started = chrono::steady_clock::now();
+    for (int g = 0; g < gameCount; g++) {
+        tables[g].start(4, gameSeed(1, g), DEFAULT_MAX_TURNS);
+    }
+    while (batched.playAll(tables) > 0) {
+        passes++;
+        rows += batched.lastBatch();
+    }
+    double batchSeconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    for (const auto& table : tables) {
+        batchHash += table.hash();
+    }
+    cout << gameCount << " games, " << decisions << " decisions: one pass per decision "
+         << (long long) (decisions / singleSeconds) << " decisions/sec, one pass for all waiting games "
+         << (long long) (decisions / batchSeconds) << " decisions/sec (mean batch " << (passes ? rows / passes : 0)
+         << " positions)" << (singleHash == batchHash ? "" : ", GAMES DIFFER") << "\n";
+    return singleHash == batchHash ? 0 : 1;
+}
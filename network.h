@@ -0,0 +1,94 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <string>
+
+#include "ludo.h"
+#include "selfplay.h"
+#include "table.h"
+#include "training.h"
+
+const char NETWORK_MAGIC[8] = {'L', 'U', 'D', 'O', 'N', 'E', 'T', '1'};
+const int NETWORK_OUTPUTS = ACTION_COUNT + 1; // Policy logit per action, then the value
+const int NETWORK_OUTPUT_STRIDE = 8;          // Outputs padded to one AVX2 register
+const int NETWORK_LANES = 8;                  // Hidden sizes must be a multiple of this
+
+#pragma pack(push, 1)
+struct NetworkFileHeader {
+    char magic[8];
+    uint32_t inputs;
+    uint32_t hidden1;
+    uint32_t hidden2;
+    uint32_t outputs;
+};
+#pragma pack(pop)
+
+// Small MLP over the training feature rows: sparse input -> hidden1 -> hidden2 -> policy/value,
+// ReLU between layers. Weights are stored input-major so each layer is a run of axpy updates.
+class Network {
+public:
+    int hidden1 = 0;
+    int hidden2 = 0;
+    vector<float> w1, b1, w2, b2, w3, b3;
+
+    bool load(const string& path);
+    bool save(const string& path) const;
+    void randomize(int hidden1, int hidden2, uint64_t seed);
+
+    // Evaluates batch rows of FEATURE_WIDTH one-hot bytes; policy gets ACTION_COUNT logits per row,
+    // value one number in [-1, 1] per row (either may be null)
+    void evaluate(const uint8_t* features, int batch, float* policy, float* value) const;
+
+    // Name of the kernel set picked for this CPU
+    static const char* kernelName();
+};
+
+// Bot that scores the position after each legal move with the value head, in one batch. A single
+// decision makes a batch of at most 5 rows; NeuralBatch below fills wider ones.
+class NeuralPolicy : public Policy {
+public:
+    explicit NeuralPolicy(const Network& network) : network(network) {}
+
+    int chooseMove(const vector<Player>& players, int playerIndex, int diceRoll, const vector<int>& moves) override;
+
+private:
+    const Network& network;
+    vector<uint8_t> features;
+    vector<float> values;
+    vector<Player> next;
+};
+
+// Plays NeuralPolicy's choice on many tables at once: the positions after every legal move of every
+// table waiting for a choice go through the network in one forward pass, so games played together
+// (self-play, evaluation matches) reach the batch sizes nn-bench measures
+class NeuralBatch {
+public:
+    explicit NeuralBatch(const Network& network) : network(network) {}
+
+    // Plays a move on each waiting table; returns how many tables moved
+    int playAll(vector<Table>& tables);
+
+    // The move playAll would play on each waiting table, into choices[i] for tables[i] (others are
+    // left as they were), for callers that look at a choice before playing it; returns how many
+    int chooseAll(const vector<Table>& tables, vector<int>& choices);
+
+    // Rows in the last forward pass
+    int lastBatch() const { return rows; }
+
+private:
+    const Network& network;
+    vector<uint8_t> features;
+    vector<float> values;
+    vector<Player> next;
+    vector<int> chosen;
+    int rows = 0;
+};
+
+// "nn-init" command: writes a randomly initialised weights file
+int runNetworkInit(int argc, char** argv);
+
+// "nn-bench" command: reports positions/sec at batch sizes 1, 32 and 256, then neural games played
+// one decision per forward pass against all waiting games in one pass
+int runNetworkBench(int argc, char** argv);
+
+#endif
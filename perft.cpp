@@ -0,0 +1,425 @@
+#include "perft.h"
+#include "position.h"
+
+#include <atomic>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Known counts cross-checked against an independent reimplementation of playerTurn's rules;
+// checked by "perft --verify"
+struct PerftFixture {
+    const char* position;
+    int depth;
+    uint64_t values[STAT_COUNT];
+};
+
+const PerftFixture PERFT_FIXTURES[] = {
+    {"-,-,-,-/-,-,-,- 1 0", 5, {10340, 1505, 2015, 4875, 0}},
+    {"-,-,-,-/-,-,-,- 1 0", 6, {73630, 10335, 14555, 30625, 0}},
+    {"-,-,-,-/-,-,-,- 1 0", 7, {566615, 73500, 113430, 192125, 0}},
+    {"-,-,-,-/-,-,-,-/-,-,-,- 2 0", 6, {63925, 9440, 12275, 31625, 0}},
+    {"-,-,-,-/-,-,-,-/-,-,-,-/-,-,-,- 4 0", 5, {9315, 1480, 1615, 6125, 0}},
+    {"-,-,-,-/-,-,-,-/-,-,-,-/-,-,-,- 1 0", 7, {396425, 59300, 75175, 205125, 0}},
+    {"0,5,-,-/12,-,-,- 1 0", 5, {149850, 12702, 33235, 0, 0}},
+    {"3,17,40,51/-,-,-,-/26,-,2,- 2 0", 5, {196075, 14605, 35220, 37500, 0}},
+    {"10,20,30,-/5,-,-,-/-,-,-,-/50,49,48,47 4 2", 4, {37056, 4296, 6720, 9000, 0}},
+    {"h,5,-,-/12,-,-,- 1 0", 5, {35310, 3618, 8325, 0, 0}},         // Tokens home never move again
+    {"h,h,30,-/-,-,-,-/7,h,-,- 3 0", 4, {2898, 384, 638, 750, 0}},
+};
+
+const int PASS = ENTER_TOKEN - 1; // Root task marker for a roll with no legal move
+
+struct ZobristKeys {
+    uint64_t tokens[4][4][BOARD_SIZE + 2];
+    uint64_t seat[4];
+    uint64_t chances[MAX_CHANCES];
+
+    ZobristKeys() {
+        Dice dice(0x5EED);
+        for (auto& seatKeys : tokens) {
+            for (auto& tokenKeys : seatKeys) {
+                for (auto& key : tokenKeys) {
+                    key = dice.next();
+                }
+            }
+        }
+        for (auto& key : seat) {
+            key = dice.next();
+        }
+        for (auto& key : chances) {
+            key = dice.next();
+        }
+    }
+};
+
+const ZobristKeys ZOBRIST;
+
+struct HashEntry {
+    uint64_t key = 0;
+    int depth = 0; // 0 marks an empty slot
+    PerftCounts counts;
+};
+
+int tokensHome(const Player& player) {
+    int home = 0;
+    for (const auto& token : player.tokens) {
+        if (token.hasWon()) {
+            home++;
+        }
+    }
+    return home;
+}
+
+// Depth-first expansion with do/undo on one state; owned by a single thread
+class PerftSearch {
+public:
+    PerftState state;
+
+    PerftSearch(const PerftState& root, int hashMegabytes) : state(root), saved(MAX_PERFT_DEPTH + 1, root.players[0]) {
+        if (hashMegabytes > 0) {
+            size_t entries = 1;
+            while (entries * 2 * sizeof(HashEntry) <= (size_t) hashMegabytes * 1024 * 1024) {
+                entries *= 2;
+            }
+            table.resize(entries);
+        }
+    }
+
+    // Counts below the current state: sub.values[0] are its children, sub.values[1] theirs, ...
+    void expand(int depth, PerftCounts& sub) {
+        uint64_t key = 0;
+        if (!table.empty()) {
+            key = hashState();
+            HashEntry& entry = table[key & (table.size() - 1)];
+            if (entry.depth == depth && entry.key == key) {
+                sub = entry.counts;
+                return;
+            }
+        }
+
+        Board board;
+        int seat = state.seat;
+        int chances = state.chances;
+        for (int diceRoll = 1; diceRoll <= 6; diceRoll++) {
+            vector<int>& moves = moveBuffers[depth];
+            legalMoves(state.players[seat], diceRoll, moves);
+            bool extraRoll = diceRoll == 6 && chances + 1 < MAX_CHANCES;
+            if (moves.empty()) {
+                sub.values[0][STAT_PASSES]++;
+                visitChild(depth, sub, extraRoll, false);
+                continue;
+            }
+            for (int move : moves) {
+                saved[depth] = state.players[seat];
+                int homeBefore = tokensHome(saved[depth]);
+                applyMove(state.players[seat], move, diceRoll, board);
+                if (move == ENTER_TOKEN) {
+                    sub.values[0][STAT_ENTRIES]++;
+                }
+                sub.values[0][STAT_FINISHES] += tokensHome(state.players[seat]) - homeBefore;
+                visitChild(depth, sub, extraRoll, state.players[seat].allTokensInHome());
+                state.players[seat] = saved[depth];
+            }
+        }
+
+        if (!table.empty()) {
+            HashEntry& entry = table[key & (table.size() - 1)];
+            entry.key = key;
+            entry.depth = depth;
+            entry.counts = sub;
+        }
+    }
+
+    // Counts the child reached after the current roll and recurses into it unless the game is over
+    void visitChild(int depth, PerftCounts& sub, bool extraRoll, bool gameOver) {
+        sub.values[0][STAT_NODES]++;
+        if (extraRoll) {
+            sub.values[0][STAT_EXTRA_ROLLS]++;
+        }
+        if (depth <= 1 || gameOver) {
+            return;
+        }
+        int seat = state.seat;
+        int chances = state.chances;
+        if (extraRoll) {
+            state.chances++;
+        } else {
+            state.seat = (seat + 1) % state.players.size();
+            state.chances = 0;
+        }
+        PerftCounts child;
+        expand(depth - 1, child);
+        sub.add(child, 1, depth - 1);
+        state.seat = seat;
+        state.chances = chances;
+    }
+
+private:
+    vector<HashEntry> table;
+    // Per remaining depth, so each level reuses its storage: the moves being tried and the mover before each
+    vector<int> moveBuffers[MAX_PERFT_DEPTH + 1];
+    vector<Player> saved;
+
+    uint64_t hashState() const {
+        uint64_t key = ZOBRIST.seat[state.seat] ^ ZOBRIST.chances[state.chances];
+        for (int i = 0; i < state.players.size(); i++) {
+            const auto& tokens = state.players[i].tokens;
+            for (int t = 0; t < tokens.size() && t < 4; t++) {
+                key ^= ZOBRIST.tokens[i][t][tokenProgress(tokens[t], i) + 1];
+            }
+        }
+        return key;
+    }
+};
+
+}
+
+void PerftCounts::add(const PerftCounts& other, int depthOffset, int depths) {
+    for (int d = 0; d < depths && d + depthOffset < MAX_PERFT_DEPTH; d++) {
+        for (int s = 0; s < STAT_COUNT; s++) {
+            values[d + depthOffset][s] += other.values[d][s];
+        }
+    }
+}
+
+const char* perftStatName(int stat) {
+    switch (stat) {
+        case STAT_NODES:
+            return "nodes";
+        case STAT_ENTRIES:
+            return "entries";
+        case STAT_EXTRA_ROLLS:
+            return "extra_rolls";
+        case STAT_PASSES:
+            return "passes";
+        case STAT_FINISHES:
+            return "finishes";
+        default:
+            return "unknown";
+    }
+}
+
+PerftCounts perft(const PerftState& root, int depth, int threads, int hashMegabytes) {
+    PerftCounts total;
+    if (depth < 1) {
+        return total;
+    }
+
+    // Root children (one per dice outcome and move) are handed out to the threads
+    vector<pair<int, int>> tasks;
+    vector<int> moves;
+    for (int diceRoll = 1; diceRoll <= 6; diceRoll++) {
+        legalMoves(root.players[root.seat], diceRoll, moves);
+        if (moves.empty()) {
+            tasks.push_back({diceRoll, PASS});
+        }
+        for (int move : moves) {
+            tasks.push_back({diceRoll, move});
+        }
+    }
+
+    atomic<int> nextTask(0);
+    vector<PerftCounts> results(threads);
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread([&, t]() {
+            PerftSearch search(root, hashMegabytes / threads);
+            Board board;
+            Player& player = search.state.players[root.seat];
+            Player saved = player;
+            for (int i = nextTask++; i < tasks.size(); i = nextTask++) {
+                int diceRoll = tasks[i].first;
+                int move = tasks[i].second;
+                saved = player;
+                PerftCounts sub;
+                bool extraRoll = diceRoll == 6 && root.chances + 1 < MAX_CHANCES;
+                bool gameOver = false;
+                if (move == PASS) {
+                    sub.values[0][STAT_PASSES]++;
+                } else {
+                    int homeBefore = tokensHome(player);
+                    applyMove(player, move, diceRoll, board);
+                    if (move == ENTER_TOKEN) {
+                        sub.values[0][STAT_ENTRIES]++;
+                    }
+                    sub.values[0][STAT_FINISHES] += tokensHome(player) - homeBefore;
+                    gameOver = player.allTokensInHome();
+                }
+                search.visitChild(depth, sub, extraRoll, gameOver);
+                player = saved;
+                results[t].add(sub, 0, depth);
+            }
+        }));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (const auto& result : results) {
+        total.add(result, 0, depth);
+    }
+    return total;
+}
+
+namespace {
+
+bool perftRoot(const char* text, PerftState& root) {
+    Position position;
+    if (!parsePosition(text, position)) {
+        return false;
+    }
+    playersFromPosition(position, root.players);
+    root.seat = position.seat;
+    root.chances = position.chances;
+    return true;
+}
+
+}
+
+int runPerft(int argc, char** argv) {
+    int depth = 0;
+    int numPlayers = 4;
+    int seat = 0;
+    int threads = max(1u, thread::hardware_concurrency());
+    int hashMegabytes = 0;
+    bool verify = false;
+    string positionText, suitePath;
+    for (int i = 2; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--verify") {
+            verify = true;
+        } else if (option == "--players" && i + 1 < argc) {
+            numPlayers = stoi(argv[++i]);
+        } else if (option == "--seat" && i + 1 < argc) {
+            seat = stoi(argv[++i]) - 1;
+        } else if (option == "--position" && i + 1 < argc) {
+            positionText = argv[++i];
+        } else if (option == "--suite" && i + 1 < argc) {
+            suitePath = argv[++i];
+        } else if (option == "--threads" && i + 1 < argc) {
+            threads = stoi(argv[++i]);
+        } else if (option == "--hash" && i + 1 < argc) {
+            hashMegabytes = stoi(argv[++i]);
+        } else if (option.rfind("--", 0) != 0) {
+            depth = stoi(option);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (threads < 1 || hashMegabytes < 0) {
+        cout << "Threads must be at least 1 and the hash size not negative.\n";
+        return 1;
+    }
+
+    if (verify || !suitePath.empty()) {
+        // Suite file lines: <position>;<depth>[;<expected nodes at that depth>], '#' starts a comment
+        vector<PerftFixture> cases;
+        vector<string> lines;
+        if (verify) {
+            cases.assign(begin(PERFT_FIXTURES), end(PERFT_FIXTURES));
+        } else {
+            ifstream in(suitePath);
+            if (!in) {
+                cout << "Could not read " << suitePath << "\n";
+                return 1;
+            }
+            string line;
+            while (getline(in, line)) {
+                if (!line.empty() && line[0] != '#') {
+                    lines.push_back(line);
+                }
+            }
+            for (auto& line : lines) {
+                size_t first = line.find(';');
+                if (first == string::npos) {
+                    cout << "Missing depth in suite line: " << line << "\n";
+                    return 1;
+                }
+                PerftFixture fixture = {line.c_str(), stoi(line.substr(first + 1)), {}};
+                size_t second = line.find(';', first + 1);
+                fixture.values[STAT_NODES] = second == string::npos ? 0 : stoull(line.substr(second + 1));
+                line[first] = '\0';
+                cases.push_back(fixture);
+            }
+        }
+
+        bool ok = true;
+        uint64_t nodes = 0;
+        auto started = chrono::steady_clock::now();
+        for (const auto& fixture : cases) {
+            PerftState root;
+            if (!perftRoot(fixture.position, root) || fixture.depth < 1 || fixture.depth > MAX_PERFT_DEPTH) {
+                cout << "FAIL " << fixture.position << ": bad position or depth\n";
+                ok = false;
+                continue;
+            }
+            PerftCounts counts = perft(root, fixture.depth, threads, hashMegabytes);
+            const uint64_t* got = counts.values[fixture.depth - 1];
+            bool match = true;
+            for (int s = 0; s < STAT_COUNT; s++) {
+                bool checked = verify || (s == STAT_NODES && fixture.values[s] > 0);
+                match = match && (!checked || got[s] == fixture.values[s]);
+            }
+            cout << (match ? "ok   " : "FAIL ") << fixture.position << " depth " << fixture.depth << ": "
+                 << got[STAT_NODES] << " nodes";
+            if (verify || fixture.values[STAT_NODES] > 0) {
+                cout << " (expected " << fixture.values[STAT_NODES] << ")";
+            }
+            cout << "\n";
+            ok = ok && match;
+            for (int d = 0; d < fixture.depth; d++) {
+                nodes += counts.values[d][STAT_NODES];
+            }
+        }
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        cout << cases.size() << " positions, " << nodes << " nodes in " << elapsed << " s ("
+             << (uint64_t) (nodes / max(elapsed, 1e-9)) << " nodes/sec)\n";
+        return ok ? 0 : 1;
+    }
+
+    PerftState root;
+    if (!positionText.empty()) {
+        if (!perftRoot(positionText.c_str(), root)) {
+            cout << "Invalid position: " << positionText << "\n";
+            return 1;
+        }
+    } else if (numPlayers >= 2 && numPlayers <= 4 && seat >= 0 && seat < numPlayers) {
+        for (int i = 0; i < numPlayers; i++) {
+            root.players.push_back(Player(i));
+        }
+        root.seat = seat;
+    } else {
+        depth = 0;
+    }
+    if (depth < 1 || depth > MAX_PERFT_DEPTH) {
+        cout << "Usage: " << argv[0] << " perft <depth 1-" << MAX_PERFT_DEPTH << "> [--position TEXT | --players N"
+             << " --seat S] [--threads K] [--hash MB]\n"
+             << "       " << argv[0] << " perft --verify | --suite FILE [--threads K] [--hash MB]\n";
+        return 1;
+    }
+
+    auto started = chrono::steady_clock::now();
+    PerftCounts counts = perft(root, depth, threads, hashMegabytes);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+    cout << "depth";
+    for (int s = 0; s < STAT_COUNT; s++) {
+        cout << " " << perftStatName(s);
+    }
+    cout << "\n";
+    uint64_t nodes = 0;
+    for (int d = 0; d < depth; d++) {
+        cout << d + 1;
+        for (int s = 0; s < STAT_COUNT; s++) {
+            cout << " " << counts.values[d][s];
+        }
+        cout << "\n";
+        nodes += counts.values[d][STAT_NODES];
+    }
+    cout << nodes << " nodes in " << elapsed << " s (" << (uint64_t) (nodes / max(elapsed, 1e-9)) << " nodes/sec)\n";
+    return 0;
+}
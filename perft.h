@@ -0,0 +1,39 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "ludo.h"
+
+const int MAX_PERFT_DEPTH = 12;
+
+enum PerftStat {
+    STAT_NODES = 0,  // Positions reached (one per dice outcome and legal move, or pass)
+    STAT_ENTRIES,    // Moves that entered a token on a 6
+    STAT_EXTRA_ROLLS, // Sixes that gave the same player another roll
+    STAT_PASSES,     // Dice outcomes with no legal move
+    STAT_FINISHES,   // Moves that brought a token home
+    STAT_COUNT
+};
+
+// A position between rolls: the player to move and how many rolls they already used this turn
+struct PerftState {
+    vector<Player> players;
+    int seat = 0;
+    int chances = 0;
+};
+
+struct PerftCounts {
+    uint64_t values[MAX_PERFT_DEPTH][STAT_COUNT] = {};
+
+    void add(const PerftCounts& other, int depthOffset, int depths);
+};
+
+const char* perftStatName(int stat);
+
+// Expands every dice outcome and legal move down to depth; counts[d] holds the totals at ply d + 1.
+// hashMegabytes = 0 disables the transposition table.
+PerftCounts perft(const PerftState& root, int depth, int threads, int hashMegabytes);
+
+// "perft" command: prints per-depth counts and nodes/sec, or runs the built-in fixtures or a suite file
+int runPerft(int argc, char** argv);
+
+#endif
@@ -0,0 +1,242 @@
+#include "ponder.h"
+#include "histogram.h"
+#include "trace.h"
+
+#include <iomanip>
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+const int PONDER_SLICE = 4; // Rollouts between looks at the duty cycle; take() waits at most this long
+
+// A decision as RolloutSearch sees it; the dice are redrawn by every rollout anyway
+// Sets table up as seat's choice of moves for diceRoll; assigning keeps the table's storage
+void setDecision(Table& table, const vector<Player>& players, int seat, int diceRoll, const vector<int>& moves) {
+    table.players = players;
+    table.seat = seat;
+    table.diceRoll = diceRoll;
+    table.moves = moves;
+    table.state = Table::TABLE_WAITING;
+}
+
+Table decisionTable(const vector<Player>& players, int seat, int diceRoll, const vector<int>& moves) {
+    Table table;
+    setDecision(table, players, seat, diceRoll, moves);
+    return table;
+}
+
+}
+
+uint64_t decisionKey(const vector<Player>& players, int seat, int diceRoll) {
+    uint64_t digest = 0xCBF29CE484222325ULL; // FNV-1a, as in Table::hash
+    auto mix = [&](int value) { digest = (digest ^ (uint8_t) value) * 0x100000001B3ULL; };
+    for (const auto& player : players) {
+        for (const auto& token : player.tokens) {
+            mix(token.inPlay ? token.position : -1);
+        }
+    }
+    mix(seat);
+    mix(diceRoll);
+    return digest;
+}
+
+Ponderer::~Ponderer() {
+    if (worker.joinable()) {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+}
+
+void Ponderer::start(const vector<Table>& positions, uint64_t seed) {
+    {
+        lock_guard<mutex> guard(lock);
+        roots.clear();
+        Dice seeds(seed);
+        for (const auto& table : positions) {
+            unique_ptr<Root> root(new Root());
+            root->key = decisionKey(table.players, table.seat, table.diceRoll);
+            root->moves = table.moves;
+            root->search.reset(table, seeds.next());
+            roots.push_back(std::move(root));
+        }
+    }
+    if (!worker.joinable()) {
+        worker = thread([this]() { run(); });
+    }
+    wake.notify_one();
+}
+
+bool Ponderer::take(const Table& table, RolloutSearch& search) {
+    lock_guard<mutex> guard(lock);
+    uint64_t key = decisionKey(table.players, table.seat, table.diceRoll);
+    bool found = false;
+    for (auto& root : roots) {
+        if (root->key == key && root->moves == table.moves) {
+            search = std::move(root->search);
+            found = true;
+            break;
+        }
+    }
+    roots.clear(); // Whatever else was predicted did not happen
+    return found;
+}
+
+// Always works on the position with the fewest rollouts, so every prediction fills up evenly
+void Ponderer::run() {
+    unique_lock<mutex> guard(lock);
+    while (!stopping) {
+        Root* next = nullptr;
+        for (auto& root : roots) {
+            if (root->search.rollouts() < budget && (!next || root->search.rollouts() < next->search.rollouts())) {
+                next = root.get();
+            }
+        }
+        if (!next) {
+            wake.wait(guard);
+            continue;
+        }
+        auto started = Clock::now();
+        int count = min(PONDER_SLICE, budget - next->search.rollouts());
+        next->search.run(count, started + chrono::hours(1));
+        total.fetch_add(count, memory_order_relaxed);
+        if (sharePercent < 100) {
+            // Idle in proportion to hold the CPU share; the lock is free meanwhile, so take never waits on it
+            auto spent = Clock::now() - started;
+            wake.wait_for(guard, spent * (100 - max(1, sharePercent)) / max(1, sharePercent));
+        }
+    }
+}
+
+SearchPolicy::SearchPolicy(int budget, uint64_t seed) : budget(budget), dice(seed) {
+    background.budget = budget;
+}
+
+int SearchPolicy::chooseMove(const vector<Player>& players, int playerIndex, int diceRoll, const vector<int>& moves) {
+    decisions++;
+    TraceSpan span("bot search");
+    setDecision(decision, players, playerIndex, diceRoll, moves);
+    if (pondering && background.take(decision, search)) {
+        reused++;
+    } else {
+        search.reset(decision, dice.next());
+    }
+    span.arg = budget - search.rollouts();
+    TraceGame quiet(false);
+    search.run(span.arg, Clock::now() + chrono::hours(1));
+    return search.best();
+}
+
+void SearchPolicy::ponder(const vector<Player>& players, int mover, int diceRoll, const vector<int>& moves, int self) {
+    // After a 6 the mover rolls again, so only a roll that ends the turn is worth predicting from
+    if (!pondering || diceRoll == 6 || self != (mover + 1) % (int) players.size()) {
+        return;
+    }
+    Board board;
+    vector<Table> positions;
+    for (size_t i = 0; i < max<size_t>(1, moves.size()); i++) {
+        vector<Player> after = players;
+        if (!moves.empty()) {
+            applyMove(after[mover], moves[i], diceRoll, board);
+        }
+        if (after[mover].allTokensInHome()) {
+            continue; // The game would be over
+        }
+        for (int roll = 1; roll <= 6; roll++) {
+            vector<int> options = legalMoves(after[self], roll);
+            if (options.size() > 1) {
+                positions.push_back(decisionTable(after, self, roll, options));
+            }
+        }
+    }
+    background.start(positions, dice.next());
+}
+
+int runPonderBench(int argc, char** argv) {
+    int budget = 300, decisions = 15, share = 50;
+    double humanMs = 1000;
+    for (int i = 2; i < argc; i += 2) {
+        string option = argv[i];
+        if (i + 1 >= argc) {
+            cout << "Usage: " << argv[0] << " ponder-bench [--rollouts R] [--decisions N] [--human-ms MS] [--share PERCENT]\n"
+                 << "Seat 1 is a random player taking MS per choice, seat 2 a search bot with R rollouts.\n";
+            return 1;
+        }
+        string value = argv[i + 1];
+        if (option == "--rollouts") {
+            budget = stoi(value);
+        } else if (option == "--decisions") {
+            decisions = stoi(value);
+        } else if (option == "--human-ms") {
+            humanMs = stod(value);
+        } else if (option == "--share") {
+            share = stoi(value);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (budget < 1 || decisions < 1 || humanMs < 0 || share < 1 || share > 100) {
+        cout << "Rollouts and decisions must be at least 1, the share 1-100.\n";
+        return 1;
+    }
+
+    // Played roll by roll like the interactive game, so the bot ponders on every human roll
+    for (int pondering = 0; pondering < 2; pondering++) {
+        SearchPolicy bot(budget, 17);
+        bot.pondering = pondering;
+        bot.ponderer().sharePercent = share;
+        RandomPolicy human(23);
+        LatencyHistogram afterHuman, other;
+        Board board;
+        Dice dice(29);
+        vector<Player> players;
+        int seat = 0, chances = 0;
+        bool humanChose = false; // The bot's next choice follows a human one straight away
+        while (bot.decisions < decisions) {
+            if (players.empty()) {
+                players = {Player(0), Player(1)};
+                seat = chooseStartingPlayer(dice, 2);
+                chances = 0;
+            }
+            int diceRoll = dice.roll();
+            vector<int> moves = legalMoves(players[seat], diceRoll);
+            if (seat == 0) {
+                bot.ponder(players, 0, diceRoll, moves, 1);
+                if (moves.size() > 1) {
+                    this_thread::sleep_for(chrono::microseconds((long long) (humanMs * 1000)));
+                }
+                humanChose = moves.size() > 1 && diceRoll != 6;
+                if (!moves.empty()) {
+                    applyMove(players[0], human.chooseMove(players, 0, diceRoll, moves), diceRoll, board);
+                }
+            } else if (moves.size() > 1) {
+                auto started = Clock::now();
+                int move = bot.chooseMove(players, 1, diceRoll, moves);
+                (humanChose ? afterHuman : other).record(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - started).count());
+                humanChose = false;
+                applyMove(players[1], move, diceRoll, board);
+            } else if (!moves.empty()) {
+                applyMove(players[1], moves[0], diceRoll, board);
+            }
+            if (players[seat].allTokensInHome()) {
+                players.clear();
+            } else if (diceRoll == 6 && ++chances < MAX_CHANCES) {
+                continue;
+            } else {
+                chances = 0;
+                seat = 1 - seat;
+                humanChose = humanChose && seat == 1;
+            }
+        }
+        cout << fixed << setprecision(2) << (pondering ? "pondering:    " : "no pondering: ") << "bot answers after a human choice p50 "
+             << afterHuman.percentile(50) / 1e6 << " ms, p99 " << afterHuman.percentile(99) / 1e6 << " ms ("
+             << afterHuman.count() << "); other p50 " << other.percentile(50) / 1e6 << " ms; " << bot.reused << "/"
+             << bot.decisions << " choices prepared, " << bot.ponderer().rollouts() << " rollouts pondered\n";
+    }
+    return 0;
+}
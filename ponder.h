@@ -0,0 +1,79 @@
+#ifndef PONDER_H
+#define PONDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "rollout.h"
+
+// Speculative search while a human thinks. Once the human's roll is known, the bot that moves next
+// lists every position it could face: each legal human move, followed by each of its own six rolls
+// that leaves it a real choice. A background thread spreads rollouts over those positions until
+// each has the bot's full budget. When the bot's turn comes, the search for the position that
+// actually happened is taken over as it stands, so only the rollouts still missing are run.
+
+// Identifies a decision: every token, the seat to move and its roll
+uint64_t decisionKey(const vector<Player>& players, int seat, int diceRoll);
+
+class Ponderer {
+public:
+    int budget = 2000;      // Rollouts per predicted position; pondering stops once all have them
+    int sharePercent = 50;  // Most of one core the thread may use, by sleeping between slices
+
+    ~Ponderer();
+
+    // Replaces whatever was being pondered with positions (each waiting on a choice)
+    void start(const vector<Table>& positions, uint64_t seed);
+
+    // Stops pondering; true and the search so far if table is one of the predicted positions
+    bool take(const Table& table, RolloutSearch& search);
+
+    long long rollouts() const { return total.load(memory_order_relaxed); }
+
+private:
+    struct Root {
+        uint64_t key;
+        vector<int> moves;
+        RolloutSearch search;
+    };
+
+    mutex lock;
+    condition_variable wake;
+    vector<unique_ptr<Root>> roots;
+    bool stopping = false;
+    thread worker;
+    atomic<long long> total{0};
+
+    void run();
+};
+
+// Rollout search as a Policy: budget rollouts per choice, taking over what pondering prepared
+class SearchPolicy : public Policy {
+public:
+    bool pondering = true;
+    long long decisions = 0;
+    long long reused = 0;   // Choices found among the pondered positions
+
+    SearchPolicy(int budget, uint64_t seed);
+
+    int chooseMove(const vector<Player>& players, int playerIndex, int diceRoll, const vector<int>& moves) override;
+    void ponder(const vector<Player>& players, int mover, int diceRoll, const vector<int>& moves, int self) override;
+
+    Ponderer& ponderer() { return background; }
+
+private:
+    int budget;
+    Dice dice;
+    RolloutSearch search;
+    Ponderer background;
+    Table decision; // The choice being searched, kept so its storage is reused
+};
+
+// "ponder-bench" command: a search bot against a simulated human with think time, with and
+// without pondering, comparing how long the bot takes to answer once the human has moved
+int runPonderBench(int argc, char** argv);
+
+#endif
@@ -0,0 +1,137 @@
+#include "position.h"
+
+namespace {
+
+// Reads an unsigned decimal number of at most three digits
+bool parseNumber(string_view text, size_t& at, int& value) {
+    size_t start = at;
+    value = 0;
+    while (at < text.size() && at - start < 3 && text[at] >= '0' && text[at] <= '9') {
+        value = value * 10 + (text[at++] - '0');
+    }
+    return at > start;
+}
+
+size_t writeNumber(int value, char* out) {
+    char digits[4];
+    size_t count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    for (size_t i = 0; i < count; i++) {
+        out[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+}
+
+bool parsePosition(string_view text, Position& out) {
+    size_t at = 0;
+    out.numPlayers = 0;
+    while (true) {
+        if (out.numPlayers == 4) {
+            return false;
+        }
+        for (int t = 0; t < POSITION_TOKENS; t++) {
+            if (t > 0 && (at >= text.size() || text[at++] != ',')) {
+                return false;
+            }
+            if (at >= text.size()) {
+                return false;
+            }
+            int value;
+            if (text[at] == '-') {
+                value = -1;
+                at++;
+            } else if (text[at] == 'h') {
+                value = POSITION_HOME;
+                at++;
+            } else if (!parseNumber(text, at, value) || value >= BOARD_SIZE) {
+                return false;
+            }
+            out.progress[out.numPlayers][t] = value;
+        }
+        out.numPlayers++;
+        if (at < text.size() && text[at] == '/') {
+            at++;
+            continue;
+        }
+        break;
+    }
+
+    int seat, chances;
+    if (out.numPlayers < 2 || at >= text.size() || text[at++] != ' ' || !parseNumber(text, at, seat) ||
+        at >= text.size() || text[at++] != ' ' || !parseNumber(text, at, chances) || at != text.size()) {
+        return false;
+    }
+    if (seat < 1 || seat > out.numPlayers || chances >= MAX_CHANCES) {
+        return false;
+    }
+    out.seat = seat - 1;
+    out.chances = chances;
+    return true;
+}
+
+size_t serializePosition(const Position& position, char* buffer, size_t size) {
+    if (size < MAX_POSITION_TEXT) {
+        return 0;
+    }
+    size_t at = 0;
+    for (int i = 0; i < position.numPlayers; i++) {
+        if (i > 0) {
+            buffer[at++] = '/';
+        }
+        for (int t = 0; t < POSITION_TOKENS; t++) {
+            if (t > 0) {
+                buffer[at++] = ',';
+            }
+            int value = position.progress[i][t];
+            if (value < 0) {
+                buffer[at++] = '-';
+            } else if (value == POSITION_HOME) {
+                buffer[at++] = 'h';
+            } else {
+                at += writeNumber(value, buffer + at);
+            }
+        }
+    }
+    buffer[at++] = ' ';
+    at += writeNumber(position.seat + 1, buffer + at);
+    buffer[at++] = ' ';
+    at += writeNumber(position.chances, buffer + at);
+    buffer[at] = '\0';
+    return at;
+}
+
+Position positionFromPlayers(const vector<Player>& players, int seat, int chances) {
+    Position position;
+    position.numPlayers = players.size();
+    position.seat = seat;
+    position.chances = chances;
+    for (int i = 0; i < players.size(); i++) {
+        for (int t = 0; t < POSITION_TOKENS; t++) {
+            position.progress[i][t] = t < players[i].tokens.size() ? tokenProgress(players[i].tokens[t], i) : -1;
+        }
+    }
+    return position;
+}
+
+void playersFromPosition(const Position& position, vector<Player>& players) {
+    players.clear();
+    for (int i = 0; i < position.numPlayers; i++) {
+        players.push_back(Player(i, POSITION_TOKENS));
+        for (int t = 0; t < POSITION_TOKENS; t++) {
+            Token& token = players[i].tokens[t];
+            int value = position.progress[i][t];
+            if (value == POSITION_HOME) {
+                token.position = HOME_POSITION;
+                token.inPlay = true;
+            } else if (value >= 0) {
+                token.position = (START_POSITIONS[i] + value) % BOARD_SIZE;
+                token.inPlay = true;
+            }
+        }
+    }
+}
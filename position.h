@@ -0,0 +1,33 @@
+#ifndef POSITION_H
+#define POSITION_H
+
+#include <string_view>
+
+#include "ludo.h"
+
+// Text form of a position, e.g. "0,5,-,-/h,51,-,-/-,-,-,- 2 1":
+//   one field per seat separated by '/', each with 4 tokens separated by ','
+//   a token is '-' (not in play), 'h' (home) or its progress along the route, 0-51
+//   then the seat to move (1-based) and how many extra rolls that seat has already used this turn
+const int POSITION_TOKENS = 4;
+const int POSITION_HOME = BOARD_SIZE;
+const int MAX_POSITION_TEXT = 96; // Longest serialized position, including the terminating null
+
+// Fixed-size position, so parsing and serializing never allocate
+struct Position {
+    int numPlayers = 0;
+    int8_t progress[4][POSITION_TOKENS]; // -1 not in play, 0-51 along the route, POSITION_HOME at home
+    int seat = 0;
+    int chances = 0;
+};
+
+// Parses text into out; returns false (leaving out unspecified) on any syntax or range error
+bool parsePosition(string_view text, Position& out);
+
+// Writes the text form and a terminating null into buffer; returns its length, or 0 if size is too small
+size_t serializePosition(const Position& position, char* buffer, size_t size);
+
+Position positionFromPlayers(const vector<Player>& players, int seat, int chances);
+void playersFromPosition(const Position& position, vector<Player>& players);
+
+#endif
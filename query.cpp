@@ -0,0 +1,478 @@
+#include "query.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+namespace {
+
+const size_t DEFAULT_INDEX_MEMORY_MB = 256; // Posting lists held before a run is written out
+
+// Appends one value to a column file
+template <typename T>
+void put(ofstream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Index file layout: u32 key count, u64 start offsets (one per key plus the end), then the entries
+template <typename T>
+bool writePostings(const string& path, const vector<vector<T>>& lists) {
+    ofstream out(path, ios::binary);
+    uint32_t keyCount = lists.size();
+    out.write(reinterpret_cast<const char*>(&keyCount), sizeof(keyCount));
+    uint64_t start = 0;
+    for (const auto& list : lists) {
+        out.write(reinterpret_cast<const char*>(&start), sizeof(start));
+        start += list.size();
+    }
+    out.write(reinterpret_cast<const char*>(&start), sizeof(start));
+    for (const auto& list : lists) {
+        out.write(reinterpret_cast<const char*>(list.data()), list.size() * sizeof(T));
+    }
+    return out.good();
+}
+
+// Seat furthest behind on the board: sum of per-token progress, counting entered tokens as 1
+int trailingSeat(const int progress[INDEX_SEATS][4], int numPlayers) {
+    int best = 0;
+    int bestTotal = 0;
+    for (int seat = 0; seat < numPlayers; seat++) {
+        int total = 0;
+        for (int t = 0; t < 4; t++) {
+            total += progress[seat][t] + 1;
+        }
+        if (seat == 0 || total < bestTotal) {
+            best = seat;
+            bestTotal = total;
+        }
+    }
+    return best;
+}
+
+template <typename T>
+const T* columnData(const MappedFile& file) {
+    return reinterpret_cast<const T*>(file.data);
+}
+
+class PostingFile {
+public:
+    bool open(const string& path) {
+        if (!file.open(path) || file.size < sizeof(uint32_t)) {
+            return false;
+        }
+        memcpy(&keyCount, file.data, sizeof(keyCount));
+        return true;
+    }
+
+    template <typename T>
+    const T* entries(uint32_t key, uint64_t& count) const {
+        const uint8_t* offsets = file.data + sizeof(uint32_t);
+        uint64_t begin, end;
+        memcpy(&begin, offsets + key * sizeof(uint64_t), sizeof(begin));
+        memcpy(&end, offsets + (key + 1) * sizeof(uint64_t), sizeof(end));
+        count = end - begin;
+        const uint8_t* base = offsets + (keyCount + 1) * sizeof(uint64_t);
+        return reinterpret_cast<const T*>(base + begin * sizeof(T));
+    }
+
+    uint32_t keyCount = 0;
+
+private:
+    MappedFile file;
+};
+
+// Posting lists of one index file, built in memory up to a budget and then written out as a run:
+// every key's list in key order, in the index file layout. Runs hold consecutive games, so the
+// merged list of a key is its lists from each run in turn.
+template <typename T>
+struct PostingRuns {
+    string path;             // The index file; runs are written next to it as path.0, path.1, ...
+    vector<vector<T>> lists; // The run being built, by key
+    size_t entries = 0;      // In the run being built
+    int runs = 0;
+
+    PostingRuns(const string& path, size_t keyCount) : path(path), lists(keyCount) {}
+
+    size_t bytes() const { return entries * sizeof(T); }
+
+    bool spill() {
+        bool ok = writePostings(runPath(runs++), lists);
+        for (auto& list : lists) {
+            vector<T>().swap(list);
+        }
+        entries = 0;
+        return ok;
+    }
+
+    // Writes the index file: straight from memory if nothing was spilled, else by merging the runs
+    bool finish() {
+        if (runs == 0) {
+            return writePostings(path, lists);
+        }
+        if (entries > 0 && !spill()) {
+            return false;
+        }
+        bool ok = merge();
+        for (int r = 0; r < runs; r++) {
+            filesystem::remove(runPath(r));
+        }
+        return ok;
+    }
+
+private:
+    string runPath(int run) const { return path + "." + to_string(run); }
+
+    bool merge() {
+        vector<unique_ptr<PostingFile>> inputs;
+        for (int r = 0; r < runs; r++) {
+            inputs.push_back(unique_ptr<PostingFile>(new PostingFile()));
+            if (!inputs.back()->open(runPath(r))) {
+                return false;
+            }
+        }
+        ofstream out(path, ios::binary);
+        uint32_t keyCount = lists.size();
+        out.write(reinterpret_cast<const char*>(&keyCount), sizeof(keyCount));
+        uint64_t start = 0, count;
+        for (uint32_t key = 0; key <= keyCount; key++) {
+            out.write(reinterpret_cast<const char*>(&start), sizeof(start));
+            for (int r = 0; key < keyCount && r < runs; r++) {
+                inputs[r]->entries<T>(key, count);
+                start += count;
+            }
+        }
+        for (uint32_t key = 0; key < keyCount; key++) {
+            for (int r = 0; r < runs; r++) {
+                const T* list = inputs[r]->entries<T>(key, count);
+                out.write(reinterpret_cast<const char*>(list), count * sizeof(T));
+            }
+        }
+        return out.good();
+    }
+};
+
+struct EventFilter {
+    int type = -1;
+    int seat = -1;
+    int square = -1;
+    int afterTurn = -1;   // Event turn must be > afterTurn
+    int beforeTurn = -1;  // Event turn must be < beforeTurn, when set
+
+    bool active() const {
+        return type >= 0 || seat >= 0 || square >= 0 || afterTurn >= 0 || beforeTurn >= 0;
+    }
+
+    bool turnInRange(int turn) const {
+        return turn > afterTurn && (beforeTurn < 0 || turn < beforeTurn);
+    }
+
+    bool matches(const GameEvent& event) const {
+        return (type < 0 || event.type == type) && (seat < 0 || event.seat == seat) &&
+               (square < 0 || event.to == square) && turnInRange(event.turn);
+    }
+};
+
+void setBit(vector<uint64_t>& bits, uint32_t i) {
+    bits[i >> 6] |= 1ULL << (i & 63);
+}
+
+bool testBit(const vector<uint64_t>& bits, uint32_t i) {
+    return (bits[i >> 6] >> (i & 63)) & 1;
+}
+
+// Index of the lowest set bit of a nonzero word
+int lowestBit(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bits);
+#else
+    int index = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+}
+
+int runIndexer(int argc, char** argv) {
+    size_t memoryMb = DEFAULT_INDEX_MEMORY_MB;
+    for (int i = 4; i < argc; i += 2) {
+        string option = argv[i];
+        if (option == "--memory-mb" && i + 1 < argc) {
+            memoryMb = stoull(argv[i + 1]);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (argc < 4 || memoryMb < 1) {
+        cout << "Usage: " << argv[0] << " index <archive> <index-dir> [--memory-mb M]\n"
+             << "Posting lists past M MiB (default " << DEFAULT_INDEX_MEMORY_MB
+             << ") are written out as sorted runs and merged at the end.\n";
+        return 1;
+    }
+    string archivePath = argv[2];
+    string dir = argv[3];
+
+    ArchiveReader reader;
+    if (!reader.open(archivePath)) {
+        cout << "Could not read archive " << archivePath << "\n";
+        return 1;
+    }
+    filesystem::create_directories(dir);
+
+    // Columns are appended a game at a time; only the posting lists are held, up to the budget
+    ofstream offsets(dir + "/offset.u64", ios::binary), seeds(dir + "/seed.u64", ios::binary),
+        turns(dir + "/turns.u32", ios::binary), players(dir + "/players.u8", ios::binary),
+        starts(dir + "/start.u8", ios::binary), winners(dir + "/winner.i8", ios::binary),
+        leaders(dir + "/leader.u8", ios::binary), midLast(dir + "/midlast.u8", ios::binary);
+    PostingRuns<SquarePosting> squareLists(dir + "/squares.idx", EVENT_TYPE_COUNT * INDEX_SEATS * BOARD_SIZE);
+    PostingRuns<uint32_t> bucketLists(dir + "/buckets.idx", EVENT_TYPE_COUNT * INDEX_SEATS * TURN_BUCKETS);
+    size_t budget = memoryMb * 1024 * 1024;
+    bool ok = true;
+
+    GameHeader header;
+    const GameEvent* events;
+    uint64_t offset = reader.offset();
+    uint32_t game = 0;
+    for (; reader.next(header, events); game++) {
+        put(offsets, offset);
+        offset = reader.offset();
+        put(seeds, header.seed);
+        put(turns, (uint32_t) header.turns);
+        put(players, header.numPlayers);
+        put(starts, header.startingPlayer);
+        put(winners, header.winner);
+
+        int progress[INDEX_SEATS][4];
+        memset(progress, -1, sizeof(progress));
+        int midTurn = header.turns / 2;
+        int lastAtMid = -1;
+        for (uint32_t e = 0; e < header.eventCount; e++) {
+            const GameEvent& event = events[e];
+            if (lastAtMid < 0 && event.turn >= midTurn) {
+                lastAtMid = trailingSeat(progress, header.numPlayers);
+            }
+            if (event.seat < INDEX_SEATS && event.token >= 0 && event.token < 4 && event.to >= 0) {
+                progress[event.seat][event.token] = (event.to - START_POSITIONS[event.seat] + BOARD_SIZE) % BOARD_SIZE;
+            }
+            if (event.type >= EVENT_TYPE_COUNT || event.seat >= INDEX_SEATS || event.to < 0 || event.to >= BOARD_SIZE) {
+                continue;
+            }
+
+            vector<SquarePosting>& squares = squareLists.lists[squareKey(event.type, event.seat, event.to)];
+            if (!squares.empty() && squares.back().game == game) {
+                squares.back().lastTurn = event.turn;
+            } else {
+                squares.push_back({game, event.turn, event.turn});
+                squareLists.entries++;
+            }
+            vector<uint32_t>& buckets = bucketLists.lists[bucketKey(event.type, event.seat, event.turn / TURN_BUCKET_SIZE)];
+            if (buckets.empty() || buckets.back() != game) {
+                buckets.push_back(game);
+                bucketLists.entries++;
+            }
+        }
+        if (lastAtMid < 0) {
+            lastAtMid = trailingSeat(progress, header.numPlayers);
+        }
+        put(midLast, (uint8_t) lastAtMid);
+        put(leaders, header.leader);
+
+        // Between games, so each game's postings stay within one run
+        if (squareLists.bytes() + bucketLists.bytes() > budget) {
+            ok = squareLists.spill() && bucketLists.spill() && ok;
+        }
+    }
+
+    ok = squareLists.finish() && bucketLists.finish() && ok;
+    for (ofstream* column : {&offsets, &seeds, &turns, &players, &starts, &winners, &leaders, &midLast}) {
+        column->close();
+        ok = ok && !column->fail();
+    }
+    ofstream(dir + "/archive.path") << filesystem::absolute(archivePath).string() << "\n";
+    if (!ok) {
+        cout << "Failed writing index to " << dir << "\n";
+        return 1;
+    }
+    cout << "Indexed " << game << " games into " << dir;
+    if (squareLists.runs > 0) {
+        cout << " (postings merged from " << squareLists.runs << " runs)";
+    }
+    cout << "\n";
+    return 0;
+}
+
+int runQuery(int argc, char** argv) {
+    if (argc < 3) {
+        cout << "Usage: " << argv[0] << " query <index-dir> [--event enter|move] [--seat S] [--square Q]\n"
+             << "       [--after-turn T] [--before-turn T] [--players N] [--winner S] [--leader S]\n"
+             << "       [--from-last] [--min-turns N] [--list N]\n";
+        return 1;
+    }
+    string dir = argv[2];
+    EventFilter filter;
+    int numPlayers = -1, winner = -2, leader = -1, minTurns = -1, listCount = 10;
+    bool fromLast = false;
+    for (int i = 3; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--from-last") {
+            fromLast = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cout << "Missing value for " << option << "\n";
+            return 1;
+        }
+        string value = argv[++i];
+        if (option == "--event") {
+            filter.type = parseEventType(value);
+            if (filter.type < 0) {
+                cout << "Unknown event type " << value << "\n";
+                return 1;
+            }
+        } else if (option == "--seat") {
+            filter.seat = stoi(value) - 1;
+        } else if (option == "--square") {
+            filter.square = stoi(value);
+        } else if (option == "--after-turn") {
+            filter.afterTurn = stoi(value);
+        } else if (option == "--before-turn") {
+            filter.beforeTurn = stoi(value);
+        } else if (option == "--players") {
+            numPlayers = stoi(value);
+        } else if (option == "--winner") {
+            winner = stoi(value) - 1;
+        } else if (option == "--leader") {
+            leader = stoi(value) - 1;
+        } else if (option == "--min-turns") {
+            minTurns = stoi(value);
+        } else if (option == "--list") {
+            listCount = stoi(value);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (filter.seat >= INDEX_SEATS || filter.square >= BOARD_SIZE) {
+        cout << "Seats are 1-" << INDEX_SEATS << " and squares 0-" << BOARD_SIZE - 1 << ".\n";
+        return 1;
+    }
+
+    auto started = chrono::steady_clock::now();
+    MappedFile offsetFile, seedFile, turnsFile, playersFile, winnerFile, leaderFile, midLastFile;
+    if (!offsetFile.open(dir + "/offset.u64") || !seedFile.open(dir + "/seed.u64") ||
+        !turnsFile.open(dir + "/turns.u32") || !playersFile.open(dir + "/players.u8") ||
+        !winnerFile.open(dir + "/winner.i8") || !leaderFile.open(dir + "/leader.u8") ||
+        !midLastFile.open(dir + "/midlast.u8")) {
+        cout << "Could not read index " << dir << "\n";
+        return 1;
+    }
+    uint32_t gameCount = offsetFile.size / sizeof(uint64_t);
+    const uint64_t* offsets = columnData<uint64_t>(offsetFile);
+    const uint64_t* seeds = columnData<uint64_t>(seedFile);
+    const uint32_t* turns = columnData<uint32_t>(turnsFile);
+    const uint8_t* players = columnData<uint8_t>(playersFile);
+    const int8_t* winners = columnData<int8_t>(winnerFile);
+    const uint8_t* leaders = columnData<uint8_t>(leaderFile);
+    const uint8_t* midLast = columnData<uint8_t>(midLastFile);
+
+    // Candidates from the inverted indexes; "maybe" games straddle a turn bound and are checked in the archive
+    vector<uint64_t> matched((gameCount + 63) / 64, filter.active() ? 0 : ~0ULL);
+    vector<uint64_t> maybe;
+    if (filter.active()) {
+        maybe.assign(matched.size(), 0);
+        int typeBegin = filter.type >= 0 ? filter.type : 0, typeEnd = filter.type >= 0 ? filter.type + 1 : EVENT_TYPE_COUNT;
+        int seatBegin = filter.seat >= 0 ? filter.seat : 0, seatEnd = filter.seat >= 0 ? filter.seat + 1 : INDEX_SEATS;
+        PostingFile index;
+        if (!index.open(dir + (filter.square >= 0 ? "/squares.idx" : "/buckets.idx"))) {
+            cout << "Could not read index " << dir << "\n";
+            return 1;
+        }
+        for (int type = typeBegin; type < typeEnd; type++) {
+            for (int seat = seatBegin; seat < seatEnd; seat++) {
+                uint64_t count;
+                if (filter.square >= 0) {
+                    const SquarePosting* postings = index.entries<SquarePosting>(squareKey(type, seat, filter.square), count);
+                    for (uint64_t p = 0; p < count; p++) {
+                        const SquarePosting& posting = postings[p];
+                        if (filter.turnInRange(posting.firstTurn) || filter.turnInRange(posting.lastTurn)) {
+                            setBit(matched, posting.game);
+                        } else if (posting.lastTurn > filter.afterTurn && filter.beforeTurn >= 0 &&
+                                   posting.firstTurn < filter.beforeTurn) {
+                            setBit(maybe, posting.game);
+                        }
+                    }
+                    continue;
+                }
+                int lowTurn = filter.afterTurn + 1;
+                int highTurn = filter.beforeTurn >= 0 ? filter.beforeTurn - 1 : 65535;
+                for (int bucket = lowTurn / TURN_BUCKET_SIZE; bucket <= highTurn / TURN_BUCKET_SIZE && bucket < TURN_BUCKETS; bucket++) {
+                    bool whole = bucket * TURN_BUCKET_SIZE >= lowTurn && (bucket + 1) * TURN_BUCKET_SIZE - 1 <= highTurn;
+                    const uint32_t* games = index.entries<uint32_t>(bucketKey(type, seat, bucket), count);
+                    for (uint64_t g = 0; g < count; g++) {
+                        setBit(whole ? matched : maybe, games[g]);
+                    }
+                }
+            }
+        }
+
+        ArchiveReader archive;
+        string archivePath;
+        ifstream(dir + "/archive.path") >> archivePath;
+        bool haveArchive = archive.open(archivePath);
+        for (uint32_t game = 0; game < gameCount; game++) {
+            if (!testBit(maybe, game) || testBit(matched, game)) {
+                continue;
+            }
+            GameHeader header;
+            const GameEvent* events;
+            if (!haveArchive || !archive.readAt(offsets[game], header, events)) {
+                cout << "Archive " << archivePath << " is needed to resolve turn bounds.\n";
+                return 1;
+            }
+            for (uint32_t e = 0; e < header.eventCount; e++) {
+                if (filter.matches(events[e])) {
+                    setBit(matched, game);
+                    break;
+                }
+            }
+        }
+    }
+
+    uint64_t total = 0;
+    vector<uint32_t> listed;
+    for (uint32_t word = 0; word < matched.size(); word++) {
+        uint64_t bits = matched[word];
+        while (bits) {
+            uint32_t game = word * 64 + lowestBit(bits);
+            bits &= bits - 1;
+            if (game >= gameCount) {
+                break;
+            }
+            if ((numPlayers >= 0 && players[game] != numPlayers) || (winner >= -1 && winners[game] != winner) ||
+                (leader >= 0 && leaders[game] != leader) || (fromLast && leaders[game] != midLast[game]) ||
+                (minTurns >= 0 && turns[game] < minTurns)) {
+                continue;
+            }
+            total++;
+            if (listed.size() < listCount) {
+                listed.push_back(game);
+            }
+        }
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+    for (uint32_t game : listed) {
+        cout << "game " << game << " seed " << seeds[game] << " players " << (int) players[game]
+             << " turns " << turns[game] << " winner "
+             << (winners[game] < 0 ? string("none") : to_string(winners[game] + 1))
+             << " leader " << leaders[game] + 1 << "\n";
+    }
+    cout << total << " of " << gameCount << " games match (" << elapsed * 1000 << " ms)\n";
+    return 0;
+}
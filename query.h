@@ -0,0 +1,35 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "ludo.h"
+#include "archive.h"
+
+const int TURN_BUCKET_SIZE = 16;
+const int TURN_BUCKETS = 65536 / TURN_BUCKET_SIZE;
+const int INDEX_SEATS = 4;
+
+#pragma pack(push, 1)
+// Games where one (event type, seat, square) occurred, with the first and last turn it happened on
+struct SquarePosting {
+    uint32_t game;
+    uint16_t firstTurn;
+    uint16_t lastTurn;
+};
+#pragma pack(pop)
+
+inline int squareKey(int type, int seat, int square) {
+    return (type * INDEX_SEATS + seat) * BOARD_SIZE + square;
+}
+
+inline int bucketKey(int type, int seat, int bucket) {
+    return (type * INDEX_SEATS + seat) * TURN_BUCKETS + bucket;
+}
+
+// "index" command: builds per-game columns and inverted indexes for an archive into a directory,
+// holding at most --memory-mb of posting lists and merging sorted runs past that
+int runIndexer(int argc, char** argv);
+
+// "query" command: answers event and outcome filters from an index directory
+int runQuery(int argc, char** argv);
+
+#endif
@@ -0,0 +1,254 @@
+#include "replay.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#include "network.h"
+
+ReplayBuffer::ReplayBuffer(size_t capacity) : slots(capacity), stamps(new atomic<uint64_t>[capacity]()), written(0) {
+    storage.features.resize(slots * FEATURE_WIDTH);
+    storage.seat.resize(slots);
+    storage.dice.resize(slots);
+    storage.mask.resize(slots);
+    storage.action.resize(slots);
+    storage.outcome.resize(slots);
+    storage.seed.resize(slots);
+}
+
+void ReplayBuffer::add(const TrainingChunk& game) {
+    uint64_t first = written.fetch_add(game.rows());
+    for (uint32_t r = 0; r < game.rows(); r++) {
+        uint64_t row = first + r;
+        size_t slot = row % slots;
+        // Claim the slot from whichever older row holds it; a writer lapped by a newer row drops its own
+        uint64_t stamp = stamps[slot].load(memory_order_acquire);
+        bool lapped = false;
+        while (true) {
+            if ((stamp & ~STAMP_WRITING) > row + 1) {
+                lapped = true;
+                break;
+            }
+            if (stamp & STAMP_WRITING) {
+                this_thread::yield();
+                stamp = stamps[slot].load(memory_order_acquire);
+            } else if (stamps[slot].compare_exchange_weak(stamp, STAMP_WRITING | (row + 1), memory_order_acquire)) {
+                break;
+            }
+        }
+        if (lapped) {
+            continue;
+        }
+        atomic_thread_fence(memory_order_release);
+        memcpy(&storage.features[slot * FEATURE_WIDTH], &game.features[(size_t) r * FEATURE_WIDTH], FEATURE_WIDTH);
+        storage.seat[slot] = game.seat[r];
+        storage.dice[slot] = game.dice[r];
+        storage.mask[slot] = game.mask[r];
+        storage.action[slot] = game.action[r];
+        storage.outcome[slot] = game.outcome[r];
+        storage.seed[slot] = game.seed[r];
+        stamps[slot].store(row + 1, memory_order_release);
+    }
+}
+
+void ReplayBuffer::snapshot(TrainingChunk& out) const {
+    out.clear();
+    size_t filled = min<uint64_t>(written.load(), slots);
+    for (size_t slot = 0; slot < filled; slot++) {
+        uint64_t before = stamps[slot].load(memory_order_acquire);
+        if (before == 0 || (before & STAMP_WRITING)) {
+            continue;
+        }
+        size_t row = out.rows();
+        out.features.resize((row + 1) * FEATURE_WIDTH);
+        memcpy(&out.features[row * FEATURE_WIDTH], &storage.features[slot * FEATURE_WIDTH], FEATURE_WIDTH);
+        out.seat.push_back(storage.seat[slot]);
+        out.dice.push_back(storage.dice[slot]);
+        out.mask.push_back(storage.mask[slot]);
+        out.action.push_back(storage.action[slot]);
+        out.outcome.push_back(storage.outcome[slot]);
+        out.seed.push_back(storage.seed[slot]);
+        atomic_thread_fence(memory_order_acquire);
+        if (stamps[slot].load(memory_order_relaxed) != before) {
+            // Overwritten while copying: drop the row
+            out.features.resize(row * FEATURE_WIDTH);
+            out.seat.pop_back();
+            out.dice.pop_back();
+            out.mask.pop_back();
+            out.action.pop_back();
+            out.outcome.pop_back();
+            out.seed.pop_back();
+        }
+    }
+}
+
+size_t ReplayBuffer::memoryBytes() const {
+    return slots * (FEATURE_WIDTH + 5 + sizeof(uint64_t) + sizeof(atomic<uint64_t>));
+}
+
+int runSelfPlayLoop(int argc, char** argv) {
+    if (argc < 3) {
+        cout << "Usage: " << argv[0] << " selfplay-loop <weights> [--threads K] [--buffer-rows N] [--snapshot FILE]\n"
+             << "       [--snapshot-every SEC] [--status-every SEC] [--duration SEC] [--players N]\n"
+             << "       [--max-turns T] [--games-per-thread G] [--seed S]\n";
+        return 1;
+    }
+    string weightsPath = argv[2];
+    int threadCount = max(1u, thread::hardware_concurrency());
+    size_t bufferRows = 100000;
+    string snapshotPath;
+    double snapshotEvery = 60, statusEvery = 10, duration = 0;
+    int numPlayers = 4;
+    int maxTurns = DEFAULT_MAX_TURNS;
+    int gamesPerThread = 16; // Games each thread plays at once: passes of ~50 positions, features kept in cache
+    uint64_t seed = 1;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        if (option == "--threads") {
+            threadCount = stoi(argv[i + 1]);
+        } else if (option == "--buffer-rows") {
+            bufferRows = stoull(argv[i + 1]);
+        } else if (option == "--snapshot") {
+            snapshotPath = argv[i + 1];
+        } else if (option == "--snapshot-every") {
+            snapshotEvery = stod(argv[i + 1]);
+        } else if (option == "--status-every") {
+            statusEvery = stod(argv[i + 1]);
+        } else if (option == "--duration") {
+            duration = stod(argv[i + 1]);
+        } else if (option == "--players") {
+            numPlayers = stoi(argv[i + 1]);
+        } else if (option == "--max-turns") {
+            maxTurns = stoi(argv[i + 1]);
+        } else if (option == "--games-per-thread") {
+            gamesPerThread = stoi(argv[i + 1]);
+        } else if (option == "--seed") {
+            seed = stoull(argv[i + 1]);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (numPlayers < 2 || numPlayers > 4 || maxTurns < 1 || maxTurns > 65535 || threadCount < 1 || bufferRows < 1 ||
+        gamesPerThread < 1) {
+        cout << "Players must be 2-4, the turn limit 1-65535, threads, buffer rows and games per thread at least 1.\n";
+        return 1;
+    }
+
+    shared_ptr<const Network> current;
+    {
+        shared_ptr<Network> network(new Network());
+        if (!network->load(weightsPath)) {
+            cout << "Could not load network " << weightsPath << "\n";
+            return 1;
+        }
+        current = network;
+    }
+    auto weightsTime = filesystem::last_write_time(weightsPath);
+    int weightsVersion = 1;
+
+    ReplayBuffer buffer(bufferRows);
+    atomic<bool> stop(false);
+    atomic<long long> nextGame(0), gamesPlayed(0);
+    vector<thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.push_back(thread([&]() {
+            // Games are played side by side, so every decision they wait on goes through the network
+            // in one forward pass; each game keeps its own rows until it ends
+            vector<Table> tables(gamesPerThread);
+            vector<TrainingChunk> chunks(gamesPerThread);
+            vector<uint64_t> seeds(gamesPerThread);
+            vector<int> choices;
+            shared_ptr<const Network> network;
+            unique_ptr<NeuralBatch> batch;
+            auto deal = [&](int i) {
+                seeds[i] = gameSeed(seed, nextGame++);
+                tables[i].start(numPlayers, seeds[i], maxTurns);
+            };
+            for (int i = 0; i < gamesPerThread; i++) {
+                deal(i);
+            }
+            while (!stop) {
+                shared_ptr<const Network> latest = atomic_load(&current); // Swapped weights play from the next pass
+                if (latest != network) {
+                    network = latest;
+                    batch.reset(new NeuralBatch(*network));
+                }
+                batch->chooseAll(tables, choices);
+                for (int i = 0; i < gamesPerThread; i++) {
+                    Table& table = tables[i];
+                    if (table.state == Table::TABLE_WAITING) {
+                        chunks[i].addRow(table.players, table.seat, table.diceRoll, table.moves, choices[i], seeds[i]);
+                        table.play(choices[i]);
+                    }
+                    if (table.state == Table::TABLE_FINISHED) {
+                        chunks[i].setOutcomes(0, table.leader());
+                        buffer.add(chunks[i]);
+                        chunks[i].clear();
+                        gamesPlayed++;
+                        deal(i);
+                    }
+                }
+            }
+        }));
+    }
+
+    auto started = chrono::steady_clock::now();
+    auto lastStatus = started, lastSnapshot = started;
+    long long gamesAtLastStatus = 0;
+    cout << "Self-play on " << threadCount << " threads, replay buffer " << buffer.capacity() << " rows ("
+         << buffer.memoryBytes() / (1024.0 * 1024.0) << " MiB)\n";
+    while (true) {
+        this_thread::sleep_for(chrono::milliseconds(100));
+        auto now = chrono::steady_clock::now();
+        double elapsed = chrono::duration<double>(now - started).count();
+        bool finished = duration > 0 && elapsed >= duration;
+
+        error_code error;
+        auto modified = filesystem::last_write_time(weightsPath, error);
+        if (!error && modified != weightsTime) {
+            shared_ptr<Network> network(new Network());
+            if (network->load(weightsPath)) {
+                atomic_store(&current, shared_ptr<const Network>(network));
+                weightsTime = modified;
+                weightsVersion++;
+                cout << "Swapped in weights version " << weightsVersion << "\n";
+            }
+            // A half-written file fails to load and is retried on the next poll
+        }
+
+        if (finished || chrono::duration<double>(now - lastStatus).count() >= statusEvery) {
+            long long games = gamesPlayed.load();
+            double interval = chrono::duration<double>(now - lastStatus).count();
+            cout << "games " << games << ", " << (long long) ((games - gamesAtLastStatus) / interval * 3600)
+                 << " games/hour (average " << (long long) (games / elapsed * 3600) << "), rows "
+                 << buffer.rowsWritten() << ", buffer " << min<uint64_t>(buffer.rowsWritten(), buffer.capacity())
+                 << "/" << buffer.capacity() << " rows, " << buffer.memoryBytes() / (1024.0 * 1024.0)
+                 << " MiB, weights v" << weightsVersion << "\n";
+            lastStatus = now;
+            gamesAtLastStatus = games;
+        }
+
+        if (!snapshotPath.empty() && (finished || chrono::duration<double>(now - lastSnapshot).count() >= snapshotEvery)) {
+            TrainingChunk rows;
+            buffer.snapshot(rows);
+            string partial = snapshotPath + ".tmp";
+            if (writeTrainingFile(partial, rows)) {
+                filesystem::rename(partial, snapshotPath, error);
+            }
+            lastSnapshot = now;
+        }
+
+        if (finished) {
+            break;
+        }
+    }
+
+    stop = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <atomic>
+#include <memory>
+
+#include "training.h"
+
+// Fixed-capacity ring of decision rows fed by many self-play threads. Writers reserve their
+// rows with one atomic add, then claim each slot by swapping in its stamp: a writer waits for
+// an older row still being written there, and drops its row if a newer one has the slot
+// already. Snapshots skip rows being written or overwritten while copied.
+class ReplayBuffer {
+public:
+    explicit ReplayBuffer(size_t capacity);
+
+    // Copies one finished game's rows (outcomes already set) into the ring
+    void add(const TrainingChunk& game);
+
+    // Copies every complete row currently held into out
+    void snapshot(TrainingChunk& out) const;
+
+    size_t capacity() const { return slots; }
+    uint64_t rowsWritten() const { return written.load(); }
+    size_t memoryBytes() const;
+
+private:
+    size_t slots;
+    TrainingChunk storage;
+    static const uint64_t STAMP_WRITING = 1ULL << 63;
+
+    unique_ptr<atomic<uint64_t>[]> stamps; // Row number + 1 of the slot's row (0 if none), STAMP_WRITING while written
+    atomic<uint64_t> written;
+};
+
+// "selfplay-loop" command: network bots play each other on every core, many games per thread
+// with their decisions batched through the network, trajectories go to a replay buffer, and the
+// weights file is reloaded whenever it changes
+int runSelfPlayLoop(int argc, char** argv);
+
+#endif
@@ -0,0 +1,73 @@
+#include "rollout.h"
+
+#include <cmath>
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+long long nanosSince(TimePoint start, TimePoint end) {
+    return chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+}
+
+}
+
+void RolloutSearch::reset(const Table& table, uint64_t seed) {
+    root = table;
+    root.events = nullptr; // The copy must never touch the actor's event list or history
+    root.timeline = nullptr;
+    mover = table.seat;
+    wins.assign(table.moves.size(), 0);
+    visits.assign(table.moves.size(), 0);
+    total = 0;
+    rolloutNanos = 0;
+    dice = Dice(seed);
+}
+
+int RolloutSearch::run(int count, TimePoint until) {
+    for (int n = 0; n < count; n++) {
+        TimePoint started = Clock::now();
+        if (started + chrono::nanoseconds(rolloutNanos) >= until) {
+            return n;
+        }
+        // UCB1 over the root moves; an untried move scores infinitely high, so each goes once first
+        int pick = 0;
+        double bestScore = -1;
+        for (int i = 0; i < visits.size(); i++) {
+            double score = visits[i] == 0 ? HUGE_VAL
+                                          : wins[i] / (double) visits[i] + 1.4 * sqrt(log((double) total) / visits[i]);
+            if (score > bestScore) {
+                pick = i;
+                bestScore = score;
+            }
+        }
+
+        // The table's own dice stream is the real future, so every rollout draws a fresh one
+        scratch = root;
+        scratch.dice = Dice(dice.next());
+        scratch.maxTurns = min(root.maxTurns, root.turn + ROLLOUT_TURNS);
+        scratch.play(root.moves[pick]);
+        while (scratch.state == Table::TABLE_WAITING) {
+            scratch.play(policy.chooseMove(scratch.players, scratch.seat, scratch.diceRoll, scratch.moves));
+        }
+        wins[pick] += scratch.leader() == mover;
+        visits[pick]++;
+        total++;
+        long long nanos = nanosSince(started, Clock::now());
+        rolloutNanos = total == 1 ? nanos : (rolloutNanos * 7 + nanos) / 8;
+    }
+    return count;
+}
+
+int RolloutSearch::best() {
+    if (total == 0) {
+        return policy.chooseMove(root.players, root.seat, root.diceRoll, root.moves);
+    }
+    int pick = 0;
+    for (int i = 1; i < visits.size(); i++) {
+        if (visits[i] > visits[pick] || (visits[i] == visits[pick] && wins[i] > wins[pick])) {
+            pick = i;
+        }
+    }
+    return root.moves[pick];
+}
@@ -0,0 +1,38 @@
+#ifndef ROLLOUT_H
+#define ROLLOUT_H
+
+#include <chrono>
+
+#include "heuristic.h"
+#include "table.h"
+
+typedef chrono::steady_clock::time_point TimePoint;
+
+// Anytime Monte Carlo search over one pending choice: playouts with the heuristic policy, cut off
+// ROLLOUT_TURNS turns ahead and scored by who leads, spread over the root moves by UCB1.
+// Work can stop after any rollout, and best() is always a legal answer.
+class RolloutSearch {
+public:
+    static const int ROLLOUT_TURNS = 30;
+
+    void reset(const Table& table, uint64_t seed);
+
+    // Runs up to count more rollouts, stopping early rather than running past until; returns how many ran
+    int run(int count, TimePoint until);
+
+    int best();
+    int rollouts() const { return total; }
+
+private:
+    Table root;
+    Table scratch;  // Reused by every rollout, so copies keep their capacity
+    int mover = 0;
+    vector<int> wins;
+    vector<int> visits;
+    int total = 0;
+    long long rolloutNanos = 0; // Running average, to stop before a rollout would overrun
+    Dice dice;
+    HeuristicPolicy policy{HeuristicWeights()};
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include "selfplay.h"
+#include "trace.h"
+
+#include <string>
+#include <memory>
+
+int chooseStartingPlayer(Dice& dice, int numPlayers) {
+    int highestRoll = 0;
+    int startingPlayer = 0;
+    for (int i = 0; i < numPlayers; i++) {
+        int diceRoll = dice.roll();
+        if (diceRoll == 6) {
+            return i;
+        }
+        if (diceRoll > highestRoll) {
+            highestRoll = diceRoll;
+            startingPlayer = i;
+        }
+    }
+    return startingPlayer;
+}
+
+void playHeadlessTurn(vector<Player>& players, int playerIndex, const Board& board, Dice& dice,
+                      Policy& policy, uint16_t turn, vector<GameEvent>* events) {
+    Player& player = players[playerIndex];
+    static thread_local vector<int> moves; // Policies never play headless turns themselves, so one list per thread
+    TraceSpan turnSpan("turn");
+    turnSpan.arg = playerIndex;
+    for (int chances = 0; chances < MAX_CHANCES; chances++) {
+        TraceSpan rollSpan("roll");
+        int diceRoll = dice.roll();
+        rollSpan.arg = diceRoll;
+        legalMoves(player, diceRoll, moves);
+        if (!moves.empty()) {
+            int move = moves.size() == 1 ? moves[0] : policy.chooseMove(players, playerIndex, diceRoll, moves);
+            int tokenIndex = move;
+            if (move == ENTER_TOKEN) {
+                for (int i = 0; i < player.tokens.size(); i++) {
+                    if (!player.tokens[i].inPlay) {
+                        tokenIndex = i;
+                        break;
+                    }
+                }
+            }
+            int from = player.tokens[tokenIndex].position;
+            applyMove(player, move, diceRoll, board);
+            if (events) {
+                GameEvent event;
+                event.turn = turn;
+                event.seat = playerIndex;
+                event.type = move == ENTER_TOKEN ? EVENT_ENTER : EVENT_MOVE;
+                event.token = tokenIndex;
+                event.dice = diceRoll;
+                event.from = from;
+                event.to = player.tokens[tokenIndex].position;
+                events->push_back(event);
+            }
+        }
+        if (diceRoll != 6 || chances + 1 == MAX_CHANCES) {
+            METRIC_TURN(chances + 1);
+            break;
+        }
+    }
+}
+
+GameRecord playHeadlessGame(int numPlayers, uint64_t seed, int maxTurns, const vector<Policy*>& policies) {
+    TraceGame traced(traceSample());
+    TraceSpan span("game");
+    GameRecord record;
+    record.header = GameHeader();
+    record.header.seed = seed;
+    record.header.numPlayers = numPlayers;
+    record.header.winner = -1;
+    record.events.reserve((size_t) maxTurns * MAX_CHANCES); // At most one event per roll: never grows mid-game
+
+    Dice dice(seed);
+    Board board;
+    vector<Player> players;
+    players.reserve(numPlayers);
+    for (int i = 0; i < numPlayers; i++) {
+        players.push_back(Player(i));
+    }
+
+    int currentPlayerIndex = chooseStartingPlayer(dice, numPlayers);
+    record.header.startingPlayer = currentPlayerIndex;
+
+    int turn = 0;
+    while (turn < maxTurns) {
+        playHeadlessTurn(players, currentPlayerIndex, board, dice, *policies[currentPlayerIndex], turn, &record.events);
+        turn++;
+        if (players[currentPlayerIndex].allTokensInHome()) {
+            record.header.winner = currentPlayerIndex;
+            break;
+        }
+        currentPlayerIndex = (currentPlayerIndex + 1) % numPlayers;
+    }
+    record.header.leader = record.header.winner >= 0 ? record.header.winner : leadingPlayer(players);
+    record.header.turns = turn;
+    span.arg = turn;
+    record.header.eventCount = record.events.size();
+    return record;
+}
+
+int runSelfPlay(int argc, char** argv) {
+    if (argc < 4) {
+        cout << "Usage: " << argv[0] << " selfplay <archive> <games> [--players N] [--seed S] [--max-turns T]\n";
+        return 1;
+    }
+    string path = argv[2];
+    long long games = stoll(argv[3]);
+    int numPlayers = 4;
+    uint64_t seed = 1;
+    int maxTurns = DEFAULT_MAX_TURNS;
+    for (int i = 4; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        if (option == "--players") {
+            numPlayers = stoi(argv[i + 1]);
+        } else if (option == "--seed") {
+            seed = stoull(argv[i + 1]);
+        } else if (option == "--max-turns") {
+            maxTurns = stoi(argv[i + 1]);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (numPlayers < 2 || numPlayers > 4 || maxTurns < 1 || maxTurns > 65535) {
+        cout << "Players must be 2-4 and the turn limit 1-65535.\n";
+        return 1;
+    }
+
+    ArchiveWriter writer(path);
+    if (!writer.ok()) {
+        cout << "Could not open " << path << " for writing.\n";
+        return 1;
+    }
+
+    for (long long g = 0; g < games; g++) {
+        uint64_t seedOfGame = gameSeed(seed, g);
+        vector<unique_ptr<Policy>> owned;
+        vector<Policy*> policies;
+        for (int i = 0; i < numPlayers; i++) {
+            owned.push_back(unique_ptr<Policy>(new RandomPolicy(seedOfGame ^ (i + 1))));
+            policies.push_back(owned.back().get());
+        }
+        writer.write(playHeadlessGame(numPlayers, seedOfGame, maxTurns, policies));
+    }
+    cout << "Wrote " << games << " games to " << path << "\n";
+    return writer.ok() ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+#ifndef SELFPLAY_H
+#define SELFPLAY_H
+
+#include "ludo.h"
+#include "archive.h"
+
+const int DEFAULT_MAX_TURNS = 400; // Tokens circle the board forever, so headless games need a turn limit
+
+class Policy {
+public:
+    virtual ~Policy() {}
+
+    // Picks one entry of moves (as returned by legalMoves) for the player to move
+    virtual int chooseMove(const vector<Player>& players, int playerIndex, int diceRoll, const vector<int>& moves) = 0;
+
+    // Called while seat mover (a human, say) decides how to play diceRoll; a bot sitting at seat
+    // self may use the time to prepare its own next choice. Must return at once.
+    virtual void ponder(const vector<Player>& players, int mover, int diceRoll, const vector<int>& moves, int self) {}
+};
+
+class RandomPolicy : public Policy {
+public:
+    explicit RandomPolicy(uint64_t seed) : dice(seed) {}
+
+    int chooseMove(const vector<Player>& players, int playerIndex, int diceRoll, const vector<int>& moves) override {
+        return moves[dice.next() % moves.size()];
+    }
+
+private:
+    Dice dice;
+};
+
+// Seed of game number `game` in a run, independent of how games are split across threads
+inline uint64_t gameSeed(uint64_t baseSeed, uint64_t game) {
+    Dice dice(baseSeed + game * 0x9E3779B97F4A7C15ULL);
+    return dice.next();
+}
+
+// Same procedure as chooseToStart: one round of rolls, the first 6 or else the highest roll starts
+int chooseStartingPlayer(Dice& dice, int numPlayers);
+
+// Plays one turn the way playerTurn does, asking the policy instead of cin; events may be null
+void playHeadlessTurn(vector<Player>& players, int playerIndex, const Board& board, Dice& dice,
+                      Policy& policy, uint16_t turn, vector<GameEvent>* events);
+
+// Plays a whole game from a seed; policies holds one entry per seat
+GameRecord playHeadlessGame(int numPlayers, uint64_t seed, int maxTurns, const vector<Policy*>& policies);
+
+// "selfplay" command: writes random-policy games to an archive
+int runSelfPlay(int argc, char** argv);
+
+#endif
@@ -0,0 +1,1108 @@
+#include "server.h"
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "actor.h"
+#include "botscheduler.h"
+#include "metricsexport.h"
+#include "net.h"
+#include "trace.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <csignal>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <ctime>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+namespace {
+
+const int LATENCY_BUCKETS = 10000; // One per microsecond; the last collects everything slower
+const size_t MAX_LINE = 256;        // A connection sending a longer line is dropped
+const size_t READ_CHUNK = 4096;
+const int MAX_EVENTS = 256;
+const size_t MAX_QUEUED_FRAMES = 64; // A spectator further behind than this skips to the next keyframe
+const int MAX_IOVECS = 64;
+const int SPECTATOR_SEND_BUFFER = 16384;
+
+typedef chrono::steady_clock Clock;
+
+atomic<bool> stopRequested(false);
+
+void onSignal(int) {
+    stopRequested = true;
+}
+
+// SIGUSR1 pauses or resumes tracing new deals
+void onTraceSignal(int) {
+    setTracing(!tracingEnabled());
+}
+
+struct ServerSettings {
+    int maxTurns = DEFAULT_MAX_TURNS;
+    uint64_t seed = 1;
+    StatePublisher* publisher = nullptr;
+    WriteAheadLog* wal = nullptr;
+    BotScheduler* bots = nullptr;
+};
+
+// Counters one event loop publishes for the status line
+struct LoopStats {
+    atomic<long long> sessions{0};
+    atomic<long long> games{0};
+    atomic<long long> idleSessions{0}; // Sessions with nothing buffered in either direction
+    atomic<long long> idleBytes{0};
+    atomic<long long> spectators{0};
+    atomic<long long> frames{0};      // Frames handed to spectators, one per spectator
+    atomic<long long> frameMoves{0};  // Moves inside those frames, counted the same way
+    atomic<long long> skipped{0};     // Frames slow spectators never got
+    atomic<long long> fanOutNanos{0}; // Thread CPU spent queueing and writing frames
+    unique_ptr<atomic<uint32_t>[]> latency; // Command-to-reply times, in microsecond buckets
+
+    LoopStats() : latency(new atomic<uint32_t>[LATENCY_BUCKETS]) {
+        for (int i = 0; i < LATENCY_BUCKETS; i++) {
+            latency[i] = 0;
+        }
+    }
+};
+
+// Heap bytes behind a string (none while it fits in the small-string buffer)
+size_t heapBytes(const string& text) {
+    const char* data = text.data();
+    bool local = data >= (const char*) &text && data < (const char*) (&text + 1);
+    return local ? 0 : text.capacity() + 1;
+}
+
+// Live tables by id, so other connections can join them
+class TableDirectory {
+public:
+    uint64_t nextId() {
+        return lastId.fetch_add(1, memory_order_relaxed) + 1;
+    }
+
+    // New ids start above id, so they never collide with a recovered table
+    void reserve(uint64_t id) {
+        lastId = max<uint64_t>(lastId, id);
+    }
+
+    void add(const shared_ptr<GameActor>& actor) {
+        lock_guard<mutex> guard(lock);
+        if (tables.size() >= sweepAt) {
+            // Forget finished tables; doubling the threshold keeps the sweeps amortized O(1)
+            for (auto it = tables.begin(); it != tables.end();) {
+                it = it->second.expired() ? tables.erase(it) : next(it);
+            }
+            sweepAt = max<size_t>(1024, tables.size() * 2);
+        }
+        tables[actor->id] = actor;
+    }
+
+    shared_ptr<GameActor> find(uint64_t id) {
+        lock_guard<mutex> guard(lock);
+        auto it = tables.find(id);
+        return it == tables.end() ? nullptr : it->second.lock();
+    }
+
+private:
+    atomic<uint64_t> lastId{0};
+    mutex lock;
+    unordered_map<uint64_t, weak_ptr<GameActor>> tables;
+    size_t sweepAt = 1024;
+};
+
+// Output side of a spectating connection: frames shared with every other spectator of the table
+struct Spectator {
+    vector<shared_ptr<const Frame>> frames;
+    size_t head = 0;      // First frame not completely written
+    size_t offset = 0;    // Bytes of that frame already written
+    bool skipping = true; // Dropping deltas until a keyframe arrives; new spectators start here
+
+    size_t memoryBytes() const {
+        return sizeof(*this) + frames.capacity() * sizeof(frames[0]);
+    }
+};
+
+long long threadNanos() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+struct Session {
+    uint64_t id = 0;
+    int fd = -1;
+    bool writing = false;            // Registered for EPOLLOUT because the reply did not fit the socket
+    bool dirty = false;              // Has replies from the shards waiting to be flushed
+    bool closed = false;             // Connection closed; freed once the current epoll batch is done
+    string input;
+    string output;
+    shared_ptr<GameActor> table;     // Set by "new" or "join", so a connection alone stays small
+    unique_ptr<Spectator> spectator; // Set by "watch"
+    Clock::time_point pendingSince;  // Arrival of the oldest command whose reply is not yet sent
+    int pendingReplies = 0;
+
+    size_t memoryBytes() const {
+        return sizeof(*this) + heapBytes(input) + heapBytes(output) + (table ? table->memoryBytes() : 0) +
+               (spectator ? spectator->memoryBytes() : 0);
+    }
+};
+
+// Splits the next space-separated field off rest
+bool nextField(string_view& rest, string_view& field) {
+    while (!rest.empty() && rest.front() == ' ') {
+        rest.remove_prefix(1);
+    }
+    if (rest.empty()) {
+        return false;
+    }
+    size_t end = min(rest.find(' '), rest.size());
+    field = rest.substr(0, end);
+    rest.remove_prefix(end);
+    return true;
+}
+
+bool parseNumber(string_view field, uint64_t& value) {
+    auto result = from_chars(field.data(), field.data() + field.size(), value);
+    return result.ec == errc() && result.ptr == field.data() + field.size();
+}
+
+// Distinct addresses marking the two registrations that are not sessions
+char LISTENER_TAG, WAKE_TAG;
+
+// One epoll instance and the connections it owns. Every loop watches the shared listening socket
+// with EPOLLEXCLUSIVE, so each new connection wakes one loop and stays on it for its lifetime.
+// Loops only parse and route: game commands go to the table's inbox on its shard, and the
+// shard's replies come back through this loop's own MPSC queue and an eventfd wake-up.
+class EventLoop : public ReplySink {
+public:
+    EventLoop(int listener, const ServerSettings& settings, LoopStats& stats, uint64_t seed,
+              vector<unique_ptr<Shard>>& shards, TableDirectory& directory)
+        : listener(listener), settings(settings), stats(stats), seeds(seed), shards(shards), directory(directory) {}
+
+    ~EventLoop() {
+        for (auto& entry : sessions) {
+            close(entry.second->fd);
+        }
+        while (Reply* reply = replies.pop()) {
+            freeReply(reply);
+        }
+        if (wakeFd >= 0) {
+            close(wakeFd);
+        }
+        if (epoll >= 0) {
+            close(epoll);
+        }
+    }
+
+    bool open() {
+        epoll = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll < 0 || wakeFd < 0) {
+            return false;
+        }
+        epoll_event event = {};
+        event.events = EPOLLIN | EPOLLEXCLUSIVE;
+        event.data.ptr = &LISTENER_TAG;
+        if (epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event) != 0) {
+            return false;
+        }
+        event.events = EPOLLIN;
+        event.data.ptr = &WAKE_TAG;
+        return epoll_ctl(epoll, EPOLL_CTL_ADD, wakeFd, &event) == 0;
+    }
+
+    // Called by shard workers
+    void deliver(Reply* reply) override {
+        replies.push(reply);
+        if (!wakePending.exchange(true, memory_order_acq_rel)) {
+            uint64_t one = 1;
+            ssize_t written = write(wakeFd, &one, sizeof(one));
+            (void) written;
+        }
+    }
+
+    void run() {
+        epoll_event events[MAX_EVENTS];
+        auto lastAccounting = Clock::now();
+        while (!stopRequested) {
+            int ready = epoll_wait(epoll, events, MAX_EVENTS, 100);
+            Clock::time_point now = Clock::now();
+            for (int i = 0; i < ready; i++) {
+                void* tag = events[i].data.ptr;
+                if (tag == &LISTENER_TAG) {
+                    acceptAll();
+                    continue;
+                }
+                if (tag == &WAKE_TAG) {
+                    drainReplies();
+                    continue;
+                }
+                Session& session = *(Session*) tag;
+                if (session.closed) {
+                    continue; // Closed earlier in this batch
+                }
+                bool alive = true;
+                if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                    alive = readCommands(session, now);
+                }
+                if (alive && (events[i].events & EPOLLOUT)) {
+                    alive = flush(session);
+                }
+                if (!alive) {
+                    closeSession(session);
+                }
+            }
+            closedSessions.clear(); // No event of this batch can still point at them
+            if (now - lastAccounting >= chrono::seconds(1)) {
+                account();
+                lastAccounting = now;
+            }
+        }
+    }
+
+private:
+    int listener;
+    int epoll = -1;
+    int wakeFd = -1;
+    const ServerSettings& settings;
+    LoopStats& stats;
+    Dice seeds; // Seeds for games dealt without an explicit one
+    vector<unique_ptr<Shard>>& shards;
+    TableDirectory& directory;
+    uint64_t lastSession = 0;
+    unordered_map<uint64_t, unique_ptr<Session>> sessions;
+    vector<unique_ptr<Session>> closedSessions; // Out of sessions, but maybe still in this batch's events
+    MpscQueue<Reply> replies;
+    atomic<bool> wakePending{false};
+    vector<Session*> dirty;
+    vector<Session*> dirtySpectators;
+    long long frameCount = 0, frameMoves = 0, skipped = 0; // Added to stats once per drain
+    vector<Reply*> frameReplies;
+    unordered_map<uint64_t, vector<Session*>> watchers; // This loop's spectators by table id
+
+    void acceptAll() {
+        while (true) {
+            int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return; // Drained, taken by another loop, or out of descriptors
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // Fails harmlessly on Unix sockets
+
+            unique_ptr<Session> session(new Session());
+            session->id = ++lastSession;
+            session->fd = fd;
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.ptr = session.get();
+            if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+                close(fd);
+                continue;
+            }
+            sessions[session->id] = std::move(session);
+            stats.sessions++;
+        }
+    }
+
+    void closeSession(Session& session) {
+        leaveTable(session);
+        if (session.spectator) {
+            stats.spectators--;
+        }
+        close(session.fd); // Also drops the epoll registration
+        session.closed = true;
+        auto it = sessions.find(session.id);
+        closedSessions.push_back(std::move(it->second));
+        sessions.erase(it);
+        stats.sessions--;
+    }
+
+    void post(Session& session, GameActor& table, CommandType type, int value, Clock::time_point received,
+              uint64_t seed = 0) {
+        Command* command = newCommand();
+        command->type = type;
+        command->from.sink = this;
+        command->from.session = session.id;
+        command->value = value;
+        command->seed = seed;
+        command->received = received;
+        shards[table.shard]->post(table, command);
+    }
+
+    void leaveTable(Session& session) {
+        if (!session.table) {
+            return;
+        }
+        if (session.spectator) {
+            post(session, *session.table, COMMAND_UNWATCH, 0, Clock::time_point());
+            vector<Session*>& list = watchers[session.table->id];
+            *find(list.begin(), list.end(), &session) = list.back();
+            list.pop_back();
+            if (list.empty()) {
+                watchers.erase(session.table->id);
+            }
+        } else {
+            post(session, *session.table, COMMAND_LEAVE, 0, Clock::time_point());
+        }
+        session.table.reset();
+    }
+
+    // Subscribes the session to a table's frames; a spectator that switches tables drops what it had
+    // queued, except a frame already partly written
+    void watch(Session& session, const shared_ptr<GameActor>& table, Clock::time_point received) {
+        bool wasWatching = (bool) session.spectator;
+        leaveTable(session);
+        if (!wasWatching) {
+            session.spectator.reset(new Spectator());
+            stats.spectators++;
+            // A small kernel buffer makes a stalled spectator show up in its frame queue, and skip
+            // stale deltas, instead of parking megabytes of them in the socket
+            int bytes = SPECTATOR_SEND_BUFFER;
+            setsockopt(session.fd, SOL_SOCKET, SO_SNDBUF, &bytes, sizeof(bytes));
+        }
+        Spectator& spectator = *session.spectator;
+        spectator.frames.resize(spectator.head + (spectator.offset > 0));
+        spectator.skipping = true;
+        watchers[table->id].push_back(&session);
+        session.table = table;
+        post(session, *table, COMMAND_WATCH, 0, received);
+    }
+
+    // Queues a shared frame for one spectator; no bytes are copied
+    void queueFrame(Session& session, const shared_ptr<const Frame>& frame) {
+        Spectator& spectator = *session.spectator;
+        if (!session.table || frame->table != session.table->id) {
+            return; // Left over from a table the spectator has since switched away from
+        }
+        frameCount++;
+        frameMoves += frame->moves;
+        size_t unstarted = spectator.head + (spectator.offset > 0);
+        if (spectator.frames.size() - spectator.head >= MAX_QUEUED_FRAMES) {
+            // Too slow to keep up: drop the backlog and queue nothing until the next keyframe
+            skipped += spectator.frames.size() - unstarted;
+            spectator.frames.resize(unstarted);
+            spectator.skipping = true;
+        }
+        if (frame->keyframe) {
+            spectator.skipping = false;
+        } else if (spectator.skipping) {
+            skipped++;
+            return;
+        }
+        spectator.frames.push_back(frame);
+        if (!session.dirty) {
+            session.dirty = true;
+            dirtySpectators.push_back(&session);
+        }
+    }
+
+    void fanOut(const Reply& reply) {
+        if (reply.session != 0) {
+            auto it = sessions.find(reply.session);
+            if (it != sessions.end() && it->second->spectator) {
+                queueFrame(*it->second, reply.frame);
+            }
+            return;
+        }
+        auto it = watchers.find(reply.table);
+        if (it != watchers.end()) {
+            for (Session* session : it->second) {
+                queueFrame(*session, reply.frame);
+            }
+        }
+    }
+
+    // Queues text for the session, counting it toward latency if it answers a command
+    void queueReply(Session& session, const string& text, Clock::time_point received) {
+        session.output += text;
+        if (received != Clock::time_point()) {
+            if (session.pendingReplies == 0 || received < session.pendingSince) {
+                session.pendingSince = received;
+            }
+            session.pendingReplies++;
+        }
+    }
+
+    // Answers a command from the loop; behind the session's table if it has one, so replies keep command order
+    void answer(Session& session, const string& text, Clock::time_point received) {
+        if (!session.table) {
+            queueReply(session, text, received);
+            return;
+        }
+        Command* command = newCommand();
+        command->type = COMMAND_ECHO;
+        command->from.sink = this;
+        command->from.session = session.id;
+        command->received = received;
+        command->text = text;
+        shards[session.table->shard]->post(*session.table, command);
+    }
+
+    // Moves replies from the shards into their sessions' output, then flushes each touched session
+    void drainReplies() {
+        uint64_t count;
+        ssize_t got = read(wakeFd, &count, sizeof(count));
+        (void) got;
+        wakePending.exchange(false, memory_order_acq_rel); // Pairs with deliver, so no push goes unseen
+        while (Reply* reply = replies.pop()) {
+            if (reply->frame) {
+                frameReplies.push_back(reply);
+                continue;
+            }
+            auto it = sessions.find(reply->session);
+            if (it != sessions.end()) {
+                Session& session = *it->second;
+                queueReply(session, reply->text, reply->received);
+                if (!session.dirty) {
+                    session.dirty = true;
+                    dirty.push_back(&session);
+                }
+            }
+            freeReply(reply);
+        }
+        if (!frameReplies.empty()) {
+            // Timed apart from the players' replies, so the status line can charge it per spectator
+            long long started = threadNanos();
+            for (Reply* reply : frameReplies) {
+                fanOut(*reply);
+                freeReply(reply);
+            }
+            frameReplies.clear();
+            flushAll(dirtySpectators);
+            stats.fanOutNanos.fetch_add(threadNanos() - started, memory_order_relaxed);
+            stats.frames.fetch_add(frameCount, memory_order_relaxed);
+            stats.frameMoves.fetch_add(frameMoves, memory_order_relaxed);
+            stats.skipped.fetch_add(skipped, memory_order_relaxed);
+            frameCount = frameMoves = skipped = 0;
+        }
+        flushAll(dirty);
+    }
+
+    void flushAll(vector<Session*>& touched) {
+        for (int i = 0; i < touched.size(); i++) {
+            Session* session = touched[i];
+            session->dirty = false;
+            if (session->closed) {
+                continue; // Failed in an earlier flush or read; its output goes nowhere
+            }
+            if (!flush(*session)) {
+                closeSession(*session);
+            }
+        }
+        touched.clear();
+    }
+
+    // Reads whatever arrived and handles each complete line; false once the connection should close
+    bool readCommands(Session& session, Clock::time_point received) {
+        char buffer[READ_CHUNK];
+        bool keep = true;
+        while (true) {
+            ssize_t count = recv(session.fd, buffer, sizeof(buffer), 0);
+            if (count > 0) {
+                session.input.append(buffer, count);
+                if (count < (ssize_t) sizeof(buffer)) {
+                    break;
+                }
+            } else if (count < 0 && errno == EINTR) {
+                continue;
+            } else {
+                keep = count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK); // 0 means the peer hung up
+                break;
+            }
+        }
+
+        size_t start = 0, end;
+        while (keep && (end = session.input.find('\n', start)) != string::npos) {
+            string_view line(session.input.data() + start, end - start);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            keep = handleLine(session, line, received);
+            start = end + 1;
+        }
+        session.input.erase(0, start);
+        if (session.input.size() > MAX_LINE) {
+            return false;
+        }
+        if (session.input.empty() && session.input.capacity() > MAX_LINE) {
+            string().swap(session.input);
+        }
+        return flush(session) && keep;
+    }
+
+    // Routes one command to the session's table, or answers it here; false for "quit"
+    bool handleLine(Session& session, string_view line, Clock::time_point received) {
+        string_view rest = line, command, field;
+        if (!nextField(rest, command)) {
+            answer(session, "error empty command\n", received);
+            return true;
+        }
+        if (command == "quit") {
+            return false;
+        }
+
+        if (command == "watch") {
+            uint64_t id;
+            shared_ptr<GameActor> table;
+            if (!nextField(rest, field) || !parseNumber(field, id)) {
+                answer(session, "error usage: watch TABLE\n", received);
+            } else if (!(table = directory.find(id))) {
+                answer(session, "error no table " + to_string(id) + "\n", received);
+            } else {
+                watch(session, table, received);
+            }
+            return true;
+        }
+        if (session.spectator) {
+            return true; // Text in the middle of a binary stream would corrupt it; only watch and quit count
+        }
+
+        if (command == "new" || command == "lockstep") {
+            uint64_t numPlayers, seed;
+            if (!nextField(rest, field) || !parseNumber(field, numPlayers) || numPlayers < 2 || numPlayers > 4) {
+                answer(session, "error usage: " + string(command) + " PLAYERS [SEED] with 2-4 players\n", received);
+                return true;
+            }
+            if (!nextField(rest, field)) {
+                seed = seeds.next();
+            } else if (!parseNumber(field, seed)) {
+                answer(session, "error bad seed\n", received);
+                return true;
+            }
+            leaveTable(session);
+            uint64_t id = directory.nextId();
+            shared_ptr<GameActor> table = make_shared<GameActor>(id, id % shards.size());
+            if (command == "new") {
+                table->publisher = settings.publisher;
+                table->wal = settings.wal;
+                table->bots = settings.bots;
+            }
+            Command* deal = newCommand();
+            deal->type = command == "new" ? COMMAND_NEW : COMMAND_LOCKSTEP;
+            deal->from.sink = this;
+            deal->from.session = session.id;
+            deal->value = numPlayers;
+            deal->seed = seed;
+            deal->turnLimit = settings.maxTurns;
+            deal->received = received;
+            shards[table->shard]->post(*table, deal);
+            directory.add(table); // After the deal is queued, so a join can never overtake it
+            session.table = table;
+            stats.games++;
+            return true;
+        }
+
+        if (command == "join") {
+            uint64_t id, seat = 0;
+            shared_ptr<GameActor> table;
+            if (!nextField(rest, field) || !parseNumber(field, id) ||
+                (nextField(rest, field) && (!parseNumber(field, seat) || seat < 1 || seat > 4))) {
+                answer(session, "error usage: join TABLE [SEAT]\n", received);
+            } else if (!(table = directory.find(id))) {
+                answer(session, "error no table " + to_string(id) + "\n", received);
+            } else {
+                if (session.table != table) {
+                    leaveTable(session);
+                }
+                post(session, *table, COMMAND_JOIN, (int) seat - 1, received);
+                session.table = table;
+            }
+            return true;
+        }
+
+        if (!session.table) {
+            answer(session, "error no game; send new PLAYERS or join TABLE first\n", received);
+            return true;
+        }
+        if (command == "move" || command == "m") {
+            uint64_t choice;
+            if (!nextField(rest, field) || !parseNumber(field, choice) || choice > 4) {
+                answer(session, "error usage: move 0-4\n", received);
+            } else {
+                post(session, *session.table, COMMAND_MOVE, choice == 0 ? ENTER_TOKEN : (int) choice - 1, received);
+            }
+        } else if (command == "bot") {
+            uint64_t seat, thinkMs = 0;
+            if (!nextField(rest, field) || !parseNumber(field, seat) || seat < 1 || seat > 4 ||
+                (nextField(rest, field) && (!parseNumber(field, thinkMs) || thinkMs > 60000))) {
+                answer(session, "error usage: bot SEAT [MS]\n", received);
+            } else {
+                post(session, *session.table, COMMAND_BOT, (int) seat - 1, Clock::time_point(), thinkMs * 1000);
+            }
+        } else if (command == "pos") {
+            post(session, *session.table, COMMAND_POS, 0, received);
+        } else if (command == "h") {
+            uint64_t moves, hash;
+            if (nextField(rest, field) && parseNumber(field, moves) && nextField(rest, field) && parseNumber(field, hash)) {
+                post(session, *session.table, COMMAND_HASH, (int) moves, Clock::time_point(), hash);
+            } else {
+                answer(session, "error usage: h MOVES HASH\n", received);
+            }
+        } else {
+            answer(session, "error unknown command\n", received);
+        }
+        return true;
+    }
+
+    // Sends as much buffered output as the socket takes, watching for writability while some is left
+    bool flush(Session& session) {
+        Spectator* spectator = session.spectator.get();
+        if (spectator && spectator->offset > 0 && !writeFrames(session, *spectator, true)) {
+            return false; // Text may only go out between frames
+        }
+        size_t sent = 0;
+        while (sent < session.output.size()) {
+            ssize_t count = send(session.fd, session.output.data() + sent, session.output.size() - sent, MSG_NOSIGNAL);
+            if (count > 0) {
+                sent += count;
+            } else if (count < 0 && errno == EINTR) {
+                continue;
+            } else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                return false;
+            }
+        }
+        session.output.erase(0, sent);
+        if (spectator && session.output.empty() && !writeFrames(session, *spectator, false)) {
+            return false;
+        }
+
+        bool backedUp = !session.output.empty() || (spectator && spectator->head < spectator->frames.size());
+        if (!backedUp) {
+            if (session.pendingReplies > 0) {
+                long long micros = chrono::duration_cast<chrono::microseconds>(Clock::now() - session.pendingSince).count();
+                stats.latency[min<long long>(micros, LATENCY_BUCKETS - 1)].fetch_add(session.pendingReplies,
+                                                                                   memory_order_relaxed);
+                session.pendingReplies = 0;
+            }
+            if (session.output.capacity() > READ_CHUNK) {
+                string().swap(session.output);
+            }
+        }
+        if (backedUp != session.writing) {
+            epoll_event event = {};
+            event.events = EPOLLIN | (backedUp ? EPOLLOUT : 0);
+            event.data.ptr = &session;
+            epoll_ctl(epoll, EPOLL_CTL_MOD, session.fd, &event);
+            session.writing = backedUp;
+        }
+        return true;
+    }
+
+    // Writes queued frames straight from their shared buffers with scatter-gather sends; with
+    // partOnly, just the rest of a partly written frame. False if the connection failed.
+    bool writeFrames(Session& session, Spectator& spectator, bool partOnly) {
+        vector<shared_ptr<const Frame>>& frames = spectator.frames;
+        while (spectator.head < frames.size()) {
+            iovec parts[MAX_IOVECS];
+            int count = 0;
+            size_t last = partOnly ? spectator.head + 1 : frames.size();
+            for (size_t i = spectator.head; i < last && count < MAX_IOVECS; i++, count++) {
+                size_t skip = i == spectator.head ? spectator.offset : 0;
+                parts[count].iov_base = (void*) (frames[i]->bytes.data() + skip);
+                parts[count].iov_len = frames[i]->bytes.size() - skip;
+            }
+            msghdr message = {};
+            message.msg_iov = parts;
+            message.msg_iovlen = count;
+            ssize_t written = sendmsg(session.fd, &message, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (written <= 0) {
+                return false;
+            }
+            for (size_t left = written; left > 0;) {
+                size_t remaining = frames[spectator.head]->bytes.size() - spectator.offset;
+                if (left < remaining) {
+                    spectator.offset += left;
+                    break;
+                }
+                left -= remaining;
+                frames[spectator.head++].reset(); // The last spectator to finish a frame frees it
+                spectator.offset = 0;
+            }
+            if (partOnly && spectator.offset == 0) {
+                break;
+            }
+        }
+        if (spectator.head == frames.size() || spectator.head >= MAX_QUEUED_FRAMES) {
+            frames.erase(frames.begin(), frames.begin() + spectator.head);
+            spectator.head = 0;
+        }
+        return true;
+    }
+
+    // Publishes the memory held by idle sessions; runs about once a second
+    void account() {
+        long long idle = 0, bytes = 0;
+        for (const auto& entry : sessions) {
+            const Session& session = *entry.second;
+            if (session.input.empty() && session.output.empty()) {
+                idle++;
+                bytes += session.memoryBytes();
+            }
+        }
+        stats.idleSessions = idle;
+        stats.idleBytes = bytes;
+    }
+};
+
+}
+
+int runServe(int argc, char** argv) {
+    string unixPath;
+    string address = "127.0.0.1";
+    int port = 7777;
+    int threadCount = max(1u, thread::hardware_concurrency());
+    int workerCount = threadCount;
+    bool pin = true;
+    double statusEvery = 10, duration = 0;
+    string publishName;
+    int publishSlots = 1024;
+    string dataDirectory;
+    int commitMicros = 1000;
+    double snapshotMb = 64, recoveryGrace = 600;
+    int botThreads = 1, botMs = 50, botBudget = 500;
+    string metricsPath, tracePath;
+    int metricsPort = 0, traceSampleEvery = 1000;
+    ServerSettings settings;
+    for (int i = 2; i < argc; i += 2) {
+        string option = argv[i];
+        if (i + 1 >= argc) {
+            cout << "Usage: " << argv[0] << " serve [--port P] [--bind ADDRESS] [--unix PATH] [--threads K]\n"
+                 << "       [--workers W] [--pin 0|1] [--max-turns T] [--seed S] [--status-every SEC] [--duration SEC]\n"
+                 << "       [--publish NAME] [--publish-slots N] [--data DIR] [--commit-us US] [--snapshot-mb MB]\n"
+                 << "       [--recovery-grace SEC] [--bot-threads N] [--bot-ms MS] [--bot-budget ROLLOUTS]\n"
+                 << "       [--metrics-file PATH] [--metrics-port P] [--trace FILE] [--trace-sample N]\n"
+                 << "--publish mirrors tables into shared memory NAME (see state-watch), slot = table id mod N.\n"
+                 << "--data logs every table to DIR and brings back the ones in play on restart; players\n"
+                 << "rejoin with join TABLE SEAT within the grace period (default 600 s).\n"
+                 << "Bot seats think on their own N threads (0 disables bots) for up to MS or ROLLOUTS.\n"
+                 << "Metrics (built with -DLUDO_METRICS=ON) go to PATH every second and/or to GET on 127.0.0.1:P.\n"
+                 << "--trace writes a Chrome trace of one deal in every N (default 1000); SIGUSR1 pauses and resumes it.\n";
+            return 1;
+        }
+        string value = argv[i + 1];
+        if (option == "--port") {
+            port = stoi(value);
+        } else if (option == "--bind") {
+            address = value;
+        } else if (option == "--unix") {
+            unixPath = value;
+        } else if (option == "--threads") {
+            threadCount = stoi(value);
+        } else if (option == "--workers") {
+            workerCount = stoi(value);
+        } else if (option == "--pin") {
+            pin = value != "0";
+        } else if (option == "--max-turns") {
+            settings.maxTurns = stoi(value);
+        } else if (option == "--seed") {
+            settings.seed = stoull(value);
+        } else if (option == "--status-every") {
+            statusEvery = stod(value);
+        } else if (option == "--duration") {
+            duration = stod(value);
+        } else if (option == "--publish") {
+            publishName = value;
+        } else if (option == "--publish-slots") {
+            publishSlots = stoi(value);
+        } else if (option == "--data") {
+            dataDirectory = value;
+        } else if (option == "--commit-us") {
+            commitMicros = stoi(value);
+        } else if (option == "--snapshot-mb") {
+            snapshotMb = stod(value);
+        } else if (option == "--recovery-grace") {
+            recoveryGrace = stod(value);
+        } else if (option == "--bot-threads") {
+            botThreads = stoi(value);
+        } else if (option == "--bot-ms") {
+            botMs = stoi(value);
+        } else if (option == "--bot-budget") {
+            botBudget = stoi(value);
+        } else if (option == "--metrics-file") {
+            metricsPath = value;
+        } else if (option == "--metrics-port") {
+            metricsPort = stoi(value);
+        } else if (option == "--trace") {
+            tracePath = value;
+        } else if (option == "--trace-sample") {
+            traceSampleEvery = stoi(value);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (threadCount < 1 || workerCount < 1 || settings.maxTurns < 1 || settings.maxTurns > 65535 || publishSlots < 1 ||
+        botThreads < 0 || botMs < 1 || botBudget < 1 || traceSampleEvery < 1) {
+        cout << "Threads, workers, slots, bot time, budget and trace sampling must be at least 1 and the turn limit\n"
+             << "1-65535.\n";
+        return 1;
+    }
+    StatePublisher publisher;
+    if (!publishName.empty()) {
+        // A multiple of the worker count, so tables sharing a slot always share a worker too
+        publishSlots = (publishSlots + workerCount - 1) / workerCount * workerCount;
+        if (!publisher.open(publishName, publishSlots)) {
+            cout << "Could not create shared memory " << publishName << "\n";
+            return 1;
+        }
+        settings.publisher = &publisher;
+    }
+
+    // Every session is a descriptor, so lift the soft limit as far as the hard one allows
+    rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    int listener = openListener(unixPath, address, port);
+    if (listener < 0) {
+        cout << "Could not listen on " << (unixPath.empty() ? address + ":" + to_string(port) : unixPath) << "\n";
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    if (!tracePath.empty()) {
+        if (!startTracing(tracePath, traceSampleEvery)) {
+            return 1;
+        }
+        signal(SIGUSR1, onTraceSignal);
+    }
+
+    // Table id picks the shard, and each shard's worker stays on one core
+    int cpus = max(1u, thread::hardware_concurrency());
+    vector<unique_ptr<Shard>> shards;
+    for (int w = 0; w < workerCount; w++) {
+        shards.push_back(unique_ptr<Shard>(new Shard(pin ? w % cpus : -1)));
+    }
+    TableDirectory directory;
+    BotScheduler bots(shards, botThreads);
+    bots.thinkMicros = botMs * 1000;
+    bots.budget = botBudget;
+    if (botThreads > 0) {
+        settings.bots = &bots;
+    }
+
+    // Tables in play when the last run stopped come back before anyone can connect. Nobody owns
+    // them yet, so they are held here for the grace period while their players rejoin.
+    unique_ptr<WriteAheadLog> wal;
+    vector<shared_ptr<GameActor>> recovered;
+    if (!dataDirectory.empty()) {
+        wal.reset(new WriteAheadLog(dataDirectory, workerCount));
+        wal->commitMicros = commitMicros;
+        wal->snapshotBytes = (size_t) (snapshotMb * 1024 * 1024);
+        vector<RecoveredTable> tables;
+        auto started = Clock::now();
+        wal->recover(tables, cpus);
+        for (const auto& entry : tables) {
+            shared_ptr<GameActor> table = make_shared<GameActor>(entry.id, entry.id % shards.size());
+            table->publisher = settings.publisher;
+            table->wal = wal.get();
+            table->bots = settings.bots;
+            shards[table->shard]->adopt(table, entry.table, entry.moves);
+            directory.reserve(entry.id);
+            directory.add(table);
+            recovered.push_back(table);
+        }
+        cout << "Recovered " << tables.size() << " tables from " << dataDirectory << " in "
+             << chrono::duration<double, milli>(Clock::now() - started).count() << " ms ("
+             << wal->recoverySummary << ")\n";
+        settings.wal = wal.get();
+    }
+    for (auto& shard : shards) {
+        shard->wal = wal.get();
+        shard->start();
+    }
+    if (settings.bots) {
+        bots.start();
+    }
+    if (wal && !wal->start([&shards](uint32_t generation) {
+            for (auto& shard : shards) {
+                shard->snapshot(generation);
+            }
+        })) {
+        cout << "Could not open a log in " << dataDirectory << "\n";
+        return 1;
+    }
+
+    MetricsExporter metrics;
+    if (!metrics.start(metricsPath, metricsPort, 1000)) {
+        return 1;
+    }
+
+    vector<unique_ptr<LoopStats>> stats;
+    vector<unique_ptr<EventLoop>> loops;
+    for (int t = 0; t < threadCount; t++) {
+        stats.push_back(unique_ptr<LoopStats>(new LoopStats()));
+        loops.push_back(unique_ptr<EventLoop>(
+            new EventLoop(listener, settings, *stats.back(), gameSeed(settings.seed, t), shards, directory)));
+        if (!loops.back()->open()) {
+            cout << "Could not create an epoll instance.\n";
+            return 1;
+        }
+    }
+    vector<thread> threads;
+    for (auto& loop : loops) {
+        EventLoop* target = loop.get();
+        threads.push_back(thread([target]() { target->run(); }));
+    }
+
+    cout << "Serving on " << (unixPath.empty() ? address + ":" + to_string(port) : unixPath) << " with "
+         << threadCount << " event loops and " << workerCount << (pin ? " pinned" : "") << " table workers";
+    if (!publishName.empty()) {
+        cout << ", publishing tables to " << publishName << " (" << publishSlots << " slots)";
+    }
+    if (wal) {
+        cout << ", logging to " << dataDirectory;
+    }
+    if (settings.bots) {
+        cout << ", " << botThreads << " bot threads";
+    }
+#ifndef LUDO_METRICS
+    if (!metricsPath.empty() || metricsPort > 0) {
+        cout << ", exporting metrics (compiled out, so all zero)";
+    }
+#endif
+    cout << "\n";
+    auto started = Clock::now();
+    auto lastStatus = started;
+    vector<uint64_t> latency(LATENCY_BUCKETS);
+    long long lastRecords = 0, lastCommits = 0, lastSyncNanos = 0;
+    while (!stopRequested) {
+        this_thread::sleep_for(chrono::milliseconds(100));
+        auto now = Clock::now();
+        bool finished = duration > 0 && chrono::duration<double>(now - started).count() >= duration;
+        double interval = chrono::duration<double>(now - lastStatus).count();
+        if (!finished && interval < statusEvery) {
+            continue;
+        }
+
+        long long sessions = 0, games = 0, idle = 0, idleBytes = 0;
+        long long spectators = 0, frames = 0, frameMoves = 0, skipped = 0, fanOutNanos = 0;
+        uint64_t commands = 0;
+        fill(latency.begin(), latency.end(), 0);
+        for (auto& loop : stats) {
+            sessions += loop->sessions;
+            games += loop->games;
+            idle += loop->idleSessions;
+            idleBytes += loop->idleBytes;
+            spectators += loop->spectators;
+            frames += loop->frames.exchange(0, memory_order_relaxed);
+            frameMoves += loop->frameMoves.exchange(0, memory_order_relaxed);
+            skipped += loop->skipped.exchange(0, memory_order_relaxed);
+            fanOutNanos += loop->fanOutNanos.exchange(0, memory_order_relaxed);
+            for (int b = 0; b < LATENCY_BUCKETS; b++) {
+                uint32_t count = loop->latency[b].exchange(0, memory_order_relaxed);
+                latency[b] += count;
+                commands += count;
+            }
+        }
+        // Percentiles over the commands answered since the last status line
+        int p50 = 0, p99 = 0;
+        uint64_t seen = 0;
+        for (int b = 0; b < LATENCY_BUCKETS && commands > 0; b++) {
+            seen += latency[b];
+            if (seen * 2 < commands) {
+                p50 = b + 1;
+            }
+            if (seen * 100 < commands * 99) {
+                p99 = b + 1;
+            }
+        }
+        cout << "sessions " << sessions << " (" << idle << " idle, " << (idle ? idleBytes / idle : 0)
+             << " bytes each), games dealt " << games << ", " << (long long) (commands / interval)
+             << " commands/s, latency p50 " << p50 << " us, p99 " << (p99 == LATENCY_BUCKETS - 1 ? ">= " : "") << p99
+             << " us\n";
+        if (spectators > 0 || frames > 0) {
+            // Loop CPU for queueing and writing frames, shared out over every spectator-move delivered
+            cout << "spectators " << spectators << ": " << (long long) (frames / interval) << " frames/s, "
+                 << (frameMoves ? fanOutNanos / frameMoves : 0) << " ns CPU per spectator per move, " << skipped
+                 << " frames skipped by slow spectators\n";
+        }
+        if (wal) {
+            long long records = wal->stats.records, commits = wal->stats.commits, syncNanos = wal->stats.syncNanos;
+            long long newCommits = commits - lastCommits;
+            cout << "wal: " << (long long) ((records - lastRecords) / interval) << " records/s, "
+                 << (long long) (newCommits / interval) << " commits/s, "
+                 << (newCommits ? (records - lastRecords) / newCommits : 0) << " records per commit, fdatasync avg "
+                 << (newCommits ? (syncNanos - lastSyncNanos) / newCommits / 1000 : 0) << " us, max "
+                 << wal->stats.maxSyncNanos.exchange(0) / 1000 << " us, snapshot " << wal->stats.snapshot << "\n";
+            lastRecords = records;
+            lastCommits = commits;
+            lastSyncNanos = syncNanos;
+        }
+        if (settings.bots) {
+            BotStats botStats;
+            bots.collect(botStats);
+            if (botStats.decisions > 0) {
+                cout << "bots: " << (long long) (botStats.decisions / interval) << " decisions/s, "
+                     << botStats.rollouts / botStats.decisions << " rollouts each, queue latency p50 "
+                     << botStats.queueLatency.percentile(50) / 1000 << " us, p99 "
+                     << botStats.queueLatency.percentile(99) / 1000 << " us, " << botStats.missed
+                     << " missed deadlines, " << botStats.preempted << " preempted, " << bots.queued() << " queued\n";
+            }
+        }
+        if (!recovered.empty() && chrono::duration<double>(now - started).count() >= recoveryGrace) {
+            recovered.clear(); // Tables nobody rejoined are abandoned like any other
+        }
+        lastStatus = now;
+        if (finished) {
+            stopRequested = true;
+        }
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+    if (wal) {
+        wal->stop(); // Before any table is torn down, so those still in play come back next time
+    }
+    bots.stop(); // Its threads post into the shards
+    metrics.stop();
+    stopTracing();
+    shards.clear(); // Workers may still deliver to the loops until they are joined
+    recovered.clear();
+    loops.clear();
+    close(listener);
+    if (!unixPath.empty()) {
+        unlink(unixPath.c_str());
+    }
+    return 0;
+}
+
+#else
+
+int runServe(int argc, char** argv) {
+    cout << "serve needs epoll, which is only available on Linux.\n";
+    return 1;
+}
+
+#endif
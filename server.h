@@ -0,0 +1,36 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "table.h"
+
+// Line protocol spoken by "serve" (one command or reply per line):
+//   client: new PLAYERS [SEED]   deal a table; this connection starts out owning every seat
+//           join TABLE [SEAT]    take over SEAT of another connection's table, or just watch it
+//           move M               answer an ask for a seat you own: 0 enters a token, 1-4 moves that token
+//           pos                  current position in the notation of position.h
+//           bot SEAT [MS]        hand a seat you own to a server bot thinking up to MS per move (no reply);
+//                                join TABLE SEAT takes it back
+//           lockstep PLAYERS [SEED]  deal a relay-only table (see lockstep.h); m M and h MOVES HASH go with it
+//           watch TABLE          turn this connection into a binary spectator stream of TABLE
+//           quit
+//   server: table ID             reply to new and join, followed by the table's current ask or over
+//           ask SEAT ROLL M,M,...  seat (1-based) must choose one of the listed moves; sent to every member
+//           over LEADER TURNS      game finished; LEADER is the winner or the seat furthest along
+//           pos TEXT
+//           error MESSAGE
+//
+// A spectator gets "watching ID" and then only binary frames; after that it may only send another
+// watch or quit. Frames are little-endian: u16 length of the whole frame, u8 kind, u32 sequence.
+//   kind 1, delta:    8 bytes per move applied since the last delta: u16 turn, u8 seat, u8 type
+//                     (0 entered, 1 moved), i8 token, u8 dice, i8 from, i8 to; squares are -1 off the
+//                     board (tokens in this game never capture, so there is no capture field)
+//   kind 2, keyframe: u64 table, u8 players, u8 seat to move, u8 chances, u16 turn, u8 leader + 1
+//                     once the game is over (else 0), then 4 i8 squares per player
+// Deltas count up from 1; a keyframe carries the number of the last delta it includes and comes
+// after every 32 deltas and at the end. A spectator too far behind loses deltas until the next one.
+
+// "serve" command: epoll event loops multiplex the connections and route commands into each
+// table's lock-free inbox; tables are sharded by id over pinned worker threads
+int runServe(int argc, char** argv);
+
+#endif
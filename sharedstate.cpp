@@ -0,0 +1,500 @@
+#include "sharedstate.h"
+#include "histogram.h"
+#include "selfplay.h"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <thread>
+
+#ifdef __linux__
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const uint64_t STATE_MAGIC = 0x314154534F44554CULL; // "LUDOSTA1" in memory order
+const int STATE_WORDS = 5;
+
+void packBytes(uint64_t& word, const int8_t* bytes, int count) {
+    word = 0;
+    for (int i = 0; i < count; i++) {
+        word |= (uint64_t) (uint8_t) bytes[i] << (i * 8);
+    }
+}
+
+void unpackBytes(uint64_t word, int8_t* bytes, int count) {
+    for (int i = 0; i < count; i++) {
+        bytes[i] = (int8_t) (word >> (i * 8));
+    }
+}
+
+// The snapshot as the five words a slot stores
+void encode(const TableSnapshot& snapshot, uint64_t words[STATE_WORDS]) {
+    int8_t fields[8] = {(int8_t) snapshot.numPlayers, (int8_t) snapshot.seat, (int8_t) snapshot.chances,
+                        (int8_t) snapshot.diceRoll, (int8_t) snapshot.state, (int8_t) (snapshot.leader + 1),
+                        (int8_t) (snapshot.turn & 0xFF), (int8_t) (snapshot.turn >> 8)};
+    words[0] = snapshot.table;
+    packBytes(words[1], fields, 8);
+    int8_t squares[16];
+    memcpy(squares, snapshot.squares, sizeof(squares));
+    packBytes(words[2], squares, 8);
+    packBytes(words[3], squares + 8, 8);
+    int8_t moves[3 + STATE_MAX_MOVES] = {(int8_t) snapshot.moveCount};
+    memcpy(moves + 1, snapshot.moves, STATE_MAX_MOVES);
+    moves[1 + STATE_MAX_MOVES] = (int8_t) (snapshot.turn >> 16); // High half of the turn
+    moves[2 + STATE_MAX_MOVES] = (int8_t) (snapshot.turn >> 24);
+    packBytes(words[4], moves, 3 + STATE_MAX_MOVES);
+}
+
+void decode(const uint64_t words[STATE_WORDS], TableSnapshot& snapshot) {
+    int8_t fields[8];
+    unpackBytes(words[1], fields, 8);
+    snapshot.table = words[0];
+    snapshot.numPlayers = fields[0];
+    snapshot.seat = fields[1];
+    snapshot.chances = fields[2];
+    snapshot.diceRoll = fields[3];
+    snapshot.state = fields[4];
+    snapshot.leader = fields[5] - 1;
+
+    int8_t squares[16];
+    unpackBytes(words[2], squares, 8);
+    unpackBytes(words[3], squares + 8, 8);
+    memcpy(snapshot.squares, squares, sizeof(squares));
+    int8_t moves[3 + STATE_MAX_MOVES];
+    unpackBytes(words[4], moves, 3 + STATE_MAX_MOVES);
+    snapshot.moveCount = moves[0];
+    memcpy(snapshot.moves, moves + 1, STATE_MAX_MOVES);
+    snapshot.turn = (uint8_t) fields[6] | (uint8_t) fields[7] << 8 | (uint8_t) moves[1 + STATE_MAX_MOVES] << 16 |
+                    (uint8_t) moves[2 + STATE_MAX_MOVES] << 24;
+}
+
+void fillSquares(TableSnapshot& snapshot, const vector<Player>& players) {
+    memset(snapshot.squares, -1, sizeof(snapshot.squares));
+    for (int p = 0; p < players.size() && p < 4; p++) {
+        for (int t = 0; t < players[p].tokens.size() && t < 4; t++) {
+            const Token& token = players[p].tokens[t];
+            snapshot.squares[p][t] = token.inPlay ? token.position : -1;
+        }
+    }
+}
+
+}
+
+TableSnapshot snapshotTable(uint64_t id, const Table& table) {
+    TableSnapshot snapshot;
+    snapshot.table = id;
+    snapshot.numPlayers = table.players.size();
+    snapshot.seat = table.seat;
+    snapshot.chances = table.chances;
+    snapshot.state = table.state;
+    snapshot.turn = table.turn;
+    if (table.state == Table::TABLE_WAITING) {
+        snapshot.diceRoll = table.diceRoll;
+        snapshot.moveCount = min<int>(table.moves.size(), STATE_MAX_MOVES);
+        for (int i = 0; i < snapshot.moveCount; i++) {
+            snapshot.moves[i] = table.moves[i];
+        }
+    } else if (table.state == Table::TABLE_FINISHED) {
+        snapshot.leader = table.leader();
+    }
+    fillSquares(snapshot, table.players);
+    return snapshot;
+}
+
+TableSnapshot snapshotPlayers(uint64_t id, const vector<Player>& players, int seat, int turn) {
+    TableSnapshot snapshot;
+    snapshot.table = id;
+    snapshot.numPlayers = players.size();
+    snapshot.seat = seat;
+    snapshot.state = Table::TABLE_WAITING;
+    snapshot.turn = turn;
+    for (int p = 0; p < players.size(); p++) {
+        if (players[p].allTokensInHome()) {
+            snapshot.state = Table::TABLE_FINISHED;
+            snapshot.leader = p;
+        }
+    }
+    fillSquares(snapshot, players);
+    return snapshot;
+}
+
+#ifdef __linux__
+
+static_assert(atomic<uint64_t>::is_always_lock_free && atomic<uint32_t>::is_always_lock_free,
+              "shared-memory atomics must not hide a lock");
+
+// One cache line per slot, so writers of neighbouring tables never share a line
+struct alignas(64) StateSlot {
+    atomic<uint32_t> sequence{0}; // Odd while a write is in progress
+    atomic<uint64_t> words[STATE_WORDS];
+};
+
+struct alignas(64) StateRegion {
+    uint64_t magic;
+    uint32_t slotCount;
+    atomic<uint32_t> changes{0}; // Futex word: bumped after every publish
+    atomic<uint32_t> sleepers{0}; // Readers blocked on changes
+    StateSlot slots[1];           // slotCount of them
+};
+
+namespace {
+
+size_t regionBytes(int slots) {
+    return sizeof(StateRegion) + (slots - 1) * sizeof(StateSlot);
+}
+
+// POSIX shared-memory names start with a slash
+string objectName(const string& name) {
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+}
+
+StatePublisher::~StatePublisher() {
+    if (region) {
+        munmap(region, bytes);
+        shm_unlink(name.c_str());
+    }
+}
+
+bool StatePublisher::open(const string& objectPath, int slotCount) {
+    name = objectName(objectPath);
+    bytes = regionBytes(slotCount);
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    void* memory = ftruncate(fd, bytes) == 0 ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                                             : MAP_FAILED;
+    close(fd);
+    if (memory == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+    region = new (memory) StateRegion();
+    for (int i = 1; i < slotCount; i++) {
+        new (&region->slots[i]) StateSlot();
+    }
+    region->slotCount = slotCount;
+    atomic_thread_fence(memory_order_release);
+    region->magic = STATE_MAGIC; // Last, so a reader never maps a half-built region as valid
+    return true;
+}
+
+int StatePublisher::slots() const {
+    return region ? region->slotCount : 0;
+}
+
+void StatePublisher::publish(int slot, const TableSnapshot& snapshot) {
+    uint64_t words[STATE_WORDS];
+    encode(snapshot, words);
+    StateSlot& target = region->slots[slot];
+    uint32_t sequence = target.sequence.load(memory_order_relaxed);
+    target.sequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release); // The odd sequence is visible before any new word
+    for (int i = 0; i < STATE_WORDS; i++) {
+        target.words[i].store(words[i], memory_order_relaxed);
+    }
+    target.sequence.store(sequence + 2, memory_order_release);
+
+    region->changes.fetch_add(1, memory_order_seq_cst);
+    if (region->sleepers.load(memory_order_seq_cst) > 0) {
+        syscall(SYS_futex, &region->changes, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
+
+StateReader::~StateReader() {
+    if (region) {
+        munmap(region, bytes);
+    }
+}
+
+bool StateReader::open(const string& objectPath) {
+    int fd = shm_open(objectName(objectPath).c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        return false;
+    }
+    // Mapped writable only so sleepers can be counted; readers never touch the slots
+    void* memory = mmap(nullptr, sizeof(StateRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    StateRegion* header = (StateRegion*) memory;
+    bool valid = header->magic == STATE_MAGIC;
+    int slotCount = header->slotCount;
+    munmap(memory, sizeof(StateRegion));
+    if (!valid) {
+        close(fd);
+        return false;
+    }
+    bytes = regionBytes(slotCount);
+    memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+    region = (StateRegion*) memory;
+    return true;
+}
+
+int StateReader::slots() const {
+    return region ? region->slotCount : 0;
+}
+
+void StateReader::read(int slot, TableSnapshot& snapshot, int* retries) const {
+    const StateSlot& source = region->slots[slot];
+    uint64_t words[STATE_WORDS];
+    for (int attempt = 0, spins = 0;; attempt++) {
+        uint32_t before;
+        while ((before = source.sequence.load(memory_order_acquire)) & 1) {
+            // Mid-write; only a writer preempted in the middle keeps us here long enough to yield
+            if (++spins % 1024 == 0) {
+                this_thread::yield();
+            }
+        }
+        for (int i = 0; i < STATE_WORDS; i++) {
+            words[i] = source.words[i].load(memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_acquire); // Every word is read before the sequence is checked again
+        if (source.sequence.load(memory_order_relaxed) == before) {
+            if (retries) {
+                *retries = attempt;
+            }
+            break;
+        }
+    }
+    decode(words, snapshot);
+}
+
+uint32_t StateReader::changes() const {
+    return region->changes.load(memory_order_acquire);
+}
+
+bool StateReader::waitForChange(uint32_t seen, int timeoutMs) const {
+    if (changes() != seen) {
+        return true;
+    }
+    timespec timeout = {timeoutMs / 1000, (timeoutMs % 1000) * 1000000L};
+    region->sleepers.fetch_add(1, memory_order_seq_cst);
+    // The kernel only sleeps if the word still equals seen, so a publish in between is never missed
+    if (region->changes.load(memory_order_seq_cst) == seen) {
+        syscall(SYS_futex, &region->changes, FUTEX_WAIT, seen, &timeout, nullptr, 0);
+    }
+    region->sleepers.fetch_sub(1, memory_order_seq_cst);
+    return changes() != seen;
+}
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+void printSnapshot(const TableSnapshot& snapshot) {
+    cout << "table " << snapshot.table << " turn " << snapshot.turn;
+    if (snapshot.state == Table::TABLE_FINISHED) {
+        cout << " over, leader " << snapshot.leader + 1;
+    } else {
+        cout << " seat " << snapshot.seat + 1;
+        if (snapshot.diceRoll) {
+            cout << " rolled " << snapshot.diceRoll;
+        }
+    }
+    cout << " |";
+    for (int p = 0; p < snapshot.numPlayers; p++) {
+        cout << " P" << p + 1 << ":";
+        for (int t = 0; t < 4; t++) {
+            int square = snapshot.squares[p][t];
+            cout << (t ? "," : "") << (square == HOME_POSITION ? "H" : square < 0 ? "NP" : to_string(square));
+        }
+    }
+    cout << "\n";
+}
+
+}
+
+int runStateBench(int argc, char** argv) {
+    int slots = 64, readers = 2;
+    double seconds = 3;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        if (option == "--slots") {
+            slots = stoi(argv[i + 1]);
+        } else if (option == "--readers") {
+            readers = stoi(argv[i + 1]);
+        } else if (option == "--seconds") {
+            seconds = stod(argv[i + 1]);
+        } else {
+            cout << "Usage: " << argv[0] << " state-bench [--slots N] [--readers R] [--seconds S]\n";
+            return 1;
+        }
+    }
+    if (slots < 1 || readers < 1 || seconds <= 0) {
+        cout << "Slots and readers must be at least 1 and the duration positive.\n";
+        return 1;
+    }
+
+    string name = "/ludo-state-bench-" + to_string(getpid());
+    StatePublisher publisher;
+    if (!publisher.open(name, slots)) {
+        cout << "Could not create shared memory " << name << "\n";
+        return 1;
+    }
+
+    // The writer plays random games at full speed, one table per slot, publishing after every move
+    atomic<bool> stop(false);
+    atomic<long long> published(0);
+    thread writer([&]() {
+        vector<Table> tables(slots);
+        RandomPolicy policy(1);
+        for (int s = 0; s < slots; s++) {
+            tables[s].start(4, gameSeed(1, s), DEFAULT_MAX_TURNS);
+        }
+        long long count = 0;
+        for (uint64_t games = slots; !stop;) {
+            for (int s = 0; s < slots; s++) {
+                Table& table = tables[s];
+                if (table.state == Table::TABLE_FINISHED) {
+                    table.start(4, gameSeed(1, games++), DEFAULT_MAX_TURNS);
+                } else {
+                    table.play(policy.chooseMove(table.players, table.seat, table.diceRoll, table.moves));
+                }
+                // The id repeats the turn, so a copy mixing two writes shows up as torn
+                publisher.publish(s, snapshotTable((uint64_t) table.turn << 16 | s, table));
+                count++;
+            }
+        }
+        published = count;
+    });
+
+    vector<LatencyHistogram> latency(readers);
+    vector<long long> reads(readers), retried(readers), torn(readers);
+    vector<thread> threads;
+    for (int r = 0; r < readers; r++) {
+        threads.push_back(thread([&, r]() {
+            StateReader reader; // Its own mapping, as a frontend process would have
+            if (!reader.open(name)) {
+                return;
+            }
+            TableSnapshot snapshot;
+            int slot = r % slots;
+            while (!stop) {
+                int retries;
+                auto started = Clock::now();
+                reader.read(slot, snapshot, &retries);
+                latency[r].record(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - started).count());
+                reads[r]++;
+                retried[r] += retries;
+                torn[r] += snapshot.numPlayers != 0 &&
+                           (snapshot.table != ((uint64_t) snapshot.turn << 16 | slot) ||
+                            (snapshot.state == Table::TABLE_WAITING && snapshot.moveCount < 2));
+                slot = (slot + 1) % slots;
+            }
+        }));
+    }
+
+    // One more reader sleeps on the futex and counts wake-ups
+    atomic<long long> wakeups(0);
+    thread sleeper([&]() {
+        StateReader reader;
+        if (!reader.open(name)) {
+            return;
+        }
+        uint32_t seen = reader.changes();
+        while (!stop) {
+            if (reader.waitForChange(seen, 100)) {
+                seen = reader.changes();
+                wakeups++;
+            }
+        }
+    });
+
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    stop = true;
+    writer.join();
+    sleeper.join();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    LatencyHistogram all;
+    long long totalReads = 0, totalRetries = 0, totalTorn = 0;
+    for (int r = 0; r < readers; r++) {
+        all.add(latency[r]);
+        totalReads += reads[r];
+        totalRetries += retried[r];
+        totalTorn += torn[r];
+    }
+    cout << fixed << setprecision(1) << "writer: " << (long long) (published / seconds) << " publishes/s over "
+         << slots << " slots\n"
+         << readers << " readers: " << (long long) (totalReads / seconds) << " snapshots/s, latency p50 "
+         << all.percentile(50) << " ns, p99 " << all.percentile(99) << " ns, p99.9 " << all.percentile(99.9)
+         << " ns, max " << all.max() << " ns (clock overhead included)\n"
+         << "retries " << totalRetries << " (" << (totalReads ? 100.0 * totalRetries / totalReads : 0)
+         << "% of reads), torn snapshots " << totalTorn << "\n"
+         << "futex sleeper woke " << (long long) (wakeups / seconds) << " times/s\n";
+    return totalTorn == 0 ? 0 : 1;
+}
+
+int runStateWatch(int argc, char** argv) {
+    if (argc < 3) {
+        cout << "Usage: " << argv[0] << " state-watch NAME\n"
+             << "Prints every table in the shared memory published as NAME (serve --publish or play --publish).\n";
+        return 1;
+    }
+    StateReader reader;
+    if (!reader.open(argv[2])) {
+        cout << "Nothing is published as " << argv[2] << "\n";
+        return 1;
+    }
+    vector<TableSnapshot> last(reader.slots());
+    uint32_t seen = reader.changes() - 1; // Print the current state first
+    while (true) {
+        if (!reader.waitForChange(seen, 1000)) {
+            continue;
+        }
+        seen = reader.changes();
+        for (int s = 0; s < reader.slots(); s++) {
+            TableSnapshot snapshot;
+            reader.read(s, snapshot);
+            if (snapshot.numPlayers > 0 && memcmp(&snapshot, &last[s], sizeof(snapshot)) != 0) {
+                printSnapshot(snapshot);
+                last[s] = snapshot;
+            }
+        }
+    }
+}
+
+#else
+
+StatePublisher::~StatePublisher() {}
+
+bool StatePublisher::open(const string& name, int slots) {
+    return false;
+}
+
+int StatePublisher::slots() const {
+    return 0;
+}
+
+void StatePublisher::publish(int slot, const TableSnapshot& snapshot) {}
+
+int runStateBench(int argc, char** argv) {
+    cout << "state-bench needs futexes, which are only available on Linux.\n";
+    return 1;
+}
+
+int runStateWatch(int argc, char** argv) {
+    cout << "state-watch needs futexes, which are only available on Linux.\n";
+    return 1;
+}
+
+#endif
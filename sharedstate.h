@@ -0,0 +1,86 @@
+#ifndef SHAREDSTATE_H
+#define SHAREDSTATE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "table.h"
+
+// Table state published into a POSIX shared-memory object for local frontends (GUIs, overlays),
+// so they no longer scrape displayBoard output. Each table owns one slot guarded by a seqlock:
+// the engine writes the slot in place with plain stores between two sequence bumps, and readers
+// in any process copy it out and retry if the sequence moved, without a system call.
+// A region-wide change counter doubles as a futex, so readers can also sleep until something changes.
+
+const int STATE_MAX_MOVES = 4;
+
+// One table as readers see it
+struct TableSnapshot {
+    uint64_t table = 0;
+    int numPlayers = 0;
+    int seat = 0;           // Seat to move
+    int chances = 0;
+    int diceRoll = 0;       // Roll waiting for a choice, 0 if none
+    int state = Table::TABLE_IDLE;
+    int leader = -1;        // Winner or leading seat once the game is over
+    int turn = 0;
+    int8_t squares[4][4] = {}; // Board square per token, -1 off the board, HOME_POSITION when home
+    int moveCount = 0;
+    int8_t moves[STATE_MAX_MOVES] = {}; // Pending choices, as returned by legalMoves
+};
+
+TableSnapshot snapshotTable(uint64_t id, const Table& table);
+TableSnapshot snapshotPlayers(uint64_t id, const vector<Player>& players, int seat, int turn);
+
+struct StateRegion;
+struct StateSlot;
+
+// Creates the shared-memory object and writes into it. Each slot must only ever have one writer
+// thread at a time; the object is removed again when the publisher goes away.
+class StatePublisher {
+public:
+    ~StatePublisher();
+
+    bool open(const string& name, int slots);
+    int slots() const;
+
+    // Overwrites slot and wakes sleeping readers; no system call unless some reader is asleep
+    void publish(int slot, const TableSnapshot& snapshot);
+
+private:
+    string name;
+    StateRegion* region = nullptr;
+    size_t bytes = 0;
+};
+
+// Maps an existing object; of the region, readers only ever write the sleeper count
+class StateReader {
+public:
+    ~StateReader();
+
+    bool open(const string& name);
+    int slots() const;
+
+    // Consistent copy of slot; retries counts the copies thrown away because a write overlapped
+    void read(int slot, TableSnapshot& snapshot, int* retries = nullptr) const;
+
+    // Total publishes so far
+    uint32_t changes() const;
+
+    // Sleeps until changes() differs from seen, or timeoutMs passes; false on timeout
+    bool waitForChange(uint32_t seen, int timeoutMs) const;
+
+private:
+    StateRegion* region = nullptr;
+    size_t bytes = 0;
+};
+
+// "state-bench" command: a writer plays games at full speed into shared memory while reader
+// threads, each with its own mapping, measure snapshot latency and retries
+int runStateBench(int argc, char** argv);
+
+// "state-watch" command: prints every table that changes in a published region
+int runStateWatch(int argc, char** argv);
+
+#endif
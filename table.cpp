@@ -0,0 +1,158 @@
+#include "table.h"
+#include "trace.h"
+
+void Table::start(int numPlayers, uint64_t seed, int turnLimit) {
+    // A table dealt again keeps its players' storage
+    players.resize(min<size_t>(players.size(), numPlayers), Player(0, 0));
+    for (int i = 0; i < numPlayers; i++) {
+        if (i < players.size()) {
+            players[i].reset(i);
+        } else {
+            players.push_back(Player(i));
+        }
+    }
+    dice = Dice(seed);
+    seat = chooseStartingPlayer(dice, numPlayers);
+    chances = 0;
+    turn = 0;
+    maxTurns = turnLimit;
+    winner = -1;
+    state = TABLE_WAITING;
+    if (timeline) {
+        timeline->start(players, seat, turn, dice);
+        timeline->reserve(maxTurns);
+    }
+    advance();
+}
+
+bool Table::play(int move) {
+    if (state != TABLE_WAITING || find(moves.begin(), moves.end(), move) == moves.end()) {
+        return false;
+    }
+    apply(move);
+    endRoll();
+    advance();
+    return true;
+}
+
+bool Table::rewind(int to) {
+    if (!timeline || to < timeline->first() || to > timeline->last()) {
+        return false;
+    }
+    GameTimeline::Frame frame;
+    timeline->at(to, frame);
+    GameTimeline::restore(frame, players);
+    seat = frame.seat;
+    chances = 0;
+    turn = frame.turn;
+    dice.state = frame.dice;
+    winner = -1;
+    state = TABLE_WAITING;
+    for (int p = 0; p < players.size(); p++) {
+        if (players[p].allTokensInHome()) {
+            winner = p;
+            state = TABLE_FINISHED;
+        }
+    }
+    timeline->truncate(to);
+    advance();
+    return true;
+}
+
+int Table::leader() const {
+    return winner >= 0 ? winner : leadingPlayer(players);
+}
+
+uint64_t Table::hash() const {
+    uint64_t digest = 0xCBF29CE484222325ULL; // FNV-1a
+    auto mix = [&](uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            digest = (digest ^ ((value >> (i * 8)) & 0xFF)) * 0x100000001B3ULL;
+        }
+    };
+    for (const auto& player : players) {
+        for (const auto& token : player.tokens) {
+            mix(token.inPlay ? token.position : -1);
+        }
+    }
+    mix(seat);
+    mix(chances);
+    mix(turn);
+    mix(dice.state);
+    return digest;
+}
+
+size_t Table::memoryBytes() const {
+    size_t bytes = sizeof(*this) + players.capacity() * sizeof(Player) + moves.capacity() * sizeof(int);
+    for (const auto& player : players) {
+        bytes += player.tokens.capacity() * sizeof(Token);
+    }
+    return bytes;
+}
+
+void Table::advance() {
+    while (state == TABLE_WAITING) {
+        if (turn >= maxTurns) {
+            state = TABLE_FINISHED;
+            break;
+        }
+        TraceSpan span("roll");
+        diceRoll = dice.roll();
+        span.arg = diceRoll;
+        legalMoves(players[seat], diceRoll, moves);
+        if (moves.size() > 1) {
+            return; // A real choice: wait for play()
+        }
+        if (moves.size() == 1) {
+            apply(moves[0]);
+        }
+        endRoll();
+    }
+    moves.clear();
+}
+
+void Table::apply(int move) {
+    Player& player = players[seat];
+    if (!events) {
+        applyMove(player, move, diceRoll, board);
+        return;
+    }
+    int tokenIndex = move;
+    if (move == ENTER_TOKEN) {
+        for (int i = 0; i < player.tokens.size(); i++) {
+            if (!player.tokens[i].inPlay) {
+                tokenIndex = i;
+                break;
+            }
+        }
+    }
+    GameEvent event;
+    event.turn = turn;
+    event.seat = seat;
+    event.type = move == ENTER_TOKEN ? EVENT_ENTER : EVENT_MOVE;
+    event.token = tokenIndex;
+    event.dice = diceRoll;
+    event.from = player.tokens[tokenIndex].position;
+    applyMove(player, move, diceRoll, board);
+    event.to = player.tokens[tokenIndex].position;
+    events->push_back(event);
+}
+
+void Table::endRoll() {
+    chances++;
+    if (diceRoll == 6 && chances < MAX_CHANCES) {
+        return; // Same seat rolls again
+    }
+    METRIC_TURN(chances);
+    turn++;
+    chances = 0;
+    if (timeline) {
+        timeline->record(players, dice);
+    }
+    if (players[seat].allTokensInHome()) {
+        winner = seat;
+        state = TABLE_FINISHED;
+        return;
+    }
+    seat = (seat + 1) % players.size();
+}
@@ -0,0 +1,55 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include "selfplay.h"
+#include "timeline.h"
+
+// One game as a resumable state machine instead of a blocking loop: advance() plays every
+// forced roll and returns as soon as a seat has to choose between moves (or the game is over),
+// so whoever hosts the table can wait for that choice without holding a thread.
+// Dice draws and turn order are the same as playHeadlessGame, so a seed replays identically.
+class Table {
+public:
+    enum State { TABLE_IDLE, TABLE_WAITING, TABLE_FINISHED };
+
+    State state = TABLE_IDLE;
+    vector<Player> players;
+    Board board;
+    Dice dice;
+    int seat = 0;       // Seat to move
+    int chances = 0;    // Rolls that seat already used this turn
+    int turn = 0;
+    int maxTurns = DEFAULT_MAX_TURNS;
+    int diceRoll = 0;   // Roll waiting for a choice while state is TABLE_WAITING
+    vector<int> moves;  // Legal choices for that roll, as returned by legalMoves
+    int winner = -1;
+    vector<GameEvent>* events = nullptr; // When set, every applied move is appended here
+    GameTimeline* timeline = nullptr;    // When set, started at the deal and given every turn played
+
+    // Deals a new game and advances to the first decision
+    void start(int numPlayers, uint64_t seed, int maxTurns);
+
+    // Applies one of the pending moves and advances to the next decision; false if move is not legal
+    bool play(int move);
+
+    // Undo: back to the position after turn (from the timeline), the later turns forgotten, then
+    // on to the next decision with the same dice as before; false without a timeline or that turn
+    bool rewind(int turn);
+
+    // Winner, or the seat furthest along once the turn limit ends the game
+    int leader() const;
+
+    // Digest of everything that decides future play (tokens, seat, chances, turn, dice stream),
+    // so copies kept in step on different machines can be compared cheaply
+    uint64_t hash() const;
+
+    // Heap and object bytes held by this table
+    size_t memoryBytes() const;
+
+private:
+    void advance();
+    void apply(int move);
+    void endRoll();
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include "timeline.h"
+
+#include <chrono>
+#include <string>
+
+#include "table.h"
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+const int UNDO_CHECKS = 16; // Rewinds per game replayed to the end
+
+const uint64_t DICE_STEP = 0x9E3779B97F4A7C15ULL; // What Dice::next adds to its state
+
+// Inverse of DICE_STEP modulo 2^64 (Newton's iteration; the step is odd), so the number of draws
+// between two dice states is their difference times this
+uint64_t inverseStep() {
+    uint64_t inverse = DICE_STEP;
+    for (int i = 0; i < 6; i++) {
+        inverse *= 2 - DICE_STEP * inverse;
+    }
+    return inverse;
+}
+
+const uint64_t DICE_STEP_INVERSE = inverseStep();
+
+int8_t squareOf(const Token& token) {
+    return token.hasWon() ? HOME_POSITION : token.inPlay ? token.position : -1;
+}
+
+double nanosSince(Clock::time_point started) {
+    return chrono::duration<double, nano>(Clock::now() - started).count();
+}
+
+// Heap and object bytes of one copy of the players, leaving out the allocator's own headers
+size_t playersBytes(const vector<Player>& players) {
+    size_t bytes = sizeof(players) + players.capacity() * sizeof(Player);
+    for (const auto& player : players) {
+        bytes += player.tokens.capacity() * sizeof(Token);
+    }
+    return bytes;
+}
+
+void frameOf(const vector<Player>& players, int seat, int turn, uint64_t dice, GameTimeline::Frame& frame) {
+    frame.numPlayers = players.size();
+    frame.seat = seat;
+    frame.turn = turn;
+    frame.dice = dice;
+    for (int p = 0; p < frame.numPlayers; p++) {
+        for (int t = 0; t < 4; t++) {
+            frame.squares[p][t] = t < players[p].tokens.size() ? squareOf(players[p].tokens[t]) : -1;
+        }
+    }
+}
+
+bool sameFrame(const GameTimeline::Frame& a, const GameTimeline::Frame& b) {
+    if (a.numPlayers != b.numPlayers || a.seat != b.seat || a.turn != b.turn || a.dice != b.dice) {
+        return false;
+    }
+    for (int p = 0; p < a.numPlayers; p++) {
+        for (int t = 0; t < 4; t++) {
+            if (a.squares[p][t] != b.squares[p][t]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}
+
+void GameTimeline::start(const vector<Player>& players, int seat, int turn, const Dice& dice) {
+    numPlayers = players.size();
+    firstSeat = seat;
+    firstTurn = turn;
+    firstDice = dice.state;
+    for (int p = 0; p < numPlayers; p++) {
+        for (int t = 0; t < 4; t++) {
+            dealt[p][t] = t < players[p].tokens.size() ? squareOf(players[p].tokens[t]) : -1;
+        }
+    }
+    turns.clear();
+    checkpoints.assign(1, 0);
+}
+
+void GameTimeline::reserve(int count) {
+    turns.reserve(turns.size() + count);
+    checkpoints.reserve(checkpoints.size() + count / CHECKPOINT_TURNS + 1);
+}
+
+void GameTimeline::record(const vector<Player>& players, const Dice& dice) {
+    int index = turns.size() + 1;
+    const Player& mover = players[(firstSeat + index - 1) % numPlayers];
+    uint64_t draws = (dice.state - firstDice) * DICE_STEP_INVERSE;
+    Turn turn;
+    for (int t = 0; t < 4; t++) {
+        turn.squares[t] = t < mover.tokens.size() ? squareOf(mover.tokens[t]) : -1;
+    }
+    turn.draws = (uint8_t) draws;
+    turns.push_back(turn);
+    if (index % CHECKPOINT_TURNS == 0) {
+        checkpoints.push_back(draws);
+    }
+}
+
+uint64_t GameTimeline::drawsAt(int index) const {
+    uint32_t base = checkpoints[index / CHECKPOINT_TURNS];
+    if (index % CHECKPOINT_TURNS == 0) {
+        return base;
+    }
+    // Fewer than 256 draws separate a turn from its checkpoint, so the low byte is enough
+    return base + (uint8_t) (turns[index - 1].draws - (uint8_t) base);
+}
+
+void GameTimeline::at(int turn, Frame& frame) const {
+    int index = turn - firstTurn;
+    frame.numPlayers = numPlayers;
+    frame.seat = (firstSeat + index) % numPlayers;
+    frame.turn = turn;
+    frame.dice = firstDice + drawsAt(index) * DICE_STEP;
+    for (int p = 0; p < numPlayers; p++) {
+        // The last turn, up to index, that seat p moved in
+        int moved = index - ((firstSeat + index - 1 - p) % numPlayers + numPlayers) % numPlayers;
+        const int8_t* squares = moved >= 1 ? turns[moved - 1].squares : dealt[p];
+        for (int t = 0; t < 4; t++) {
+            frame.squares[p][t] = squares[t];
+        }
+    }
+}
+
+void GameTimeline::restore(const Frame& frame, vector<Player>& players) {
+    players.resize(min<size_t>(players.size(), frame.numPlayers), Player(0, 0));
+    for (int p = 0; p < frame.numPlayers; p++) {
+        if (p < players.size()) {
+            players[p].reset(p);
+        } else {
+            players.push_back(Player(p));
+        }
+        for (int t = 0; t < 4; t++) {
+            Token& token = players[p].tokens[t];
+            token.inPlay = frame.squares[p][t] >= 0;
+            token.position = frame.squares[p][t];
+        }
+    }
+}
+
+void GameTimeline::truncate(int turn) {
+    int index = max(0, turn - firstTurn);
+    if (index < (int) turns.size()) {
+        turns.resize(index);
+        checkpoints.resize(index / CHECKPOINT_TURNS + 1);
+    }
+}
+
+size_t GameTimeline::memoryBytes() const {
+    return sizeof(*this) + turns.capacity() * sizeof(Turn) + checkpoints.capacity() * sizeof(uint32_t);
+}
+
+int runTimelineBench(int argc, char** argv) {
+    int games = 3, turnCount = 10000, reads = 1000000;
+    uint64_t seed = 1;
+    for (int i = 2; i < argc; i += 2) {
+        string option = argv[i];
+        if (i + 1 >= argc) {
+            cout << "Usage: " << argv[0] << " timeline-bench [--games N] [--turns T] [--reads R] [--seed S]\n";
+            return 1;
+        }
+        if (option == "--games") {
+            games = stoi(argv[i + 1]);
+        } else if (option == "--turns") {
+            turnCount = stoi(argv[i + 1]);
+        } else if (option == "--reads") {
+            reads = stoi(argv[i + 1]);
+        } else if (option == "--seed") {
+            seed = stoull(argv[i + 1]);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (games < 1 || turnCount < 1 || reads < 1) {
+        cout << "Games, turns and reads must be positive.\n";
+        return 1;
+    }
+
+    double timelineRecord = 0, copyRecord = 0, timelineRead = 0, copyRead = 0, timelineRestore = 0, copyRestore = 0;
+    size_t timelineBytes = 0, copyBytes = 0;
+    long long mismatches = 0;
+    uint64_t checksum = 0;
+    for (int g = 0; g < games; g++) {
+        // Play the game first, keeping every position, so the timings below see only the histories
+        Dice dice(gameSeed(seed, g));
+        RandomPolicy policy(gameSeed(seed, g) ^ 1);
+        Board board;
+        vector<Player> players = {Player(0), Player(1), Player(2), Player(3)};
+        int firstSeat = chooseStartingPlayer(dice, 4);
+        vector<vector<Player>> positions = {players};
+        vector<uint64_t> diceStates = {dice.state};
+        GameTimeline timeline;
+        timeline.start(players, firstSeat, 0, dice);
+        timeline.reserve(turnCount);
+        for (int turn = 0; turn < turnCount; turn++) {
+            playHeadlessTurn(players, (firstSeat + turn) % 4, board, dice, policy, turn, nullptr);
+            positions.push_back(players);
+            diceStates.push_back(dice.state);
+        }
+
+        auto started = Clock::now();
+        Dice at;
+        for (int turn = 1; turn <= turnCount; turn++) {
+            at.state = diceStates[turn];
+            timeline.record(positions[turn], at);
+        }
+        timelineRecord += nanosSince(started);
+        timelineBytes += timeline.memoryBytes();
+
+        started = Clock::now();
+        vector<vector<Player>> copies;
+        for (int turn = 0; turn <= turnCount; turn++) {
+            copies.push_back(positions[turn]);
+        }
+        copyRecord += nanosSince(started);
+        copyBytes += sizeof(copies) + copies.capacity() * sizeof(vector<Player>);
+        for (const auto& copy : copies) {
+            copyBytes += playersBytes(copy) - sizeof(copy);
+        }
+
+        GameTimeline::Frame frame, expected;
+        for (int turn = 0; turn <= turnCount; turn++) {
+            timeline.at(turn, frame);
+            frameOf(positions[turn], (firstSeat + turn) % 4, turn, diceStates[turn], expected);
+            mismatches += !sameFrame(frame, expected);
+        }
+
+        vector<int> picks(reads);
+        Dice pick(seed + g);
+        for (auto& turn : picks) {
+            turn = pick.next() % (turnCount + 1);
+        }
+        started = Clock::now();
+        for (int turn : picks) {
+            timeline.at(turn, frame);
+            checksum += frame.squares[turn & 3][0] + frame.dice;
+        }
+        timelineRead += nanosSince(started);
+        started = Clock::now();
+        for (int turn : picks) {
+            frameOf(copies[turn], (firstSeat + turn) % 4, turn, diceStates[turn], frame);
+            checksum += frame.squares[turn & 3][0] + frame.dice;
+        }
+        copyRead += nanosSince(started);
+
+        // Rewinding a live game: the players back as they stood, storage reused
+        vector<Player> restored = players;
+        started = Clock::now();
+        for (int turn : picks) {
+            timeline.at(turn, frame);
+            GameTimeline::restore(frame, restored);
+            checksum += restored[turn & 3].tokens[0].position;
+        }
+        timelineRestore += nanosSince(started);
+        started = Clock::now();
+        for (int turn : picks) {
+            restored = copies[turn];
+            checksum += restored[turn & 3].tokens[0].position;
+        }
+        copyRestore += nanosSince(started);
+
+        // Undo on a table: rewound to any turn, the same choices must lead to the same ending
+        Table table;
+        GameTimeline history;
+        table.timeline = &history;
+        auto finish = [&]() {
+            while (table.state == Table::TABLE_WAITING) {
+                table.play(table.moves[(table.turn * 31 + table.chances) % table.moves.size()]);
+            }
+            return table.hash();
+        };
+        table.start(4, gameSeed(seed, g), turnCount);
+        uint64_t ending = finish();
+        for (int r = 0; r < UNDO_CHECKS && r < reads; r++) {
+            table.rewind(picks[r]);
+            mismatches += finish() != ending;
+        }
+    }
+
+    double turns = (double) games * turnCount, lookups = (double) games * reads;
+    cout << games << " games of " << turnCount << " turns, " << reads << " random reads each\n"
+         << "  timeline:        " << timelineBytes / turns << " bytes/turn, record " << timelineRecord / turns
+         << " ns/turn, read " << timelineRead / lookups << " ns, rewind players " << timelineRestore / lookups
+         << " ns\n"
+         << "  vector<Player>:  " << copyBytes / turns << " bytes/turn (5 allocations), copy " << copyRecord / turns
+         << " ns/turn, read " << copyRead / lookups << " ns, rewind players " << copyRestore / lookups << " ns\n"
+         << "  " << mismatches << " positions differ from the copies or replay differently after a rewind (checksum "
+         << checksum % 1000 << ")\n";
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "ludo.h"
+
+using namespace std;
+
+// Every position of a game at a turn boundary, for review and undo. Seats move in turn order
+// and a turn changes only the mover's tokens, so each turn keeps just those (4 squares and the
+// low byte of the dice draws, 5 bytes) and shares every other seat's tokens with the turns
+// before it: the position after turn t is, for each seat, the record of the last turn that seat
+// moved, found by arithmetic. Reading any turn, and rewinding to it, are O(1).
+class GameTimeline {
+public:
+    static const int CHECKPOINT_TURNS = 64; // Full dice draw counts, so the byte per turn cannot wrap unseen
+
+    // Position at a turn boundary as stored: squares as in TableSnapshot
+    struct Frame {
+        int numPlayers = 0;
+        int seat = 0;          // To move next
+        int turn = 0;
+        uint64_t dice = 0;     // Dice::state
+        int8_t squares[4][4] = {}; // -1 off the board, HOME_POSITION when home
+    };
+
+    // Begins a new history at a turn boundary: seat is about to roll, turn turns have been played
+    void start(const vector<Player>& players, int seat, int turn, const Dice& dice);
+
+    // Room for turns more turns, so recording them never reallocates
+    void reserve(int turns);
+
+    // Appends the turn that has just ended, after which players and dice stand as given
+    void record(const vector<Player>& players, const Dice& dice);
+
+    // Turns recorded since start; turns first() to last() can be read
+    int first() const { return firstTurn; }
+    int last() const { return firstTurn + (int) turns.size(); }
+
+    // Position after turn (first() to last())
+    void at(int turn, Frame& frame) const;
+
+    // Players standing as in frame, reusing players' storage
+    static void restore(const Frame& frame, vector<Player>& players);
+
+    // Forgets every turn after turn, so recording continues from there
+    void truncate(int turn);
+
+    // Heap and object bytes held
+    size_t memoryBytes() const;
+
+private:
+#pragma pack(push, 1)
+    struct Turn {
+        int8_t squares[4]; // The mover's tokens after the turn
+        uint8_t draws;     // Dice draws since start, low 8 bits
+    };
+#pragma pack(pop)
+
+    int numPlayers = 0;
+    int firstSeat = 0;
+    int firstTurn = 0;
+    uint64_t firstDice = 0;
+    int8_t dealt[4][4] = {};  // Every seat's tokens at start
+    vector<Turn> turns;
+    vector<uint32_t> checkpoints; // Draws before turn firstTurn + k * CHECKPOINT_TURNS
+
+    uint64_t drawsAt(int index) const;
+};
+
+// "timeline-bench" command: records 10k-turn games, then compares reading past turns from the
+// timeline with keeping a copy of vector<Player> per turn
+int runTimelineBench(int argc, char** argv);
+
+#endif
@@ -0,0 +1,296 @@
+#include "tournament.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+
+#include "trace.h"
+
+namespace {
+
+const int MAX_ROTATIONS = 6;
+
+// Games per deal. The bots alternate round the table and every deal is also played with them
+// swapped; with an odd player count one bot holds an extra seat, so the pattern is also turned
+// through every seat to give each bot each seat equally often.
+int rotationsFor(int numPlayers) {
+    return numPlayers % 2 ? 2 * numPlayers : 2;
+}
+
+// Whether bot a holds seat in the given rotation
+bool seatOfA(int seat, int rotation, int numPlayers) {
+    return ((seat + rotation / 2) % numPlayers % 2 == 0) != (rotation % 2 == 1);
+}
+
+struct SprtSettings {
+    double elo0 = 0;
+    double elo1 = 5;
+    double alpha = 0.05;
+    double beta = 0.05;
+};
+
+double eloToScore(double elo) {
+    return 1 / (1 + pow(10, -elo / 400));
+}
+
+double scoreToElo(double score) {
+    score = min(max(score, 1e-6), 1 - 1e-6);
+    return -400 * log10(1 / score - 1);
+}
+
+// One bot-vs-bot match; a "deal" is one dice seed played once per seat rotation
+struct Pairing {
+    int a = 0;
+    int b = 0;
+    int rotations = 2;
+    atomic<long long> nextDeal{0};
+    atomic<bool> decided{false};
+    mutex lock;                                     // Guards the counts, so none move after the decision
+    long long dealsWithWins[MAX_ROTATIONS + 1] = {}; // Deals in which a won 0..rotations games
+    long long discarded = 0;                        // Deals still being played when the test decided
+    string verdict;
+    double decisionSeconds = 0;
+
+    long long deals() const {
+        long long total = 0;
+        for (int k = 0; k <= rotations; k++) {
+            total += dealsWithWins[k];
+        }
+        return total;
+    }
+
+    // Mean score of a per deal and the variance of that per-deal score
+    void score(double& mean, double& variance) const {
+        long long total = 0;
+        double sum = 0;
+        for (int k = 0; k <= rotations; k++) {
+            total += dealsWithWins[k];
+            sum += dealsWithWins[k] * (k / (double) rotations);
+        }
+        mean = total ? sum / total : 0.5;
+        variance = 0;
+        for (int k = 0; k <= rotations; k++) {
+            double x = k / (double) rotations - mean;
+            variance += total ? dealsWithWins[k] * x * x / total : 0;
+        }
+    }
+
+    // Generalized SPRT log-likelihood ratio (normal approximation over deal scores)
+    double llr(const SprtSettings& sprt) const {
+        double mean, variance;
+        score(mean, variance);
+        if (variance <= 0) {
+            return 0;
+        }
+        double s0 = eloToScore(sprt.elo0), s1 = eloToScore(sprt.elo1);
+        return deals() * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+    }
+};
+
+// Plays every seat rotation of one deal and returns how many games a won
+int playDeal(const BotSpec& a, const BotSpec& b, int numPlayers, int maxTurns, uint64_t seedOfDeal) {
+    int wins = 0;
+    for (int rotation = 0; rotation < rotationsFor(numPlayers); rotation++) {
+        vector<unique_ptr<Policy>> owned;
+        vector<Policy*> policies;
+        for (int seat = 0; seat < numPlayers; seat++) {
+            const BotSpec& spec = seatOfA(seat, rotation, numPlayers) ? a : b;
+            owned.push_back(spec.create(seedOfDeal ^ (seat + 1)));
+            policies.push_back(owned.back().get());
+        }
+        GameRecord record = playHeadlessGame(numPlayers, seedOfDeal, maxTurns, policies);
+        if (seatOfA(record.header.leader, rotation, numPlayers)) {
+            wins++;
+        }
+    }
+    return wins;
+}
+
+}
+
+int runTournament(int argc, char** argv) {
+    vector<BotSpec> bots;
+    bool gauntlet = false;
+    int numPlayers = 2;
+    int maxTurns = DEFAULT_MAX_TURNS;
+    int threadCount = max(1u, thread::hardware_concurrency());
+    long long maxDeals = 20000;
+    uint64_t seed = 1;
+    SprtSettings sprt;
+    string tracePath;
+    int traceSampleEvery = 1000;
+    for (int i = 2; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--gauntlet") {
+            gauntlet = true;
+            continue;
+        }
+        if (option.rfind("--", 0) == 0) {
+            if (i + 1 >= argc) {
+                cout << "Missing value for " << option << "\n";
+                return 1;
+            }
+            string value = argv[++i];
+            if (option == "--players") {
+                numPlayers = stoi(value);
+            } else if (option == "--max-turns") {
+                maxTurns = stoi(value);
+            } else if (option == "--threads") {
+                threadCount = stoi(value);
+            } else if (option == "--max-deals") {
+                maxDeals = stoll(value);
+            } else if (option == "--seed") {
+                seed = stoull(value);
+            } else if (option == "--elo0") {
+                sprt.elo0 = stod(value);
+            } else if (option == "--elo1") {
+                sprt.elo1 = stod(value);
+            } else if (option == "--alpha") {
+                sprt.alpha = stod(value);
+            } else if (option == "--beta") {
+                sprt.beta = stod(value);
+            } else if (option == "--trace") {
+                tracePath = value;
+            } else if (option == "--trace-sample") {
+                traceSampleEvery = stoi(value);
+            } else {
+                cout << "Unknown option " << option << "\n";
+                return 1;
+            }
+            continue;
+        }
+        bots.push_back(BotSpec());
+        if (!bots.back().load(option)) {
+            return 1;
+        }
+    }
+    if (bots.size() < 2) {
+        cout << "Usage: " << argv[0] << " tournament BOT BOT [BOT...] [--gauntlet] [--players N] [--max-turns T]\n"
+             << "       [--threads K] [--max-deals D] [--seed S] [--elo0 E] [--elo1 E] [--alpha A] [--beta B]\n"
+             << "       [--trace FILE] [--trace-sample N]\n"
+             << "BOT is random, heuristic[:WEIGHTS], search[:ROLLOUTS] (rollout search, 2000 rollouts per\n"
+             << "choice by default), engine:COMMAND (an external program speaking the engine protocol, one\n"
+             << "process per seat) or a network weights file. --gauntlet plays the first bot against each of\n"
+             << "the others instead of every pair. --trace writes a Chrome trace of one game in every N\n"
+             << "(default 1000).\n";
+        return 1;
+    }
+    if (numPlayers < 2 || numPlayers > 4 || maxTurns < 1 || maxTurns > 65535 || threadCount < 1 || maxDeals < 1 ||
+        sprt.elo1 <= sprt.elo0 || traceSampleEvery < 1) {
+        cout << "Players must be 2-4, the turn limit 1-65535, threads, deals and trace sampling at least 1,\n"
+             << "elo1 above elo0.\n";
+        return 1;
+    }
+    if (!tracePath.empty() && !startTracing(tracePath, traceSampleEvery)) {
+        return 1;
+    }
+
+    vector<unique_ptr<Pairing>> pairings;
+    for (int a = 0; a < bots.size(); a++) {
+        for (int b = a + 1; b < bots.size(); b++) {
+            if (gauntlet && a != 0) {
+                continue;
+            }
+            pairings.push_back(unique_ptr<Pairing>(new Pairing()));
+            pairings.back()->a = a;
+            pairings.back()->b = b;
+            pairings.back()->rotations = rotationsFor(numPlayers);
+        }
+    }
+
+    double lower = log(sprt.beta / (1 - sprt.alpha));
+    double upper = log((1 - sprt.beta) / sprt.alpha);
+    auto started = chrono::steady_clock::now();
+    atomic<long long> cursor(0);
+    atomic<int> open(pairings.size());
+    vector<thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.push_back(thread([&]() {
+            while (open > 0) {
+                // Spread the workers over the pairings that are still undecided
+                Pairing* pairing = nullptr;
+                for (int tries = 0; tries < pairings.size() && !pairing; tries++) {
+                    Pairing* candidate = pairings[cursor++ % pairings.size()].get();
+                    if (!candidate->decided) {
+                        pairing = candidate;
+                    }
+                }
+                if (!pairing) {
+                    break;
+                }
+
+                long long deal = pairing->nextDeal++;
+                int wins = deal < maxDeals ? playDeal(bots[pairing->a], bots[pairing->b], numPlayers, maxTurns,
+                                                      gameSeed(seed, deal))
+                                           : -1;
+                // The test stops where it decides: deals finishing after that are not counted
+                lock_guard<mutex> guard(pairing->lock);
+                if (pairing->decided) {
+                    pairing->discarded += wins >= 0;
+                    continue;
+                }
+                string verdict;
+                if (wins >= 0) {
+                    pairing->dealsWithWins[wins]++;
+                    double ratio = pairing->llr(sprt);
+                    if (ratio >= upper) {
+                        verdict = "H1 accepted (stronger by >= elo1)";
+                    } else if (ratio <= lower) {
+                        verdict = "H0 accepted (not stronger than elo0)";
+                    }
+                } else {
+                    verdict = "inconclusive (deal limit reached)";
+                }
+                if (!verdict.empty()) {
+                    pairing->decided = true;
+                    pairing->verdict = verdict;
+                    pairing->decisionSeconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+                    open--;
+                }
+            }
+        }));
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    stopTracing();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+    // Pairing results: a's Elo over b with a 95% interval from the deal-score variance
+    vector<double> totalScore(bots.size(), 0);
+    vector<long long> totalDeals(bots.size(), 0);
+    cout << fixed << setprecision(1);
+    for (const auto& pairing : pairings) {
+        double mean, variance;
+        pairing->score(mean, variance);
+        long long deals = pairing->deals();
+        double margin = deals ? 1.96 * sqrt(variance / deals) : 0;
+        double elo = scoreToElo(mean);
+        cout << bots[pairing->a].name << " vs " << bots[pairing->b].name << ": " << deals * pairing->rotations << " games, score "
+             << mean * 100 << "%, Elo " << elo << " [" << scoreToElo(mean - margin) << ", "
+             << scoreToElo(mean + margin) << "], LLR " << setprecision(2) << pairing->llr(sprt) << " ("
+             << lower << ", " << upper << ")" << setprecision(1) << ", " << pairing->verdict << " after "
+             << setprecision(2) << pairing->decisionSeconds << " s" << setprecision(1);
+        if (pairing->discarded) {
+            cout << " (" << pairing->discarded << " deals finished after it not counted)";
+        }
+        cout << "\n";
+        totalScore[pairing->a] += mean * deals;
+        totalScore[pairing->b] += (1 - mean) * deals;
+        totalDeals[pairing->a] += deals;
+        totalDeals[pairing->b] += deals;
+    }
+
+    cout << "\nElo against the field:\n";
+    for (int i = 0; i < bots.size(); i++) {
+        double mean = totalDeals[i] ? totalScore[i] / totalDeals[i] : 0.5;
+        double margin = totalDeals[i] ? 1.96 * sqrt(mean * (1 - mean) / (totalDeals[i] * rotationsFor(numPlayers))) : 0;
+        cout << "  " << bots[i].name << ": " << scoreToElo(mean) << " +/- "
+             << (scoreToElo(mean + margin) - scoreToElo(mean - margin)) / 2 << "\n";
+    }
+    cout << "Wall-clock " << setprecision(2) << elapsed << " s on " << threadCount << " threads\n";
+    return 0;
+}
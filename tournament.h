@@ -0,0 +1,10 @@
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+
+#include "bots.h"
+
+// "tournament" command: round-robin or gauntlet between bots on every core, duplicate dice per
+// seat rotation, each pairing stopped by a sequential probability ratio test
+int runTournament(int argc, char** argv);
+
+#endif
@@ -0,0 +1,194 @@
+#include "trace.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+thread_local bool traceActive = false;
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+const int RING_SIZE = 1 << 14; // Spans a thread may record between two drains before dropping
+const int DRAIN_MS = 20;
+
+struct TraceRing {
+    TraceEvent events[RING_SIZE];
+    atomic<uint64_t> head{0}; // Written by the owning thread only
+    atomic<uint64_t> tail{0}; // Written by the drain only
+    atomic<uint64_t> dropped{0};
+    atomic<bool> inUse{false};
+    int tid = 0;
+    TraceRing* next = nullptr;
+};
+
+// Rings are never freed; one whose thread exited goes to the next thread that traces
+atomic<TraceRing*> rings{nullptr};
+atomic<int> ringCount{0};
+thread_local TraceRing* currentRing = nullptr;
+
+struct RingRelease {
+    ~RingRelease() {
+        if (currentRing) {
+            currentRing->inUse.store(false, memory_order_release);
+            currentRing = nullptr;
+        }
+    }
+};
+
+mutex control; // Serializes start and stop
+mutex sleepLock;
+condition_variable wake;
+atomic<bool> running{false};
+atomic<bool> sampling{false};
+atomic<bool> stopping{false};
+atomic<uint64_t> games{0};
+int sampleEvery = 1;
+Clock::time_point origin;
+FILE* out = nullptr;
+bool firstEvent = true;
+thread writer;
+
+TraceRing& attachRing() {
+    thread_local RingRelease release;
+    for (TraceRing* ring = rings.load(memory_order_acquire); ring; ring = ring->next) {
+        bool idle = false;
+        if (ring->inUse.compare_exchange_strong(idle, true, memory_order_acquire)) {
+            return *(currentRing = ring);
+        }
+    }
+    TraceRing* ring = new TraceRing();
+    ring->inUse.store(true, memory_order_relaxed);
+    ring->tid = ringCount.fetch_add(1, memory_order_relaxed) + 1;
+    ring->next = rings.load(memory_order_relaxed);
+    while (!rings.compare_exchange_weak(ring->next, ring, memory_order_release)) {
+    }
+    return *(currentRing = ring);
+}
+
+void writeEvent(const char* json) {
+    fputs(firstEvent ? "" : ",\n", out);
+    fputs(json, out);
+    firstEvent = false;
+}
+
+void drain() {
+    char line[256];
+    for (TraceRing* ring = rings.load(memory_order_acquire); ring; ring = ring->next) {
+        uint64_t tail = ring->tail.load(memory_order_relaxed);
+        uint64_t head = ring->head.load(memory_order_acquire);
+        for (; tail < head; tail++) {
+            const TraceEvent& event = ring->events[tail & (RING_SIZE - 1)];
+            int length = snprintf(line, sizeof(line), "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                                  event.name, ring->tid, event.start / 1e3, event.duration / 1e3);
+            if (event.arg >= 0) {
+                snprintf(line + length, sizeof(line) - length, ",\"args\":{\"n\":%lld}}", (long long) event.arg);
+            } else {
+                snprintf(line + length, sizeof(line) - length, "}");
+            }
+            writeEvent(line);
+        }
+        ring->tail.store(tail, memory_order_release);
+    }
+    fflush(out);
+}
+
+void writeLoop() {
+    unique_lock<mutex> guard(sleepLock);
+    while (!stopping) {
+        wake.wait_for(guard, chrono::milliseconds(DRAIN_MS), []() { return stopping.load(); });
+        drain();
+    }
+}
+
+}
+
+bool startTracing(const string& path, int every) {
+    lock_guard<mutex> guard(control);
+    if (running) {
+        return false;
+    }
+    out = fopen(path.c_str(), "w");
+    if (!out) {
+        cout << "Could not write trace " << path << "\n";
+        return false;
+    }
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", out);
+    firstEvent = true;
+    for (TraceRing* ring = rings.load(memory_order_acquire); ring; ring = ring->next) {
+        ring->tail.store(ring->head.load(memory_order_acquire), memory_order_release); // Left from an earlier trace
+        ring->dropped.store(0, memory_order_relaxed);
+    }
+    sampleEvery = max(1, every);
+    games = 0;
+    origin = Clock::now();
+    stopping = false;
+    running = true;
+    sampling = true;
+    writer = thread(writeLoop);
+    return true;
+}
+
+void stopTracing() {
+    lock_guard<mutex> guard(control);
+    if (!running) {
+        return;
+    }
+    sampling = false;
+    running = false;
+    {
+        lock_guard<mutex> sleeping(sleepLock);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    drain();
+    char line[256];
+    uint64_t dropped = 0;
+    for (TraceRing* ring = rings.load(memory_order_acquire); ring; ring = ring->next) {
+        snprintf(line, sizeof(line), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                 ring->tid, ring->tid);
+        writeEvent(line);
+        dropped += ring->dropped.load(memory_order_relaxed);
+    }
+    snprintf(line, sizeof(line), "{\"name\":\"dropped spans\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"args\":{\"n\":%llu}}",
+             traceNow() / 1e3, (unsigned long long) dropped);
+    writeEvent(line);
+    fputs("\n]}\n", out);
+    fclose(out);
+    out = nullptr;
+}
+
+void setTracing(bool enabled) {
+    sampling.store(enabled && running.load(memory_order_relaxed), memory_order_relaxed);
+}
+
+bool tracingEnabled() {
+    return sampling.load(memory_order_relaxed);
+}
+
+bool traceSample() {
+    return sampling.load(memory_order_acquire) && games.fetch_add(1, memory_order_relaxed) % sampleEvery == 0;
+}
+
+uint64_t traceNow() {
+    return chrono::duration_cast<chrono::nanoseconds>(Clock::now() - origin).count() + 1; // Never 0, which means "not traced"
+}
+
+void traceRecord(const TraceEvent& event) {
+    if (!running.load(memory_order_relaxed)) {
+        return;
+    }
+    TraceRing& ring = currentRing ? *currentRing : attachRing();
+    uint64_t head = ring.head.load(memory_order_relaxed);
+    if (head - ring.tail.load(memory_order_acquire) >= RING_SIZE) {
+        ring.dropped.store(ring.dropped.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        return;
+    }
+    ring.events[head & (RING_SIZE - 1)] = event;
+    ring.head.store(head + 1, memory_order_release);
+}
@@ -0,0 +1,71 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+// Timeline tracing in the Chrome trace-event format (chrome://tracing, ui.perfetto.dev).
+// Spans are recorded for sampled games only: whoever starts a game or deals a table asks
+// traceSample() once, and every span on that game's thread until it ends is kept. A span is
+// written into its thread's own ring buffer (single producer, no locks); a background thread
+// drains the rings into the JSON file. A full ring drops spans rather than waiting, and the drop
+// count is written at the end. Off, or for a game not sampled, a span costs one thread-local test.
+
+struct TraceEvent {
+    const char* name; // Must outlive the tracer: span names are string literals
+    uint64_t start;   // Nanoseconds since the tracer started
+    uint64_t duration;
+    int64_t arg;      // Shown as args.n; -1 for none
+};
+
+// Starts writing path, keeping one game in every sampleEvery; false (and prints why) if it cannot
+bool startTracing(const string& path, int sampleEvery);
+
+// Drains what is left, closes the JSON and the file
+void stopTracing();
+
+// Pauses or resumes sampling new games while the file stays open (for a signal, say)
+void setTracing(bool enabled);
+bool tracingEnabled();
+
+// Whether the game starting now is traced
+bool traceSample();
+
+uint64_t traceNow();
+void traceRecord(const TraceEvent& event);
+
+// Set while this thread plays a sampled game
+extern thread_local bool traceActive;
+
+// Times a scope as one span when the thread's current game is sampled (or active says so)
+class TraceSpan {
+public:
+    int64_t arg = -1;
+
+    explicit TraceSpan(const char* name, bool active = traceActive) : name(name), start(active ? traceNow() : 0) {}
+    ~TraceSpan() {
+        if (start) {
+            traceRecord({name, start, traceNow() - start, arg});
+        }
+    }
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+// Marks this thread as playing a game that is (or is not) sampled, until the scope ends. Searches
+// use TraceGame(false) around their rollouts, which would otherwise flood the trace with rolls.
+class TraceGame {
+public:
+    explicit TraceGame(bool sampled) : saved(traceActive) { traceActive = sampled; }
+    ~TraceGame() { traceActive = saved; }
+
+private:
+    bool saved;
+};
+
+#endif
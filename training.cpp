@@ -0,0 +1,238 @@
+#include "training.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace {
+
+uint64_t alignColumn(uint64_t offset) {
+    return (offset + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT * COLUMN_ALIGNMENT;
+}
+
+// Shared by the export threads: each reserves its chunk's byte range with one atomic add
+class ChunkWriter {
+public:
+    ChunkWriter(const string& path, uint64_t start) : path(path), end(start) {}
+
+    bool write(const vector<uint8_t>& bytes, fstream& out) {
+        uint64_t offset = end.fetch_add(bytes.size());
+        if (!out.is_open()) {
+            out.open(path, ios::in | ios::out | ios::binary);
+        }
+        out.seekp(offset);
+        out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        return out.good();
+    }
+
+    uint64_t size() const {
+        return end.load();
+    }
+
+private:
+    string path;
+    atomic<uint64_t> end;
+};
+
+}
+
+ChunkLayout::ChunkLayout(uint32_t rows) {
+    features = alignColumn(sizeof(ChunkHeader));
+    seat = alignColumn(features + (uint64_t) rows * FEATURE_WIDTH);
+    dice = alignColumn(seat + rows);
+    mask = alignColumn(dice + rows);
+    action = alignColumn(mask + rows);
+    outcome = alignColumn(action + rows);
+    seed = alignColumn(outcome + rows);
+    bytes = alignColumn(seed + (uint64_t) rows * sizeof(uint64_t));
+}
+
+uint32_t TrainingChunk::rows() const {
+    return seat.size();
+}
+
+void TrainingChunk::clear() {
+    features.clear();
+    seat.clear();
+    dice.clear();
+    mask.clear();
+    action.clear();
+    outcome.clear();
+    seed.clear();
+}
+
+void TrainingChunk::addRow(const vector<Player>& players, int playerIndex, int diceRoll, const vector<int>& moves,
+                           int move, uint64_t seedOfGame) {
+    size_t row = features.size();
+    features.resize(row + FEATURE_WIDTH);
+    encodeFeatures(players, playerIndex, features.data() + row);
+
+    uint8_t legal = 0;
+    for (int choice : moves) {
+        legal |= 1 << (choice == ENTER_TOKEN ? ACTION_ENTER : choice);
+    }
+    seat.push_back(playerIndex);
+    dice.push_back(diceRoll);
+    mask.push_back(legal);
+    action.push_back(move == ENTER_TOKEN ? ACTION_ENTER : move);
+    outcome.push_back(0); // Filled in once the game is over
+    seed.push_back(seedOfGame);
+}
+
+void TrainingChunk::setOutcomes(uint32_t firstRow, int leader) {
+    for (uint32_t row = firstRow; row < rows(); row++) {
+        outcome[row] = seat[row] == leader ? 1 : 0;
+    }
+}
+
+void TrainingChunk::serialize(vector<uint8_t>& out) const {
+    ChunkLayout layout(rows());
+    out.assign(layout.bytes, 0);
+    ChunkHeader header = {CHUNK_MAGIC, rows(), layout.bytes};
+    memcpy(out.data(), &header, sizeof(header));
+    memcpy(out.data() + layout.features, features.data(), features.size());
+    memcpy(out.data() + layout.seat, seat.data(), seat.size());
+    memcpy(out.data() + layout.dice, dice.data(), dice.size());
+    memcpy(out.data() + layout.mask, mask.data(), mask.size());
+    memcpy(out.data() + layout.action, action.data(), action.size());
+    memcpy(out.data() + layout.outcome, outcome.data(), outcome.size());
+    memcpy(out.data() + layout.seed, seed.data(), seed.size() * sizeof(uint64_t));
+}
+
+int RecordingPolicy::chooseMove(const vector<Player>& players, int playerIndex, int diceRoll, const vector<int>& moves) {
+    int move = inner.chooseMove(players, playerIndex, diceRoll, moves);
+    chunk.addRow(players, playerIndex, diceRoll, moves, move, seed);
+    return move;
+}
+
+bool writeTrainingHeader(ostream& out) {
+    TrainingFileHeader header;
+    memcpy(header.magic, TRAINING_MAGIC, sizeof(header.magic));
+    header.featureWidth = FEATURE_WIDTH;
+    header.actionCount = ACTION_COUNT;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    vector<char> padding(alignColumn(sizeof(header)) - sizeof(header), 0);
+    out.write(padding.data(), padding.size());
+    return out.good();
+}
+
+bool writeTrainingFile(const string& path, const TrainingChunk& chunk) {
+    ofstream out(path, ios::binary | ios::trunc);
+    vector<uint8_t> bytes;
+    chunk.serialize(bytes);
+    writeTrainingHeader(out);
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return out.good();
+}
+
+void encodeFeatures(const vector<Player>& players, int playerIndex, uint8_t* out) {
+    memset(out, 0, FEATURE_WIDTH);
+    for (int s = 0; s < FEATURE_SEATS && s < players.size(); s++) {
+        int seat = (playerIndex + s) % players.size();
+        const Player& player = players[seat];
+        for (int t = 0; t < FEATURE_TOKENS && t < player.tokens.size(); t++) {
+            int slot = tokenProgress(player.tokens[t], seat) + 1;
+            out[(s * FEATURE_TOKENS + t) * PROGRESS_SLOTS + slot] = 1;
+        }
+    }
+}
+
+int runTrainingExport(int argc, char** argv) {
+    if (argc < 4) {
+        cout << "Usage: " << argv[0] << " export <file> <games> [--players N] [--seed S] [--max-turns T]\n"
+             << "       [--threads K] [--chunk-rows R]\n";
+        return 1;
+    }
+    string path = argv[2];
+    long long games = stoll(argv[3]);
+    int numPlayers = 4;
+    uint64_t seed = 1;
+    int maxTurns = DEFAULT_MAX_TURNS;
+    int threadCount = max(1u, thread::hardware_concurrency());
+    uint32_t chunkRows = 65536;
+    for (int i = 4; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        if (option == "--players") {
+            numPlayers = stoi(argv[i + 1]);
+        } else if (option == "--seed") {
+            seed = stoull(argv[i + 1]);
+        } else if (option == "--max-turns") {
+            maxTurns = stoi(argv[i + 1]);
+        } else if (option == "--threads") {
+            threadCount = stoi(argv[i + 1]);
+        } else if (option == "--chunk-rows") {
+            chunkRows = stoul(argv[i + 1]);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (numPlayers < 2 || numPlayers > 4 || maxTurns < 1 || maxTurns > 65535 || threadCount < 1 || chunkRows < 1) {
+        cout << "Players must be 2-4, the turn limit 1-65535, threads and chunk rows at least 1.\n";
+        return 1;
+    }
+
+    {
+        ofstream out(path, ios::binary | ios::trunc);
+        if (!writeTrainingHeader(out)) {
+            cout << "Could not open " << path << " for writing.\n";
+            return 1;
+        }
+    }
+
+    auto started = chrono::steady_clock::now();
+    ChunkWriter writer(path, alignColumn(sizeof(TrainingFileHeader)));
+    atomic<long long> nextGame(0);
+    atomic<uint64_t> totalRows(0);
+    atomic<bool> failed(false);
+    vector<thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.push_back(thread([&]() {
+            TrainingChunk chunk;
+            vector<uint8_t> bytes;
+            fstream out;
+            auto flush = [&]() {
+                chunk.serialize(bytes);
+                if (!writer.write(bytes, out)) {
+                    failed = true;
+                }
+                totalRows += chunk.rows();
+                chunk.clear();
+            };
+            for (long long g = nextGame++; g < games; g = nextGame++) {
+                uint64_t seedOfGame = gameSeed(seed, g);
+                uint32_t firstRow = chunk.rows();
+                vector<unique_ptr<Policy>> owned;
+                vector<Policy*> policies;
+                for (int i = 0; i < numPlayers; i++) {
+                    owned.push_back(unique_ptr<Policy>(new RandomPolicy(seedOfGame ^ (i + 1))));
+                    owned.push_back(unique_ptr<Policy>(new RecordingPolicy(*owned.back(), chunk, seedOfGame)));
+                    policies.push_back(owned.back().get());
+                }
+                GameRecord record = playHeadlessGame(numPlayers, seedOfGame, maxTurns, policies);
+                chunk.setOutcomes(firstRow, record.header.leader);
+                if (chunk.rows() >= chunkRows) {
+                    flush();
+                }
+            }
+            if (chunk.rows() > 0) {
+                flush();
+            }
+        }));
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    if (failed) {
+        cout << "Failed writing " << path << "\n";
+        return 1;
+    }
+
+    cout << "Wrote " << totalRows.load() << " decisions from " << games << " games to " << path << " ("
+         << writer.size() / (1024.0 * 1024.0) << " MiB, " << totalRows.load() / elapsed << " rows/s)\n";
+    return 0;
+}
@@ -0,0 +1,86 @@
+#ifndef TRAINING_H
+#define TRAINING_H
+
+#include "ludo.h"
+#include "selfplay.h"
+
+#include <string>
+
+const char TRAINING_MAGIC[8] = {'L', 'U', 'D', 'O', 'T', 'R', 'N', '1'};
+const uint32_t CHUNK_MAGIC = 0x4B4E4843; // "CHNK"
+const int FEATURE_SEATS = 4;
+const int FEATURE_TOKENS = 4;
+const int PROGRESS_SLOTS = BOARD_SIZE + 2; // Not in play, each step along the path, home
+const int FEATURE_WIDTH = FEATURE_SEATS * FEATURE_TOKENS * PROGRESS_SLOTS;
+const int ACTION_COUNT = FEATURE_TOKENS + 1; // Move token 0-3, or enter a new token
+const int ACTION_ENTER = FEATURE_TOKENS;
+const int COLUMN_ALIGNMENT = 64;
+
+#pragma pack(push, 1)
+struct TrainingFileHeader {
+    char magic[8];
+    uint32_t featureWidth;
+    uint32_t actionCount;
+};
+
+// Columns follow the chunk header in this order, each starting on a COLUMN_ALIGNMENT boundary:
+// features (rows x featureWidth bytes, 0/1), seat, dice, legal mask, action, outcome (one byte each), game seed (u64)
+struct ChunkHeader {
+    uint32_t magic;
+    uint32_t rows;
+    uint64_t bytes; // Chunk size including this header
+};
+#pragma pack(pop)
+
+// Rows collected by one thread before they are written out as a chunk
+struct TrainingChunk {
+    vector<uint8_t> features, seat, dice, mask, action;
+    vector<int8_t> outcome;
+    vector<uint64_t> seed;
+
+    uint32_t rows() const;
+    void clear();
+
+    // Appends the decision move, made from moves by playerIndex after rolling diceRoll, as a row
+    void addRow(const vector<Player>& players, int playerIndex, int diceRoll, const vector<int>& moves, int move,
+                uint64_t seedOfGame);
+
+    // Marks rows from firstRow on as won (1) when their seat is the game's leader, else 0
+    void setOutcomes(uint32_t firstRow, int leader);
+
+    // Serializes into the on-disk chunk format (header + aligned columns)
+    void serialize(vector<uint8_t>& out) const;
+};
+
+// Passes decisions through to another policy and records each one as a row
+class RecordingPolicy : public Policy {
+public:
+    RecordingPolicy(Policy& inner, TrainingChunk& chunk, uint64_t seed) : inner(inner), chunk(chunk), seed(seed) {}
+
+    int chooseMove(const vector<Player>& players, int playerIndex, int diceRoll, const vector<int>& moves) override;
+
+private:
+    Policy& inner;
+    TrainingChunk& chunk;
+    uint64_t seed;
+};
+
+// File header padded to COLUMN_ALIGNMENT; chunks follow
+bool writeTrainingHeader(ostream& out);
+
+// Writes a complete training file holding a single chunk
+bool writeTrainingFile(const string& path, const TrainingChunk& chunk);
+
+// One-hot progress of every token, seats ordered from the player to move
+void encodeFeatures(const vector<Player>& players, int playerIndex, uint8_t* out);
+
+// Column offsets of a chunk with the given row count, relative to the chunk header
+struct ChunkLayout {
+    uint64_t features, seat, dice, mask, action, outcome, seed, bytes;
+    explicit ChunkLayout(uint32_t rows);
+};
+
+// "export" command: plays self-play games on several threads and writes every decision as a row
+int runTrainingExport(int argc, char** argv);
+
+#endif
@@ -0,0 +1,201 @@
+#include "tuner.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+namespace {
+
+struct TuneSettings {
+    int games = 2000;
+    int threads = 1;
+    int numPlayers = 2;
+    int maxTurns = DEFAULT_MAX_TURNS;
+    bool randomOpponent = true;
+    HeuristicWeights opponent;
+};
+
+// Fraction of games the candidate leads at the end. Game g uses the same dice seed and seat for every
+// candidate scored with the same roundSeed, so two candidates only differ by their own decisions.
+double scoreCandidate(const HeuristicWeights& candidate, const TuneSettings& settings, uint64_t roundSeed) {
+    atomic<int> nextGame(0), wins(0);
+    vector<thread> threads;
+    for (int t = 0; t < settings.threads; t++) {
+        threads.push_back(thread([&]() {
+            for (int g = nextGame++; g < settings.games; g = nextGame++) {
+                uint64_t seedOfGame = gameSeed(roundSeed, g);
+                int candidateSeat = g % settings.numPlayers;
+                vector<unique_ptr<Policy>> owned;
+                vector<Policy*> policies;
+                for (int i = 0; i < settings.numPlayers; i++) {
+                    if (i == candidateSeat) {
+                        owned.push_back(unique_ptr<Policy>(new HeuristicPolicy(candidate)));
+                    } else if (settings.randomOpponent) {
+                        owned.push_back(unique_ptr<Policy>(new RandomPolicy(seedOfGame ^ (i + 1))));
+                    } else {
+                        owned.push_back(unique_ptr<Policy>(new HeuristicPolicy(settings.opponent)));
+                    }
+                    policies.push_back(owned.back().get());
+                }
+                GameRecord record = playHeadlessGame(settings.numPlayers, seedOfGame, settings.maxTurns, policies);
+                if (record.header.leader == candidateSeat) {
+                    wins++;
+                }
+            }
+        }));
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return wins.load() / (double) settings.games;
+}
+
+void printWeights(const HeuristicWeights& weights) {
+    for (int term = 0; term < TERM_COUNT; term++) {
+        cout << " " << heuristicTermName(term) << "=" << weights.values[term];
+    }
+}
+
+}
+
+int runTuner(int argc, char** argv) {
+    if (argc < 3) {
+        cout << "Usage: " << argv[0] << " tune <best-weights-out> [--start FILE] [--opponent random|FILE]\n"
+             << "       [--iterations N] [--games G] [--threads K] [--checkpoint FILE] [--players N]\n"
+             << "       [--max-turns T] [--seed S] [--step A] [--perturbation C]\n";
+        return 1;
+    }
+    string outPath = argv[2];
+    string checkpointPath;
+    TuneSettings settings;
+    settings.threads = max(1u, thread::hardware_concurrency());
+    HeuristicWeights theta;
+    int iterations = 100;
+    uint64_t seed = 1;
+    double step = 0.5, perturbation = 0.2;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        string value = argv[i + 1];
+        if (option == "--start") {
+            if (!theta.load(value)) {
+                cout << "Could not read weights " << value << "\n";
+                return 1;
+            }
+        } else if (option == "--opponent") {
+            settings.randomOpponent = value == "random";
+            if (!settings.randomOpponent && !settings.opponent.load(value)) {
+                cout << "Could not read weights " << value << "\n";
+                return 1;
+            }
+        } else if (option == "--iterations") {
+            iterations = stoi(value);
+        } else if (option == "--games") {
+            settings.games = stoi(value);
+        } else if (option == "--threads") {
+            settings.threads = stoi(value);
+        } else if (option == "--checkpoint") {
+            checkpointPath = value;
+        } else if (option == "--players") {
+            settings.numPlayers = stoi(value);
+        } else if (option == "--max-turns") {
+            settings.maxTurns = stoi(value);
+        } else if (option == "--seed") {
+            seed = stoull(value);
+        } else if (option == "--step") {
+            step = stod(value);
+        } else if (option == "--perturbation") {
+            perturbation = stod(value);
+        } else {
+            cout << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (settings.numPlayers < 2 || settings.numPlayers > 4 || settings.maxTurns < 1 || settings.maxTurns > 65535 ||
+        settings.threads < 1 || settings.games < 1) {
+        cout << "Players must be 2-4, the turn limit 1-65535, threads and games at least 1.\n";
+        return 1;
+    }
+
+    // Checkpoint: "iteration N" and "best_score S" lines followed by the current weight lines;
+    // the best weights themselves live in the output file
+    int firstIteration = 0;
+    HeuristicWeights best = theta;
+    double bestScore = -1;
+    if (!checkpointPath.empty()) {
+        ifstream in(checkpointPath);
+        string label;
+        double value;
+        while (in >> label >> value) {
+            if (label == "iteration") {
+                firstIteration = value;
+            } else if (label == "best_score") {
+                bestScore = value;
+            }
+        }
+        if (firstIteration > 0 && theta.load(checkpointPath) && (bestScore < 0 || best.load(outPath))) {
+            cout << "Resuming from iteration " << firstIteration << "\n";
+        } else {
+            firstIteration = 0;
+            bestScore = -1;
+        }
+    }
+
+    Dice directions(seed);
+    for (int k = 0; k < firstIteration; k++) {
+        directions.next(); // Keep the perturbation sequence identical across restarts
+    }
+    double stability = iterations / 10.0;
+    for (int k = firstIteration; k < iterations; k++) {
+        double a = step / pow(k + 1 + stability, 0.602);
+        double c = perturbation / pow(k + 1, 0.101);
+        uint64_t signs = directions.next();
+        HeuristicWeights plus = theta, minus = theta;
+        for (int term = 0; term < TERM_COUNT; term++) {
+            double delta = (signs >> term) & 1 ? 1 : -1;
+            plus.values[term] += c * delta;
+            minus.values[term] -= c * delta;
+        }
+
+        uint64_t roundSeed = gameSeed(seed, k);
+        double scorePlus = scoreCandidate(plus, settings, roundSeed);
+        double scoreMinus = scoreCandidate(minus, settings, roundSeed);
+
+        // The two perturbed scores bracket theta; their mean is the running estimate of its strength
+        double estimate = (scorePlus + scoreMinus) / 2;
+        if (estimate > bestScore) {
+            bestScore = estimate;
+            best = theta;
+            best.save(outPath);
+        }
+        for (int term = 0; term < TERM_COUNT; term++) {
+            double delta = (signs >> term) & 1 ? 1 : -1;
+            theta.values[term] += a * (scorePlus - scoreMinus) / (2 * c * delta);
+        }
+        cout << "iteration " << k + 1 << ": score+ " << scorePlus << ", score- " << scoreMinus << ", weights";
+        printWeights(theta);
+        cout << "\n";
+
+        if (!checkpointPath.empty()) {
+            string partial = checkpointPath + ".tmp";
+            {
+                ofstream out(partial);
+                out.precision(17);
+                out << "iteration " << k + 1 << "\n";
+                out << "best_score " << bestScore << "\n";
+                theta.write(out);
+            }
+            rename(partial.c_str(), checkpointPath.c_str());
+        }
+    }
+
+    if (bestScore < 0) {
+        best.save(outPath);
+    }
+    cout << "Best weights (estimated score " << bestScore << ") written to " << outPath << ":";
+    printWeights(best);
+    cout << "\n";
+    return 0;
+}
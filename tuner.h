@@ -0,0 +1,9 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+#include "heuristic.h"
+
+// "tune" command: SPSA over the heuristic weights, scoring candidates with parallel headless games
+int runTuner(int argc, char** argv);
+
+#endif
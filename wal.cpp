@@ -0,0 +1,716 @@
+#include "wal.h"
+#include "histogram.h"
+#include "position.h"
+#include "selfplay.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <list>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+enum WalRecordType {
+    WAL_DEAL = 1,         // u64 table, u8 players, u64 seed, u16 turn limit
+    WAL_MOVE = 2,         // u64 table, u32 moves applied including this one, i8 move
+    WAL_END = 3,          // u64 table: abandoned before the game was over
+    WAL_STATE = 4,        // u64 table, u32 moves, then the table itself (see appendState)
+    WAL_SNAPSHOT_END = 5  // u32 generation: closes a complete snapshot
+};
+
+const size_t RECORD_HEADER = 7; // crc, length, type
+const size_t MAX_RECORD = 64;
+
+uint32_t crc32(const uint8_t* data, size_t size) {
+    static uint32_t table[256];
+    static bool ready = [] {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++) {
+                value = value & 1 ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+            }
+            table[i] = value;
+        }
+        return true;
+    }();
+    (void) ready;
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+// Builds one record on the stack; finish() fills in the length and checksum
+class RecordBuilder {
+public:
+    uint8_t data[MAX_RECORD];
+    size_t size = RECORD_HEADER;
+
+    explicit RecordBuilder(WalRecordType type) {
+        data[6] = type;
+    }
+
+    void put(uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) {
+            data[size++] = (uint8_t) (value >> (i * 8));
+        }
+    }
+
+    void finish() {
+        data[4] = size & 0xFF;
+        data[5] = size >> 8;
+        uint32_t crc = crc32(data + 4, size - 4);
+        memcpy(data, &crc, 4);
+    }
+};
+
+// Reads a record body field by field
+class RecordReader {
+public:
+    RecordReader(const uint8_t* body, size_t size) : at(body), end(body + size) {}
+
+    uint64_t get(int bytes) {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes && at < end; i++) {
+            value |= (uint64_t) *at++ << (i * 8);
+        }
+        return value;
+    }
+
+private:
+    const uint8_t* at;
+    const uint8_t* end;
+};
+
+struct RecordView {
+    int type;
+    const uint8_t* body;
+    size_t size;
+};
+
+// Next intact record at offset; false at the end of the data or at the first torn or corrupt one
+bool nextRecord(const string& data, size_t& offset, RecordView& record) {
+    if (offset + RECORD_HEADER > data.size()) {
+        return false;
+    }
+    const uint8_t* start = (const uint8_t*) data.data() + offset;
+    size_t length = start[4] | start[5] << 8;
+    uint32_t crc;
+    memcpy(&crc, start, 4);
+    if (length < RECORD_HEADER || offset + length > data.size() || crc32(start + 4, length - 4) != crc) {
+        return false;
+    }
+    record.type = start[6];
+    record.body = start + RECORD_HEADER;
+    record.size = length - RECORD_HEADER;
+    offset += length;
+    return true;
+}
+
+Table decodeState(RecordReader& reader) {
+    Table table;
+    Position position;
+    position.numPlayers = reader.get(1);
+    for (int p = 0; p < 4; p++) {
+        for (int t = 0; t < POSITION_TOKENS; t++) {
+            position.progress[p][t] = (int8_t) reader.get(1);
+        }
+    }
+    position.seat = reader.get(1);
+    position.chances = reader.get(1);
+    playersFromPosition(position, table.players);
+    table.seat = position.seat;
+    table.chances = position.chances;
+    table.turn = reader.get(2);
+    table.maxTurns = reader.get(2);
+    table.dice.state = reader.get(8);
+    table.diceRoll = reader.get(1);
+    table.state = (Table::State) reader.get(1);
+    table.winner = (int8_t) reader.get(1);
+    if (table.state == Table::TABLE_WAITING) {
+        legalMoves(table.players[table.seat], table.diceRoll, table.moves);
+    }
+    return table;
+}
+
+bool readFile(const string& path, string& data) {
+    ifstream in(path, ios::binary);
+    if (!in) {
+        return false;
+    }
+    data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    return true;
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+void syncData(int fd) {
+    METRIC_TIME(METRIC_IO_WAIT);
+#ifdef __linux__
+    fdatasync(fd);
+#else
+    fsync(fd);
+#endif
+}
+
+// Makes creations and renames in a directory durable
+void syncDirectory(const string& directory) {
+    int fd = open(directory.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// Generations present for kind ("wal" or "snapshot"), ascending
+vector<uint32_t> listGenerations(const string& directory, const char* kind) {
+    vector<uint32_t> generations;
+    error_code error;
+    for (const auto& entry : filesystem::directory_iterator(directory, error)) {
+        string name = entry.path().filename().string();
+        string prefix = string(kind) + "-";
+        string suffix = string(kind) == "wal" ? ".log" : ".bin";
+        if (name.size() > prefix.size() + suffix.size() && name.compare(0, prefix.size(), prefix) == 0 &&
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            generations.push_back(stoul(name.substr(prefix.size(), name.size() - prefix.size() - suffix.size())));
+        }
+    }
+    sort(generations.begin(), generations.end());
+    return generations;
+}
+
+}
+
+WriteAheadLog::WriteAheadLog(const string& directory, int writers)
+    : directory(directory), writers(writers), buffers(new WriterBuffer[writers]) {}
+
+WriteAheadLog::~WriteAheadLog() {
+    stop();
+}
+
+string WriteAheadLog::path(const char* kind, uint32_t generation) const {
+    char name[64];
+    snprintf(name, sizeof(name), "/%s-%010u.%s", kind, generation, string(kind) == "wal" ? "log" : "bin");
+    return directory + name;
+}
+
+bool WriteAheadLog::recover(vector<RecoveredTable>& tables, int threads) {
+    error_code error;
+    filesystem::create_directories(directory, error);
+    threads = max(1, threads);
+
+    // Newest snapshot that was closed properly, then every log from its generation on
+    list<string> files; // Records below point into these
+    vector<vector<RecordView>> partitions(threads);
+    uint32_t base = 0;
+    vector<uint32_t> snapshots = listGenerations(directory, "snapshot");
+    for (auto it = snapshots.rbegin(); it != snapshots.rend() && base == 0; ++it) {
+        string data;
+        if (!readFile(path("snapshot", *it), data)) {
+            continue;
+        }
+        vector<RecordView> states;
+        RecordView record;
+        size_t offset = 0;
+        bool closed = false;
+        while (nextRecord(data, offset, record)) {
+            if (record.type == WAL_STATE) {
+                states.push_back(record);
+            } else if (record.type == WAL_SNAPSHOT_END) {
+                RecordReader reader(record.body, record.size);
+                closed = reader.get(4) == *it;
+            }
+        }
+        if (closed) {
+            base = *it;
+            files.push_back(std::move(data)); // Moving a heap string keeps its buffer, so the views stay valid
+            for (const auto& state : states) {
+                partitions[RecordReader(state.body, state.size).get(8) % threads].push_back(state);
+            }
+        }
+    }
+
+    long long records = 0, torn = 0;
+    vector<uint32_t> logs = listGenerations(directory, "wal");
+    for (uint32_t log : logs) {
+        generation = max(generation, log);
+        if (log < base) {
+            continue;
+        }
+        files.push_back(string());
+        string& data = files.back();
+        readFile(path("wal", log), data);
+        RecordView record;
+        size_t offset = 0;
+        while (nextRecord(data, offset, record)) {
+            partitions[RecordReader(record.body, record.size).get(8) % threads].push_back(record);
+            records++;
+        }
+        torn += offset < data.size();
+    }
+    if (!snapshots.empty()) {
+        generation = max(generation, snapshots.back());
+    }
+
+    // Tables are independent, so each partition replays on its own thread
+    vector<vector<RecoveredTable>> results(threads);
+    vector<long long> discarded(threads);
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread([&, t]() {
+            unordered_map<uint64_t, RecoveredTable> live;
+            for (const auto& record : partitions[t]) {
+                RecordReader reader(record.body, record.size);
+                uint64_t id = reader.get(8);
+                if (record.type == WAL_STATE) {
+                    RecoveredTable& entry = live[id];
+                    entry.id = id;
+                    entry.moves = reader.get(4);
+                    entry.table = decodeState(reader);
+                } else if (record.type == WAL_DEAL) {
+                    RecoveredTable& entry = live[id];
+                    entry.id = id;
+                    entry.moves = 0;
+                    int players = reader.get(1);
+                    uint64_t seed = reader.get(8);
+                    entry.table.start(players, seed, reader.get(2));
+                } else if (record.type == WAL_MOVE) {
+                    auto it = live.find(id);
+                    uint32_t moves = reader.get(4);
+                    int move = (int8_t) reader.get(1);
+                    if (it == live.end() || moves <= it->second.moves) {
+                        continue; // Already part of the snapshot, or of a table dealt before it and gone since
+                    }
+                    if (moves != it->second.moves + 1 || !it->second.table.play(move)) {
+                        discarded[t]++;
+                        live.erase(it);
+                        continue;
+                    }
+                    it->second.moves = moves;
+                } else if (record.type == WAL_END) {
+                    live.erase(id);
+                }
+            }
+            for (auto& entry : live) {
+                if (entry.second.table.state == Table::TABLE_WAITING) {
+                    results[t].push_back(std::move(entry.second));
+                }
+            }
+        }));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    long long broken = 0;
+    for (int t = 0; t < threads; t++) {
+        broken += discarded[t];
+        for (auto& entry : results[t]) {
+            tables.push_back(std::move(entry));
+        }
+    }
+    snapshotNeeded = !files.empty();
+    recoverySummary = "snapshot " + to_string(base) + ", " + to_string(records) + " log records from " +
+                      to_string(logs.size()) + " logs" + (torn ? ", " + to_string(torn) + " torn tails" : "") +
+                      (broken ? ", " + to_string(broken) + " tables dropped as inconsistent" : "");
+    return true;
+}
+
+bool WriteAheadLog::openLog() {
+    fd = open(path("wal", generation).c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    syncDirectory(directory);
+    logBytes = 0;
+    return true;
+}
+
+bool WriteAheadLog::start(function<void(uint32_t)> snapshotRequest) {
+    error_code error;
+    filesystem::create_directories(directory, error);
+    for (uint32_t existing : listGenerations(directory, "wal")) {
+        generation = max(generation, existing);
+    }
+    for (uint32_t existing : listGenerations(directory, "snapshot")) {
+        generation = max(generation, existing);
+    }
+    generation++;
+    if (!openLog()) {
+        return false;
+    }
+    requestSnapshot = snapshotRequest;
+    running = true;
+    flusher = thread([this]() { flushLoop(); });
+    return true;
+}
+
+void WriteAheadLog::stop() {
+    if (!flusher.joinable()) {
+        return;
+    }
+    stopping = true;
+    flusher.join();
+    running = false;
+    close(fd);
+    fd = -1;
+}
+
+void WriteAheadLog::append(int writer, const string& record) {
+    if (!running) {
+        return;
+    }
+    WriterBuffer& buffer = buffers[writer];
+    lock_guard<mutex> guard(buffer.lock);
+    buffer.bytes += record;
+    buffer.records++;
+}
+
+void WriteAheadLog::logDeal(int writer, uint64_t table, int players, uint64_t seed, int turnLimit) {
+    RecordBuilder record(WAL_DEAL);
+    record.put(table, 8);
+    record.put(players, 1);
+    record.put(seed, 8);
+    record.put(turnLimit, 2);
+    record.finish();
+    append(writer, string((const char*) record.data, record.size));
+}
+
+void WriteAheadLog::logMove(int writer, uint64_t table, uint32_t moves, int move) {
+    if (!running) {
+        return;
+    }
+    RecordBuilder record(WAL_MOVE);
+    record.put(table, 8);
+    record.put(moves, 4);
+    record.put((uint8_t) move, 1);
+    record.finish();
+    // The hot path: copy straight into the buffer, no temporary string
+    WriterBuffer& buffer = buffers[writer];
+    lock_guard<mutex> guard(buffer.lock);
+    buffer.bytes.append((const char*) record.data, record.size);
+    buffer.records++;
+}
+
+void WriteAheadLog::logEnd(int writer, uint64_t table) {
+    RecordBuilder record(WAL_END);
+    record.put(table, 8);
+    record.finish();
+    append(writer, string((const char*) record.data, record.size));
+}
+
+void WriteAheadLog::appendState(string& records, uint64_t id, uint32_t moves, const Table& table) {
+    RecordBuilder record(WAL_STATE);
+    record.put(id, 8);
+    record.put(moves, 4);
+    Position position = positionFromPlayers(table.players, table.seat, table.chances);
+    record.put(position.numPlayers, 1);
+    for (int p = 0; p < 4; p++) {
+        for (int t = 0; t < POSITION_TOKENS; t++) {
+            record.put(p < position.numPlayers ? (uint8_t) position.progress[p][t] : 0xFF, 1);
+        }
+    }
+    record.put(table.seat, 1);
+    record.put(table.chances, 1);
+    record.put(table.turn, 2);
+    record.put(table.maxTurns, 2);
+    record.put(table.dice.state, 8);
+    record.put(table.diceRoll, 1);
+    record.put(table.state, 1);
+    record.put((uint8_t) table.winner, 1);
+    record.finish();
+    records.append((const char*) record.data, record.size);
+}
+
+void WriteAheadLog::snapshotPart(uint32_t forGeneration, string records) {
+    lock_guard<mutex> guard(snapshotLock);
+    if (forGeneration == snapshotGeneration) {
+        snapshotParts.push_back(std::move(records));
+    }
+}
+
+void WriteAheadLog::flushLoop() {
+    vector<string> batch(writers);
+    bool failed = false;
+    while (true) {
+        bool last = stopping;
+        size_t total = 0;
+        long long records = 0;
+        for (int w = 0; w < writers; w++) {
+            lock_guard<mutex> guard(buffers[w].lock);
+            batch[w].swap(buffers[w].bytes);
+            records += buffers[w].records;
+            buffers[w].records = 0;
+        }
+        for (auto& part : batch) {
+            if (!part.empty()) {
+                if (!writeAll(fd, part.data(), part.size()) && !failed) {
+                    cout << "wal: write to " << path("wal", generation) << " failed: " << strerror(errno) << "\n";
+                    failed = true;
+                }
+                total += part.size();
+                part.clear();
+            }
+        }
+        if (total > 0) {
+            // One sync covers every table that logged since the last one
+            auto started = Clock::now();
+            syncData(fd);
+            long long nanos = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - started).count();
+            stats.records += records;
+            stats.bytes += total;
+            stats.commits++;
+            stats.syncNanos += nanos;
+            if (nanos > stats.maxSyncNanos) {
+                stats.maxSyncNanos = nanos;
+            }
+            logBytes += total;
+        }
+
+        finishSnapshot();
+        if (last) {
+            break;
+        }
+        bool idle;
+        {
+            lock_guard<mutex> guard(snapshotLock);
+            idle = snapshotGeneration == 0;
+        }
+        if (idle && (snapshotNeeded || logBytes >= snapshotBytes)) {
+            // Rotate first: whatever a writer logs after its part goes to the new generation
+            close(fd);
+            generation++;
+            if (!openLog() && !failed) {
+                cout << "wal: cannot open " << path("wal", generation) << ": " << strerror(errno) << "\n";
+                failed = true;
+            }
+            {
+                lock_guard<mutex> guard(snapshotLock);
+                snapshotGeneration = generation;
+                snapshotParts.clear();
+            }
+            snapshotNeeded = false;
+            requestSnapshot(generation);
+        }
+        if (total == 0) {
+            this_thread::sleep_for(chrono::microseconds(commitMicros));
+        }
+    }
+}
+
+// Writes the snapshot once every writer has sent its part, then drops the generations it replaces
+void WriteAheadLog::finishSnapshot() {
+    vector<string> parts;
+    uint32_t finished;
+    {
+        lock_guard<mutex> guard(snapshotLock);
+        if (snapshotGeneration == 0 || (int) snapshotParts.size() < writers) {
+            return;
+        }
+        parts.swap(snapshotParts);
+        finished = snapshotGeneration;
+        snapshotGeneration = 0;
+    }
+    string partial = path("snapshot", finished) + ".tmp";
+    int out = open(partial.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = out >= 0;
+    for (const auto& part : parts) {
+        ok = ok && writeAll(out, part.data(), part.size());
+    }
+    RecordBuilder closing(WAL_SNAPSHOT_END);
+    closing.put(finished, 4);
+    closing.finish();
+    ok = ok && writeAll(out, (const char*) closing.data, closing.size);
+    if (out >= 0) {
+        syncData(out);
+        close(out);
+    }
+    error_code error;
+    if (!ok) {
+        filesystem::remove(partial, error);
+        return; // The older generations stay until a later snapshot succeeds
+    }
+    filesystem::rename(partial, path("snapshot", finished), error);
+    syncDirectory(directory);
+    for (uint32_t old : listGenerations(directory, "wal")) {
+        if (old < finished) {
+            filesystem::remove(path("wal", old), error);
+        }
+    }
+    for (uint32_t old : listGenerations(directory, "snapshot")) {
+        if (old < finished) {
+            filesystem::remove(path("snapshot", old), error);
+        }
+    }
+    stats.snapshot = finished;
+}
+
+int runWalBench(int argc, char** argv) {
+    string directory;
+    int writers = 2, tablesPerWriter = 1000, commitMicros = 1000;
+    double seconds = 3, snapshotMb = 16;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        if (option == "--dir") {
+            directory = argv[i + 1];
+        } else if (option == "--writers") {
+            writers = stoi(argv[i + 1]);
+        } else if (option == "--tables") {
+            tablesPerWriter = stoi(argv[i + 1]);
+        } else if (option == "--seconds") {
+            seconds = stod(argv[i + 1]);
+        } else if (option == "--commit-us") {
+            commitMicros = stoi(argv[i + 1]);
+        } else if (option == "--snapshot-mb") {
+            snapshotMb = stod(argv[i + 1]);
+        } else {
+            directory.clear();
+            break;
+        }
+    }
+    if (directory.empty() || writers < 1 || tablesPerWriter < 1 || seconds <= 0) {
+        cout << "Usage: " << argv[0] << " wal-bench --dir DIR [--writers W] [--tables PER_WRITER] [--seconds S]\n"
+             << "       [--commit-us US] [--snapshot-mb MB]\n"
+             << "DIR should be a scratch directory on the disk being measured; its contents are replaced.\n";
+        return 1;
+    }
+    error_code error;
+    filesystem::remove_all(directory, error);
+
+    WriteAheadLog wal(directory, writers);
+    wal.commitMicros = commitMicros;
+    wal.snapshotBytes = (size_t) (snapshotMb * 1024 * 1024);
+    vector<RecoveredTable> none;
+    wal.recover(none, 1);
+    unique_ptr<atomic<uint32_t>[]> requested(new atomic<uint32_t>[writers]);
+    for (int w = 0; w < writers; w++) {
+        requested[w] = 0;
+    }
+    if (!wal.start([&](uint32_t generation) {
+            for (int w = 0; w < writers; w++) {
+                requested[w] = generation;
+            }
+        })) {
+        cout << "Could not open a log in " << directory << "\n";
+        return 1;
+    }
+
+    // Each writer stands in for a table worker: it plays its tables round-robin and logs every move
+    atomic<bool> stop(false);
+    vector<vector<RecoveredTable>> live(writers);
+    vector<LatencyHistogram> appendLatency(writers);
+    vector<long long> moves(writers);
+    vector<thread> threads;
+    for (int w = 0; w < writers; w++) {
+        threads.push_back(thread([&, w]() {
+            vector<RecoveredTable>& tables = live[w];
+            RandomPolicy policy(gameSeed(7, w));
+            uint64_t nextId = (uint64_t) w << 40;
+            auto deal = [&](RecoveredTable& entry) {
+                entry.id = ++nextId;
+                entry.moves = 0;
+                uint64_t seed = gameSeed(11, entry.id);
+                entry.table.start(4, seed, DEFAULT_MAX_TURNS);
+                wal.logDeal(w, entry.id, 4, seed, DEFAULT_MAX_TURNS);
+            };
+            tables.resize(tablesPerWriter);
+            for (auto& entry : tables) {
+                deal(entry);
+            }
+            uint32_t snapshotted = 0;
+            for (long long n = 0; !stop; n++) {
+                if (requested[w] != snapshotted) {
+                    snapshotted = requested[w];
+                    string records;
+                    for (const auto& entry : tables) {
+                        WriteAheadLog::appendState(records, entry.id, entry.moves, entry.table);
+                    }
+                    wal.snapshotPart(snapshotted, std::move(records));
+                }
+                RecoveredTable& entry = tables[n % tables.size()];
+                if (entry.table.state == Table::TABLE_FINISHED) {
+                    deal(entry);
+                    continue;
+                }
+                int move = policy.chooseMove(entry.table.players, entry.table.seat, entry.table.diceRoll, entry.table.moves);
+                entry.table.play(move);
+                entry.moves++;
+                bool sample = n % 64 == 0;
+                auto started = sample ? Clock::now() : Clock::time_point();
+                wal.logMove(w, entry.id, entry.moves, move);
+                if (sample) {
+                    appendLatency[w].record(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - started).count());
+                }
+                moves[w]++;
+            }
+        }));
+    }
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    stop = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    wal.stop(); // Final commit: everything logged is on disk now
+
+    LatencyHistogram appends;
+    long long total = 0;
+    for (int w = 0; w < writers; w++) {
+        appends.add(appendLatency[w]);
+        total += moves[w];
+    }
+    long long commits = wal.stats.commits;
+    cout << fixed << setprecision(2) << writers << " writers: " << (long long) (total / seconds) << " moves/s logged, append p50 "
+         << appends.percentile(50) << " ns, p99 " << appends.percentile(99) << " ns\n"
+         << commits << " group commits (" << (commits ? wal.stats.records / (double) commits : 0)
+         << " records each), fdatasync avg " << (commits ? wal.stats.syncNanos / commits / 1000.0 : 0) << " us, max "
+         << wal.stats.maxSyncNanos / 1000.0 << " us, " << wal.stats.bytes / (1024.0 * 1024.0) << " MiB written, snapshot "
+         << wal.stats.snapshot << "\n";
+
+    // Recover into a fresh log object and compare with what the writers still hold
+    int cpus = max(1u, thread::hardware_concurrency());
+    WriteAheadLog reader(directory, writers);
+    vector<RecoveredTable> recovered;
+    auto started = Clock::now();
+    reader.recover(recovered, cpus);
+    double elapsed = chrono::duration<double, milli>(Clock::now() - started).count();
+    unordered_map<uint64_t, const RecoveredTable*> byId;
+    for (const auto& entry : recovered) {
+        byId[entry.id] = &entry;
+    }
+    long long expected = 0, matched = 0;
+    for (const auto& tables : live) {
+        for (const auto& entry : tables) {
+            if (entry.table.state != Table::TABLE_WAITING) {
+                continue;
+            }
+            expected++;
+            auto it = byId.find(entry.id);
+            matched += it != byId.end() && it->second->moves == entry.moves && it->second->table.hash() == entry.table.hash();
+        }
+    }
+    cout << "recovered " << recovered.size() << " tables on " << cpus << " threads in " << elapsed << " ms ("
+         << reader.recoverySummary << "); " << matched << "/" << expected << " match the live tables\n";
+    return matched == expected && (long long) recovered.size() == expected ? 0 : 1;
+}
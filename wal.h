@@ -0,0 +1,106 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "table.h"
+
+// Crash safety for served tables. A table is its deal plus the choices made since, so the log
+// only holds small records (deal, move, end) that writer threads copy into their own buffer.
+// One flusher thread collects every buffer, writes them with a single fdatasync (group commit)
+// and loops straight into the next batch while there is work. Once the log has grown enough it
+// rotates to a new generation and asks every writer for the state of its live tables; those land
+// in a snapshot file, after which older generations are deleted.
+// On disk, in the data directory: wal-GENERATION.log and snapshot-GENERATION.bin, made of records
+//   u32 crc32 of the rest, u16 record length, u8 type, body
+// A torn or corrupt record ends a log; a snapshot only counts once its closing record is there.
+// Moves are acknowledged without waiting for the disk and become durable within one commit.
+
+// A live table read back from disk
+struct RecoveredTable {
+    uint64_t id = 0;
+    uint32_t moves = 0; // Choices applied since the deal; move records carry the same count
+    Table table;
+};
+
+struct WalStats {
+    atomic<long long> records{0};
+    atomic<long long> bytes{0};
+    atomic<long long> commits{0};
+    atomic<long long> syncNanos{0};    // Summed over commits
+    atomic<long long> maxSyncNanos{0};
+    atomic<uint32_t> snapshot{0};      // Generation of the newest complete snapshot
+};
+
+class WriteAheadLog {
+public:
+    int commitMicros = 1000;          // How long an idle flusher sleeps before looking again
+    size_t snapshotBytes = 64 << 20;  // Log volume after which the next snapshot starts
+    WalStats stats;
+    string recoverySummary;           // What recover found, for the caller to print
+
+    // writers: threads that append, each with its own buffer (the server's table workers)
+    WriteAheadLog(const string& directory, int writers);
+    ~WriteAheadLog();
+
+    // Loads the newest complete snapshot and replays the logs written after it, spreading tables
+    // over threads; returns every table still in play. Call before start.
+    bool recover(vector<RecoveredTable>& tables, int threads);
+
+    // Opens the next generation's log and starts the flusher. requestSnapshot is called on the
+    // flusher thread and must get every writer to call snapshotPart for that generation.
+    bool start(function<void(uint32_t generation)> requestSnapshot);
+
+    // Commits what is buffered and stops; records logged after this are dropped, so tables torn
+    // down at shutdown stay recoverable
+    void stop();
+
+    // Called on the writer's own thread (logEnd from any thread); only copies into memory
+    void logDeal(int writer, uint64_t table, int players, uint64_t seed, int turnLimit);
+    void logMove(int writer, uint64_t table, uint32_t moves, int move);
+    void logEnd(int writer, uint64_t table);
+
+    // A writer's live tables for a snapshot, as appendState records
+    void snapshotPart(uint32_t generation, string records);
+    static void appendState(string& records, uint64_t id, uint32_t moves, const Table& table);
+
+private:
+    struct alignas(64) WriterBuffer {
+        mutex lock;
+        string bytes;
+        long long records = 0;
+    };
+
+    string directory;
+    int writers;
+    unique_ptr<WriterBuffer[]> buffers;
+    atomic<bool> running{false};
+    atomic<bool> stopping{false};
+    thread flusher;
+    function<void(uint32_t)> requestSnapshot;
+    int fd = -1;
+    uint32_t generation = 0;
+    size_t logBytes = 0;               // Written to the current generation
+    bool snapshotNeeded = false;       // Set by recover when anything came back
+
+    mutex snapshotLock;
+    uint32_t snapshotGeneration = 0;   // In progress, 0 if none
+    vector<string> snapshotParts;
+
+    void append(int writer, const string& record);
+    void flushLoop();
+    bool openLog();
+    void finishSnapshot();
+    string path(const char* kind, uint32_t generation) const;
+};
+
+// "wal-bench" command: writer threads play games at full speed through the log, then the data
+// directory is recovered and checked against the tables left in memory
+int runWalBench(int argc, char** argv);
+
+#endif